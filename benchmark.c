@@ -0,0 +1,514 @@
+#include <stdio.h>      // Para printf
+#include <stdlib.h>     // Para malloc, free, atoi
+#include <string.h>     // Para memcmp, memcpy
+#include <stdint.h>
+#include <time.h>       // Para clock_gettime
+#include "compression.h"
+#include "codec.h"
+#include "tree.h"
+
+// -------------------------------------------------------
+// Benchmark del compresor LZW y del índice B-tree.
+// Genera corpus deterministas (texto y binario) y mide el
+// rendimiento en MB/s y la tasa del compresor actual frente a la
+// implementación original (búsqueda lineal, códigos fijos de 16
+// bits), verificando que los blobs originales siguen siendo
+// legibles por lzw_decompress. Después compara inserción y
+// búsqueda en el B-tree original (t = 2, llaves char[256]) y en el
+// actual con varios órdenes. Por último mide el histograma con
+// el que se elige el códec y cada códec sobre texto, bytes
+// aleatorios y repeticiones.
+//
+// Uso: benchmark [KiB_referencia] [KiB_actual] [llaves]
+// -------------------------------------------------------
+
+// Reloj de pared en segundos
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Generador pseudoaleatorio determinista (xorshift64)
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+static uint64_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// Corpus de texto: palabras de un vocabulario fijo separadas por espacios
+static uint8_t* make_text(size_t size) {
+    static const char *words[] = {
+        "archivo", "sistema", "arbol", "nodo", "clave", "indice", "bloque",
+        "datos", "comprimir", "leer", "escribir", "diccionario", "codigo",
+        "prefijo", "memoria", "almacenamiento", "the", "of", "and", "file"
+    };
+    uint8_t *buf = malloc(size);
+    size_t pos = 0;
+    while (pos < size) {
+        const char *w = words[rng_next() % (sizeof(words) / sizeof(words[0]))];
+        for (size_t i = 0; w[i] && pos < size; ++i) buf[pos++] = (uint8_t)w[i];
+        if (pos < size) buf[pos++] = (rng_next() % 12 == 0) ? '\n' : ' ';
+    }
+    return buf;
+}
+
+// Corpus binario: bytes aleatorios (incompresible)
+static uint8_t* make_binary(size_t size) {
+    uint8_t *buf = malloc(size);
+    for (size_t i = 0; i < size; ++i) buf[i] = (uint8_t)rng_next();
+    return buf;
+}
+
+// Corpus de repeticiones: bytes aleatorios repetidos de 1 a 64 veces
+static uint8_t* make_runs(size_t size) {
+    uint8_t *buf = malloc(size);
+    size_t pos = 0;
+    while (pos < size) {
+        uint8_t b = (uint8_t)rng_next();
+        size_t len = 1 + rng_next() % 64;
+        for (size_t i = 0; i < len && pos < size; ++i) buf[pos++] = b;
+    }
+    return buf;
+}
+
+// -------------------------------------------------------
+// Compresor de referencia: versión original con búsqueda
+// lineal (O(dict_size) por byte) y códigos fijos de 16 bits.
+// Solo se usa para medir y para generar blobs del formato original.
+// -------------------------------------------------------
+typedef struct {
+    unsigned short prefix;
+    unsigned char character;
+} LegacyEntry;
+
+static uint8_t* legacy_lzw_compress(const uint8_t* input, size_t input_size, size_t* out_size_bytes) {
+    LegacyEntry *dict = calloc(65536, sizeof(LegacyEntry));
+    uint16_t *codes = malloc(sizeof(uint16_t) * (input_size + 16));
+    size_t codes_len = 0;
+    int dict_size = 256;
+    unsigned short prefix = 0;
+    int has_prefix = 0;
+
+    for (size_t idx = 0; idx < input_size; ++idx) {
+        unsigned char ch = input[idx];
+        if (!has_prefix) { prefix = ch; has_prefix = 1; continue; }
+        int found = -1;
+        for (int i = 256; i < dict_size; ++i) {
+            if (dict[i].prefix == prefix && dict[i].character == ch) { found = i; break; }
+        }
+        if (found != -1) {
+            prefix = (unsigned short)found;
+        } else {
+            codes[codes_len++] = prefix;
+            if (dict_size < 65536) {
+                dict[dict_size].prefix = prefix;
+                dict[dict_size].character = ch;
+                dict_size++;
+            }
+            prefix = ch;
+        }
+    }
+    if (has_prefix) codes[codes_len++] = prefix;
+
+    *out_size_bytes = sizeof(uint64_t) + sizeof(uint32_t) + codes_len * sizeof(uint16_t);
+    uint8_t *out = malloc(*out_size_bytes);
+    uint64_t orig = (uint64_t)input_size;
+    uint32_t cnt = (uint32_t)codes_len;
+    memcpy(out, &orig, sizeof(uint64_t));
+    memcpy(out + sizeof(uint64_t), &cnt, sizeof(uint32_t));
+    memcpy(out + sizeof(uint64_t) + sizeof(uint32_t), codes, codes_len * sizeof(uint16_t));
+    free(dict);
+    free(codes);
+    return out;
+}
+
+// Mide compresor antiguo y nuevo sobre un corpus
+static void bench_corpus(const char *name, uint8_t *(*make)(size_t), size_t ref_size, size_t cur_size) {
+    double mb;
+
+    // Comparación con la versión anterior (corpus reducido: es cuadrática)
+    uint8_t *data = make(ref_size);
+    size_t ref_len = 0, cur_len = 0;
+    double t0 = now_sec();
+    uint8_t *ref = legacy_lzw_compress(data, ref_size, &ref_len);
+    double t_ref = now_sec() - t0;
+    t0 = now_sec();
+    uint8_t *cur = lzw_compress(data, ref_size, &cur_len);
+    double t_cur = now_sec() - t0;
+
+    size_t old_len = 0;
+    uint8_t *old = lzw_decompress(ref, ref_len, &old_len);
+    int compatible = old && old_len == ref_size && memcmp(old, data, ref_size) == 0;
+    mb = (double)ref_size / (1024.0 * 1024.0);
+    printf("%-8s %8zu KiB  anterior %9.2f MB/s ratio %.3f  actual %9.2f MB/s ratio %.3f  x%.1f  %s\n",
+           name, ref_size / 1024, mb / t_ref, (double)ref_len / (double)ref_size,
+           mb / t_cur, (double)cur_len / (double)ref_size, t_ref / t_cur,
+           compatible ? "compatible" : "INCOMPATIBLE");
+    free(old);
+    free(ref);
+    free(cur);
+    free(data);
+
+    // Rendimiento del compresor y descompresor actuales sobre un corpus mayor
+    data = make(cur_size);
+    t0 = now_sec();
+    cur = lzw_compress(data, cur_size, &cur_len);
+    double t_c = now_sec() - t0;
+    size_t dec_len = 0;
+    t0 = now_sec();
+    uint8_t *dec = lzw_decompress(cur, cur_len, &dec_len);
+    double t_d = now_sec() - t0;
+    mb = (double)cur_size / (1024.0 * 1024.0);
+    printf("%-8s %8zu KiB  comprimir %9.2f MB/s  descomprimir %9.2f MB/s  ratio %.3f  %s\n",
+           name, cur_size / 1024, mb / t_c, mb / t_d, (double)cur_len / (double)cur_size,
+           (dec && dec_len == cur_size && memcmp(dec, data, cur_size) == 0) ? "ok" : "ERROR");
+    free(dec);
+    free(cur);
+    free(data);
+}
+
+// -------------------------------------------------------
+// B-tree de referencia: versión original con t = 2, llaves
+// char[256] dentro del nodo y cuatro malloc por nodo. Solo
+// inserción y búsqueda, para medir.
+// -------------------------------------------------------
+#define LEGACY_T 2
+
+typedef struct LegacyNode {
+    int n;
+    char (*keys)[256];
+    long *positions;
+    struct LegacyNode **C;
+    int leaf;
+} LegacyNode;
+
+static LegacyNode* legacy_node(int leaf) {
+    LegacyNode *node = malloc(sizeof(LegacyNode));
+    node->n = 0;
+    node->leaf = leaf;
+    node->keys = malloc(sizeof(*node->keys) * (2 * LEGACY_T - 1));
+    node->positions = malloc(sizeof(long) * (2 * LEGACY_T - 1));
+    node->C = calloc(2 * LEGACY_T, sizeof(LegacyNode*));
+    return node;
+}
+
+static void legacy_free(LegacyNode* x) {
+    if (!x->leaf) for (int i = 0; i <= x->n; ++i) legacy_free(x->C[i]);
+    free(x->keys);
+    free(x->positions);
+    free(x->C);
+    free(x);
+}
+
+static long legacy_search(LegacyNode* x, const char* key) {
+    while (x) {
+        int i = 0;
+        while (i < x->n && strcmp(key, x->keys[i]) > 0) i++;
+        if (i < x->n && strcmp(key, x->keys[i]) == 0) return x->positions[i];
+        if (x->leaf) return -1;
+        x = x->C[i];
+    }
+    return -1;
+}
+
+static void legacy_split(LegacyNode* x, int i, LegacyNode* y) {
+    LegacyNode *z = legacy_node(y->leaf);
+    int t = LEGACY_T;
+    z->n = t - 1;
+    for (int j = 0; j < t - 1; ++j) {
+        strcpy(z->keys[j], y->keys[j + t]);
+        z->positions[j] = y->positions[j + t];
+    }
+    if (!y->leaf) for (int j = 0; j < t; ++j) z->C[j] = y->C[j + t];
+    y->n = t - 1;
+    for (int j = x->n; j >= i + 1; --j) x->C[j + 1] = x->C[j];
+    x->C[i + 1] = z;
+    for (int j = x->n - 1; j >= i; --j) {
+        strcpy(x->keys[j + 1], x->keys[j]);
+        x->positions[j + 1] = x->positions[j];
+    }
+    strcpy(x->keys[i], y->keys[t - 1]);
+    x->positions[i] = y->positions[t - 1];
+    x->n += 1;
+}
+
+static void legacy_insert_nonfull(LegacyNode* x, const char* k, long pos) {
+    int i = x->n - 1;
+    if (x->leaf) {
+        while (i >= 0 && strcmp(k, x->keys[i]) < 0) {
+            strcpy(x->keys[i + 1], x->keys[i]);
+            x->positions[i + 1] = x->positions[i];
+            i--;
+        }
+        strcpy(x->keys[i + 1], k);
+        x->positions[i + 1] = pos;
+        x->n += 1;
+    } else {
+        while (i >= 0 && strcmp(k, x->keys[i]) < 0) i--;
+        i++;
+        if (x->C[i]->n == 2 * LEGACY_T - 1) {
+            legacy_split(x, i, x->C[i]);
+            if (strcmp(k, x->keys[i]) > 0) i++;
+        }
+        legacy_insert_nonfull(x->C[i], k, pos);
+    }
+}
+
+// Igual que el original: busca primero y luego inserta
+static void legacy_insert(LegacyNode** root, const char* key, long pos) {
+    if (legacy_search(*root, key) != -1) return;
+    LegacyNode *r = *root;
+    if (r->n == 2 * LEGACY_T - 1) {
+        LegacyNode *s = legacy_node(0);
+        *root = s;
+        s->C[0] = r;
+        legacy_split(s, 0, r);
+        legacy_insert_nonfull(s, key, pos);
+    } else {
+        legacy_insert_nonfull(r, key, pos);
+    }
+}
+
+// Llaves parecidas a rutas reales, en orden aleatorio
+static char** make_keys(size_t n) {
+    char **keys = malloc(sizeof(char*) * n);
+    for (size_t i = 0; i < n; ++i) {
+        char buf[96];
+        snprintf(buf, sizeof(buf), "/home/usuario/datos/dir%03u/archivo_%08zu.txt",
+                 (unsigned)(rng_next() % 500), i);
+        keys[i] = malloc(strlen(buf) + 1);
+        strcpy(keys[i], buf);
+    }
+    for (size_t i = n; i > 1; --i) {
+        size_t j = rng_next() % i;
+        char *tmp = keys[i - 1];
+        keys[i - 1] = keys[j];
+        keys[j] = tmp;
+    }
+    return keys;
+}
+
+// Mide inserción y búsqueda (en otro orden aleatorio) de n llaves
+static void bench_btree(size_t n) {
+    char **keys = make_keys(n);
+    char **probe = malloc(sizeof(char*) * n);
+    memcpy(probe, keys, sizeof(char*) * n);
+    for (size_t i = n; i > 1; --i) {
+        size_t j = rng_next() % i;
+        char *tmp = probe[i - 1];
+        probe[i - 1] = probe[j];
+        probe[j] = tmp;
+    }
+
+    // Árbol original
+    LegacyNode *legacy = legacy_node(1);
+    double t0 = now_sec();
+    for (size_t i = 0; i < n; ++i) legacy_insert(&legacy, keys[i], (long)i);
+    double t_ins = now_sec() - t0;
+    size_t found = 0;
+    t0 = now_sec();
+    for (size_t i = 0; i < n; ++i) found += legacy_search(legacy, probe[i]) != -1;
+    double t_find = now_sec() - t0;
+    printf("btree    %8zu llaves  anterior t=%-3d insertar %7.1f ns  buscar %7.1f ns  %s\n",
+           n, LEGACY_T, t_ins * 1e9 / (double)n, t_find * 1e9 / (double)n,
+           found == n ? "ok" : "ERROR");
+    legacy_free(legacy);
+
+    // Árbol actual con varios órdenes
+    static const int orders[] = { 2, 8, BTREE_T, 64, 128 };
+    for (size_t o = 0; o < sizeof(orders) / sizeof(orders[0]); ++o) {
+        BTree *tree = btree_create(orders[o]);
+        t0 = now_sec();
+        for (size_t i = 0; i < n; ++i) {
+            BTreeValue v = { (long)i, 0, 0, { 0, 0 } };
+            btree_insert(tree, keys[i], &v);
+        }
+        t_ins = now_sec() - t0;
+        found = 0;
+        t0 = now_sec();
+        for (size_t i = 0; i < n; ++i) found += btree_search(tree, probe[i]) != -1;
+        t_find = now_sec() - t0;
+        printf("btree    %8zu llaves  actual   t=%-3d insertar %7.1f ns  buscar %7.1f ns  %s\n",
+               n, tree->t, t_ins * 1e9 / (double)n, t_find * 1e9 / (double)n,
+               found == n && tree->count == n ? "ok" : "ERROR");
+        btree_destroy(tree);
+    }
+
+    for (size_t i = 0; i < n; ++i) free(keys[i]);
+    free(keys);
+    free(probe);
+}
+
+// --------------------------------------------------------
+// Prueba de estrés del borrado: inserciones y borrados aleatorios
+// comprobando las invariantes del B-tree y la profundidad de las
+// búsquedas
+// --------------------------------------------------------
+
+static const char* tree_key(const BTree* tree, uint32_t off) {
+    return tree->arena.chunks[off >> 20] + (off & (BTREE_ARENA_CHUNK - 1));
+}
+
+static uint32_t prefix_of(const char* key) {
+    uint32_t p = 0;
+    int i = 0;
+    for (; i < 4 && key[i]; ++i) p = (p << 8) | (uint8_t)key[i];
+    return i ? p << (8 * (4 - i)) : 0;  // Desplazar 32 bits no está definido
+}
+
+typedef struct {
+    int leaf_depth;      // Profundidad de las hojas (-1 sin ver aún)
+    size_t keys;
+    size_t depth_sum;    // Suma de los nodos visitados para encontrar cada llave
+    size_t nodes;
+} TreeCheck;
+
+// Comprueba el subárbol x (llaves en (lo, hi), NULL sin límite)
+static bool check_node(const BTree* tree, const BTreeNode* x, int depth,
+                       const char* lo, const char* hi, TreeCheck* c) {
+    int t = tree->t;
+    bool root = x == tree->root;
+    if (x->n > 2 * t - 1 || (!root && x->n < t - 1) || (!x->leaf && x->n < 1)) return false;
+    c->nodes++;
+    const char *first = x->n ? tree_key(tree, x->keys[0]) : NULL;
+    for (int i = 0; i < x->n; ++i) {
+        const char *k = tree_key(tree, x->keys[i]);
+        if (strncmp(k, first, x->lcp) != 0 || x->prefix[i] != prefix_of(k + x->lcp)) return false;
+        if ((lo && strcmp(lo, k) >= 0) || (hi && strcmp(k, hi) >= 0)) return false;
+        if (!x->leaf && !check_node(tree, x->C[i], depth + 1, lo, k, c)) return false;
+        lo = k;
+        c->keys++;
+        c->depth_sum += (size_t)depth;
+    }
+    if (x->leaf) {
+        if (c->leaf_depth < 0) c->leaf_depth = depth;
+        return c->leaf_depth == depth;
+    }
+    return check_node(tree, x->C[x->n], depth + 1, lo, hi, c);
+}
+
+static bool check_tree(const BTree* tree, TreeCheck* c) {
+    memset(c, 0, sizeof(*c));
+    c->leaf_depth = -1;
+    return check_node(tree, tree->root, 1, NULL, NULL, c) && c->keys == tree->count;
+}
+
+static void bench_btree_delete(size_t n) {
+    char **keys = make_keys(n);
+    long *model = malloc(sizeof(long) * n);     // Valor de cada llave o -1
+    static const int orders[] = { 2, BTREE_T };
+    for (size_t o = 0; o < sizeof(orders) / sizeof(orders[0]); ++o) {
+        BTree *tree = btree_create(orders[o]);
+        bool ok = true;
+        for (size_t i = 0; i < n; ++i) {
+            BTreeValue v = { (long)i, 0, 0, { 0, 0 } };
+            ok &= btree_insert(tree, keys[i], &v);
+            model[i] = (long)i;
+        }
+        TreeCheck full;
+        ok &= check_tree(tree, &full);
+
+        // Mezcla aleatoria: la mitad borrados, la mitad inserciones
+        size_t ops = 2 * n;
+        double t0 = now_sec();
+        for (size_t op = 0; op < ops; ++op) {
+            size_t k = rng_next() % n;
+            if (rng_next() & 1) {
+                ok &= btree_delete(tree, keys[k]) == (model[k] >= 0);
+                model[k] = -1;
+            } else {
+                BTreeValue v = { (long)op, 0, 0, { 0, 0 } };
+                ok &= btree_insert(tree, keys[k], &v);
+                model[k] = (long)op;
+            }
+            if (op % (ops / 8 + 1) == 0) {
+                TreeCheck c;
+                ok &= check_tree(tree, &c);
+            }
+        }
+        double t_mix = now_sec() - t0;
+        for (size_t i = 0; i < n; ++i) ok &= btree_search(tree, keys[i]) == model[i];
+
+        // Borrar casi todo: el árbol debe encoger
+        size_t left = n / 100, deleted = 0;
+        t0 = now_sec();
+        for (size_t i = left; i < n; ++i) {
+            if (model[i] < 0) continue;
+            ok &= btree_delete(tree, keys[i]);
+            model[i] = -1;
+            deleted++;
+        }
+        double t_del = now_sec() - t0;
+        TreeCheck small;
+        ok &= check_tree(tree, &small);
+        for (size_t i = 0; i < n; ++i) ok &= btree_search(tree, keys[i]) == model[i];
+
+        printf("borrado  %8zu llaves  t=%-3d mezcla %7.1f ns/op  borrar %7.1f ns  "
+               "altura %d -> %d  prof. media %.2f -> %.2f  nodos %zu -> %zu  %s\n",
+               n, tree->t, t_mix * 1e9 / (double)ops,
+               deleted ? t_del * 1e9 / (double)deleted : 0.0,
+               full.leaf_depth, small.leaf_depth,
+               full.keys ? (double)full.depth_sum / (double)full.keys : 0.0,
+               small.keys ? (double)small.depth_sum / (double)small.keys : 0.0,
+               full.nodes, small.nodes, ok ? "ok" : "ERROR");
+        btree_destroy(tree);
+    }
+    for (size_t i = 0; i < n; ++i) free(keys[i]);
+    free(keys);
+    free(model);
+}
+
+// -------------------------------------------------------
+// Códecs: velocidad del histograma sobre todos los datos, códec
+// que elige codec_choose y, para cada códec, velocidad y tasa
+// -------------------------------------------------------
+static void bench_codecs(const char *name, uint8_t *(*make)(size_t), size_t size) {
+    static const int ids[] = { CODEC_STORED, CODEC_RLE, CODEC_LZW };
+    uint8_t *data = make(size);
+    uint8_t *dec = malloc(size);
+    double mb = (double)size / (1024.0 * 1024.0);
+
+    uint32_t hist[256];
+    double t0 = now_sec();
+    codec_histogram(data, size, hist);
+    double t_h = now_sec() - t0;
+    double runs;
+    double bits = codec_entropy(data, size, &runs);
+    printf("%-8s %8zu KiB  histograma %9.2f MB/s  entropia %.2f bits  repeticiones %.2f  elegido %s\n",
+           name, size / 1024, mb / t_h, bits, runs, codec_name(codec_choose(data, size)));
+
+    for (size_t i = 0; i < sizeof(ids) / sizeof(ids[0]); ++i) {
+        size_t comp_len = 0, dec_len = 0;
+        t0 = now_sec();
+        uint8_t *comp = codec_compress(ids[i], data, size, &comp_len);
+        double t_c = now_sec() - t0;
+        t0 = now_sec();
+        int ok = comp && codec_decompress_into(comp, comp_len, dec, size, &dec_len);
+        double t_d = now_sec() - t0;
+        ok = ok && dec_len == size && memcmp(dec, data, size) == 0;
+        printf("%-8s %-9s comprimir %9.2f MB/s  descomprimir %9.2f MB/s  ratio %.3f (%s)  %s\n",
+               name, codec_name(ids[i]), mb / t_c, mb / t_d, (double)comp_len / (double)size,
+               comp ? codec_name(codec_format(comp, comp_len)) : "-", ok ? "ok" : "ERROR");
+        free(comp);
+    }
+    free(dec);
+    free(data);
+}
+
+int main(int argc, char **argv) {
+    size_t ref_kib = argc > 1 ? (size_t)atoi(argv[1]) : 256;
+    size_t cur_kib = argc > 2 ? (size_t)atoi(argv[2]) : 16384;
+    size_t nkeys = argc > 3 ? (size_t)atoi(argv[3]) : 200000;
+
+    bench_corpus("texto", make_text, ref_kib * 1024, cur_kib * 1024);
+    bench_corpus("binario", make_binary, ref_kib * 1024, cur_kib * 1024);
+    bench_btree(nkeys);
+    bench_btree_delete(nkeys);
+    bench_codecs("texto", make_text, cur_kib * 1024);
+    bench_codecs("binario", make_binary, cur_kib * 1024);
+    bench_codecs("repetido", make_runs, cur_kib * 1024);
+    return 0;
+}
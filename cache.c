@@ -0,0 +1,162 @@
+#include "cache.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct CacheEntry {
+    CacheEntry *prev, *next;  // Lista LRU
+    CacheEntry *hnext;        // Siguiente en el mismo cubo
+    uint64_t hash;
+    uint8_t *data;
+    size_t len;
+    char name[];              // Nombre (terminado en 0)
+};
+
+#define CACHE_MIN_BUCKETS 64
+
+// FNV-1a de 64 bits
+static uint64_t cache_hash(const char* s) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (; *s; ++s) h = (h ^ (uint8_t)*s) * 0x100000001b3ull;
+    return h;
+}
+
+// Bytes que cuenta una entrada frente al presupuesto
+static size_t entry_cost(size_t name_len, size_t len) {
+    return sizeof(CacheEntry) + name_len + 1 + len;
+}
+
+void cache_init(ContentCache* c, size_t budget) {
+    memset(c, 0, sizeof(*c));
+    c->budget = budget;
+}
+
+static void lru_unlink(ContentCache* c, CacheEntry* e) {
+    if (e->prev) e->prev->next = e->next; else c->head = e->next;
+    if (e->next) e->next->prev = e->prev; else c->tail = e->prev;
+}
+
+static void lru_push_front(ContentCache* c, CacheEntry* e) {
+    e->prev = NULL;
+    e->next = c->head;
+    if (c->head) c->head->prev = e; else c->tail = e;
+    c->head = e;
+}
+
+// Busca la entrada de name (h es su hash)
+static CacheEntry* cache_find(ContentCache* c, const char* name, uint64_t h) {
+    if (!c->buckets) return NULL;
+    for (CacheEntry *e = c->buckets[h & (c->nbuckets - 1)]; e; e = e->hnext)
+        if (e->hash == h && strcmp(e->name, name) == 0) return e;
+    return NULL;
+}
+
+// Quita una entrada de la tabla y de la lista y la libera
+static void cache_remove(ContentCache* c, CacheEntry* e) {
+    CacheEntry **link = &c->buckets[e->hash & (c->nbuckets - 1)];
+    while (*link != e) link = &(*link)->hnext;
+    *link = e->hnext;
+    lru_unlink(c, e);
+    c->used -= entry_cost(strlen(e->name), e->len);
+    c->count--;
+    free(e->data);
+    free(e);
+}
+
+// Expulsa desde el final de la lista hasta que quepan extra bytes
+static void cache_evict(ContentCache* c, size_t extra) {
+    while (c->tail && c->used + extra > c->budget) {
+        cache_remove(c, c->tail);
+        c->evictions++;
+    }
+}
+
+// Duplica la tabla cuando hay más entradas que cubos
+static void cache_grow(ContentCache* c) {
+    size_t n = c->nbuckets ? c->nbuckets * 2 : CACHE_MIN_BUCKETS;
+    CacheEntry **b = calloc(n, sizeof(CacheEntry*));
+    if (!b) return;
+    for (size_t i = 0; i < c->nbuckets; ++i) {
+        CacheEntry *e = c->buckets[i];
+        while (e) {
+            CacheEntry *next = e->hnext;
+            e->hnext = b[e->hash & (n - 1)];
+            b[e->hash & (n - 1)] = e;
+            e = next;
+        }
+    }
+    free(c->buckets);
+    c->buckets = b;
+    c->nbuckets = n;
+}
+
+const uint8_t* cache_get(ContentCache* c, const char* name, size_t* len) {
+    CacheEntry *e = cache_find(c, name, cache_hash(name));
+    if (!e) {
+        c->misses++;
+        return NULL;
+    }
+    c->hits++;
+    if (c->head != e) {
+        lru_unlink(c, e);
+        lru_push_front(c, e);
+    }
+    *len = e->len;
+    return e->data;
+}
+
+bool cache_accepts(const ContentCache* c, size_t len) {
+    return c->budget > 0 && len <= c->budget / CACHE_MAX_ENTRY_DIV;
+}
+
+void cache_put(ContentCache* c, const char* name, uint8_t* data, size_t len) {
+    size_t name_len = strlen(name);
+    size_t cost = entry_cost(name_len, len);
+    if (!cache_accepts(c, len) || cost > c->budget) {
+        free(data);
+        return;
+    }
+    cache_invalidate(c, name);
+    if (c->count >= c->nbuckets) cache_grow(c);
+    if (!c->buckets) {
+        free(data);
+        return;
+    }
+
+    CacheEntry *e = malloc(sizeof(CacheEntry) + name_len + 1);
+    if (!e) {
+        free(data);
+        return;
+    }
+    memcpy(e->name, name, name_len + 1);
+    e->hash = cache_hash(name);
+    e->data = data;
+    e->len = len;
+
+    cache_evict(c, cost);
+    e->hnext = c->buckets[e->hash & (c->nbuckets - 1)];
+    c->buckets[e->hash & (c->nbuckets - 1)] = e;
+    lru_push_front(c, e);
+    c->used += cost;
+    c->count++;
+}
+
+void cache_invalidate(ContentCache* c, const char* name) {
+    CacheEntry *e = cache_find(c, name, cache_hash(name));
+    if (e) cache_remove(c, e);
+}
+
+void cache_clear(ContentCache* c) {
+    while (c->tail) cache_remove(c, c->tail);
+}
+
+void cache_set_budget(ContentCache* c, size_t budget) {
+    c->budget = budget;
+    cache_evict(c, 0);
+}
+
+void cache_free(ContentCache* c) {
+    cache_clear(c);
+    free(c->buckets);
+    c->buckets = NULL;
+    c->nbuckets = 0;
+}
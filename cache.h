@@ -0,0 +1,51 @@
+#ifndef CACHE_H
+#define CACHE_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// -------------------------------------------------------
+// Caché LRU del contenido descomprimido de los archivos, indexada
+// por nombre. El espacio ocupado (datos, nombre y entrada) no
+// supera budget; al insertar se expulsan los menos usados. Los
+// archivos mayores que budget / CACHE_MAX_ENTRY_DIV no se guardan,
+// para que uno solo no vacíe la caché.
+// -------------------------------------------------------
+typedef struct CacheEntry CacheEntry;
+
+typedef struct {
+    CacheEntry **buckets;    // Tabla hash encadenada
+    size_t nbuckets;         // Potencia de dos
+    size_t count;
+    CacheEntry *head;        // Más reciente
+    CacheEntry *tail;        // Menos reciente
+    size_t used;             // Bytes ocupados
+    size_t budget;           // Máximo de bytes (0 = desactivada)
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+} ContentCache;
+
+#define CACHE_DEFAULT_BUDGET (64 * 1024 * 1024)
+#define CACHE_MAX_ENTRY_DIV 4
+
+void cache_init(ContentCache* c, size_t budget);
+void cache_free(ContentCache* c);
+
+// Contenido de name (y su tamaño) o NULL; cuenta acierto o fallo.
+// El puntero es válido hasta la siguiente modificación de la caché.
+const uint8_t* cache_get(ContentCache* c, const char* name, size_t* len);
+
+// Indica si un archivo de len bytes cabe en la caché
+bool cache_accepts(const ContentCache* c, size_t len);
+
+// Guarda data (reservado con malloc) bajo name; la caché pasa a ser
+// su dueña y lo libera si no lo acepta
+void cache_put(ContentCache* c, const char* name, uint8_t* data, size_t len);
+
+void cache_invalidate(ContentCache* c, const char* name);
+void cache_clear(ContentCache* c);
+void cache_set_budget(ContentCache* c, size_t budget);
+
+#endif // CACHE_H
@@ -0,0 +1,619 @@
+#include "codec.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Cabecera común ["FSZ"][u8 códec][u64 tamaño original]
+static void write_header(uint8_t* out, int id, uint64_t orig_size) {
+    memcpy(out, LZW_MAGIC, 3);
+    out[3] = (uint8_t)id;
+    memcpy(out + 4, &orig_size, sizeof(uint64_t));
+}
+
+// Sink en memoria de capacidad fija
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+} MemSink;
+
+static int mem_sink(void *user, const uint8_t *data, size_t len) {
+    MemSink *m = user;
+    if (m->len + len > m->cap) return 0;
+    memcpy(m->data + m->len, data, len);
+    m->len += len;
+    return 1;
+}
+
+// ------------------------------------------------------
+// LZW: envoltorios de la API de compression.h
+// ------------------------------------------------------
+static size_t lzw_bound(size_t n) {
+    return LZW_HEADER_SIZE + (n + n / LZW_CHECK_GAP + 2) * sizeof(uint16_t) + sizeof(uint64_t);
+}
+static void* lzw_enc_init_c(uint64_t orig_size, codec_sink sink, void* user) {
+    return lzw_enc_init(orig_size, sink, user);
+}
+static int lzw_enc_feed_c(void* ctx, const uint8_t* input, size_t n) { return lzw_enc_feed(ctx, input, n); }
+static int lzw_enc_finish_c(void* ctx, size_t* out) { return lzw_enc_finish(ctx, out); }
+static void* lzw_dec_init_c(size_t comp_size, codec_sink sink, void* user) {
+    return lzw_dec_init(comp_size, sink, user);
+}
+static int lzw_dec_feed_c(void* ctx, const uint8_t* input, size_t n) { return lzw_dec_feed(ctx, input, n); }
+static int lzw_dec_finish_c(void* ctx, uint64_t* out) { return lzw_dec_finish(ctx, out); }
+
+// ------------------------------------------------------
+// Guardado: la cabecera y los bytes tal cual
+// ------------------------------------------------------
+typedef struct {
+    codec_sink sink;
+    void *user;
+    uint64_t orig_size;      // Tamaño declarado
+    uint64_t done;           // Bytes de datos ya entregados
+    size_t skip;             // Cabecera por saltar (al descomprimir)
+    size_t comp_size;
+    int failed;
+} StoredCtx;
+
+static size_t stored_bound(size_t n) { return LZW_HEADER_SIZE + n; }
+
+static void* stored_enc_init(uint64_t orig_size, codec_sink sink, void* user) {
+    StoredCtx *s = calloc(1, sizeof(StoredCtx));
+    if (!s) return NULL;
+    uint8_t header[LZW_HEADER_SIZE];
+    write_header(header, CODEC_STORED, orig_size);
+    s->sink = sink;
+    s->user = user;
+    s->orig_size = orig_size;
+    s->failed = !sink(user, header, sizeof(header));
+    return s;
+}
+
+static int stored_enc_feed(void* ctx, const uint8_t* input, size_t n) {
+    StoredCtx *s = ctx;
+    if (s->failed || s->done + n > s->orig_size) s->failed = 1;
+    else if (n > 0 && !s->sink(s->user, input, n)) s->failed = 1;
+    s->done += n;
+    return !s->failed;
+}
+
+static int stored_enc_finish(void* ctx, size_t* out) {
+    StoredCtx *s = ctx;
+    int ok = !s->failed && s->done == s->orig_size;
+    if (out) *out = LZW_HEADER_SIZE + (size_t)s->done;
+    free(s);
+    return ok;
+}
+
+static void* stored_dec_init(size_t comp_size, codec_sink sink, void* user) {
+    StoredCtx *s = calloc(1, sizeof(StoredCtx));
+    if (!s) return NULL;
+    s->sink = sink;
+    s->user = user;
+    s->skip = LZW_HEADER_SIZE;
+    s->comp_size = comp_size;
+    s->orig_size = comp_size >= LZW_HEADER_SIZE ? comp_size - LZW_HEADER_SIZE : 0;
+    s->failed = comp_size < LZW_HEADER_SIZE;
+    return s;
+}
+
+static int stored_dec_feed(void* ctx, const uint8_t* input, size_t n) {
+    StoredCtx *s = ctx;
+    if (s->failed) return 0;
+    size_t k = n < s->skip ? n : s->skip;
+    input += k;
+    n -= k;
+    s->skip -= k;
+    if (s->done + n > s->orig_size) return s->failed = 1, 0;
+    if (n > 0 && !s->sink(s->user, input, n)) return s->failed = 1, 0;
+    s->done += n;
+    return 1;
+}
+
+static int stored_dec_finish(void* ctx, uint64_t* out) {
+    StoredCtx *s = ctx;
+    int ok = !s->failed && s->skip == 0 && s->done == s->orig_size;
+    if (out) *out = s->done;
+    free(s);
+    return ok;
+}
+
+static int stored_decode(const uint8_t* input, size_t input_size, uint8_t* out, size_t cap, size_t* out_len) {
+    uint64_t orig_size;
+    if (input_size < LZW_HEADER_SIZE) return 0;
+    memcpy(&orig_size, input + 4, sizeof(uint64_t));
+    if (orig_size != input_size - LZW_HEADER_SIZE || orig_size > cap) return 0;
+    memcpy(out, input + LZW_HEADER_SIZE, (size_t)orig_size);
+    *out_len = (size_t)orig_size;
+    return 1;
+}
+
+// ------------------------------------------------------
+// RLE. Los bytes se acumulan como literales hasta encontrar una
+// repetición de al menos RLE_MIN_RUN, que se emite como un par
+// (control, byte). Un literal o una repetición nunca pasan de 128
+// y 130 bytes, así que lo peor que crece la salida es 1/128.
+// ------------------------------------------------------
+#define RLE_MAX_LIT 128
+#define RLE_MIN_RUN 3
+#define RLE_MAX_RUN (RLE_MIN_RUN + 127)
+
+typedef struct {
+    codec_sink sink;
+    void *user;
+    uint64_t orig_size;
+    uint64_t consumed;
+    uint8_t lit[RLE_MAX_LIT];   // Literales pendientes
+    int nlit;
+    uint8_t run_byte;           // Repetición en curso
+    int run_len;
+    uint8_t *buf;               // Salida pendiente
+    size_t buf_len;
+    size_t written;
+    int failed;
+} RleEnc;
+
+static size_t rle_bound(size_t n) { return LZW_HEADER_SIZE + n + n / RLE_MAX_LIT + 1; }
+
+static int rle_flush(RleEnc* e) {
+    if (e->buf_len > 0 && !e->failed) {
+        if (!e->sink(e->user, e->buf, e->buf_len)) e->failed = 1;
+        e->written += e->buf_len;
+    }
+    e->buf_len = 0;
+    return !e->failed;
+}
+
+// Asegura hueco para el siguiente grupo (como mucho 1 + 128 bytes)
+static int rle_room(RleEnc* e) {
+    return e->buf_len + 1 + RLE_MAX_LIT <= LZW_STREAM_BUF || rle_flush(e);
+}
+
+static int rle_emit_lit(RleEnc* e) {
+    if (e->nlit == 0) return 1;
+    if (!rle_room(e)) return 0;
+    e->buf[e->buf_len++] = (uint8_t)(e->nlit - 1);
+    memcpy(e->buf + e->buf_len, e->lit, (size_t)e->nlit);
+    e->buf_len += (size_t)e->nlit;
+    e->nlit = 0;
+    return 1;
+}
+
+// Cierra la repetición en curso: larga como par, corta como literales
+static int rle_end_run(RleEnc* e) {
+    if (e->run_len >= RLE_MIN_RUN) {
+        if (!rle_emit_lit(e) || !rle_room(e)) return 0;
+        e->buf[e->buf_len++] = (uint8_t)(128 + e->run_len - RLE_MIN_RUN);
+        e->buf[e->buf_len++] = e->run_byte;
+    } else {
+        for (int i = 0; i < e->run_len; ++i) {
+            if (e->nlit == RLE_MAX_LIT && !rle_emit_lit(e)) return 0;
+            e->lit[e->nlit++] = e->run_byte;
+        }
+    }
+    e->run_len = 0;
+    return 1;
+}
+
+static void* rle_enc_init(uint64_t orig_size, codec_sink sink, void* user) {
+    RleEnc *e = calloc(1, sizeof(RleEnc));
+    if (!e) return NULL;
+    e->buf = malloc(LZW_STREAM_BUF);
+    if (!e->buf) {
+        free(e);
+        return NULL;
+    }
+    e->sink = sink;
+    e->user = user;
+    e->orig_size = orig_size;
+    write_header(e->buf, CODEC_RLE, orig_size);
+    e->buf_len = LZW_HEADER_SIZE;
+    return e;
+}
+
+static int rle_enc_feed(void* ctx, const uint8_t* input, size_t n) {
+    RleEnc *e = ctx;
+    if (e->failed) return 0;
+    for (size_t i = 0; i < n; ++i) {
+        uint8_t c = input[i];
+        if (e->run_len > 0 && c == e->run_byte && e->run_len < RLE_MAX_RUN) {
+            e->run_len++;
+            continue;
+        }
+        if (!rle_end_run(e)) return 0;
+        e->run_byte = c;
+        e->run_len = 1;
+    }
+    e->consumed += n;
+    return 1;
+}
+
+static int rle_enc_finish(void* ctx, size_t* out) {
+    RleEnc *e = ctx;
+    if (!e->failed && rle_end_run(e) && rle_emit_lit(e)) rle_flush(e);
+    int ok = !e->failed && e->consumed == e->orig_size;
+    if (out) *out = e->written;
+    free(e->buf);
+    free(e);
+    return ok;
+}
+
+typedef struct {
+    codec_sink sink;
+    void *user;
+    uint8_t header[LZW_HEADER_SIZE];
+    size_t header_len;
+    uint64_t orig_size;
+    uint64_t done;           // Bytes producidos
+    int lit;                 // Literales que faltan del grupo en curso
+    int run;                 // Repetición cuyo byte aún no llegó
+    uint8_t *buf;
+    size_t buf_len;
+    int failed;
+} RleDec;
+
+// Decodifica [*in, end) en out (hasta cap bytes); se detiene al
+// llenar out o agotar la entrada y devuelve los bytes escritos
+static size_t rle_step(RleDec* d, const uint8_t** in, const uint8_t* end, uint8_t* out, size_t cap) {
+    const uint8_t *p = *in;
+    size_t o = 0;
+    while (p < end && o < cap) {
+        if (d->lit > 0) {
+            size_t k = (size_t)d->lit;
+            if (k > (size_t)(end - p)) k = (size_t)(end - p);
+            if (k > cap - o) k = cap - o;
+            memcpy(out + o, p, k);
+            p += k;
+            o += k;
+            d->lit -= (int)k;
+        } else if (d->run > 0) {
+            if (cap - o < (size_t)d->run) break;
+            memset(out + o, *p++, (size_t)d->run);
+            o += (size_t)d->run;
+            d->run = 0;
+        } else {
+            uint8_t c = *p++;
+            if (c < 128) d->lit = c + 1;
+            else d->run = c - 128 + RLE_MIN_RUN;
+        }
+    }
+    *in = p;
+    return o;
+}
+
+static void* rle_dec_init(size_t comp_size, codec_sink sink, void* user) {
+    RleDec *d = calloc(1, sizeof(RleDec));
+    if (!d) return NULL;
+    d->buf = malloc(LZW_STREAM_BUF);
+    if (!d->buf) {
+        free(d);
+        return NULL;
+    }
+    d->sink = sink;
+    d->user = user;
+    d->failed = comp_size < LZW_HEADER_SIZE;
+    return d;
+}
+
+static int rle_dec_flush(RleDec* d) {
+    if (d->buf_len > 0 && !d->failed && !d->sink(d->user, d->buf, d->buf_len)) d->failed = 1;
+    d->buf_len = 0;
+    return !d->failed;
+}
+
+static int rle_dec_feed(void* ctx, const uint8_t* input, size_t n) {
+    RleDec *d = ctx;
+    if (d->failed) return 0;
+    while (n > 0 && d->header_len < LZW_HEADER_SIZE) {
+        d->header[d->header_len++] = *input++;
+        n--;
+        if (d->header_len == LZW_HEADER_SIZE) memcpy(&d->orig_size, d->header + 4, sizeof(uint64_t));
+    }
+    const uint8_t *end = input + n;
+    while (input < end) {
+        if (d->buf_len + RLE_MAX_RUN > LZW_STREAM_BUF && !rle_dec_flush(d)) return 0;
+        size_t k = rle_step(d, &input, end, d->buf + d->buf_len, LZW_STREAM_BUF - d->buf_len);
+        d->buf_len += k;
+        d->done += k;
+        if (d->done > d->orig_size) return d->failed = 1, 0;
+    }
+    return 1;
+}
+
+static int rle_dec_finish(void* ctx, uint64_t* out) {
+    RleDec *d = ctx;
+    rle_dec_flush(d);
+    int ok = !d->failed && d->header_len == LZW_HEADER_SIZE && d->lit == 0 && d->run == 0 &&
+             d->done == d->orig_size;
+    if (out) *out = d->done;
+    free(d->buf);
+    free(d);
+    return ok;
+}
+
+static int rle_decode(const uint8_t* input, size_t input_size, uint8_t* out, size_t cap, size_t* out_len) {
+    uint64_t orig_size;
+    if (input_size < LZW_HEADER_SIZE) return 0;
+    memcpy(&orig_size, input + 4, sizeof(uint64_t));
+    if (orig_size > cap) return 0;
+    RleDec d;
+    memset(&d, 0, sizeof(d));
+    const uint8_t *p = input + LZW_HEADER_SIZE, *end = input + input_size;
+    size_t o = 0;
+    while (p < end) {
+        const uint8_t *before = p;
+        o += rle_step(&d, &p, end, out + o, (size_t)orig_size - o);
+        if (p == before) return 0;  // Se pasa del tamaño declarado
+    }
+    *out_len = o;
+    return o == orig_size && d.lit == 0 && d.run == 0;
+}
+
+// ------------------------------------------------------
+// Registro
+// ------------------------------------------------------
+static const Codec codecs[] = {
+    { CODEC_LZW, "lzw", lzw_bound, lzw_enc_init_c, lzw_enc_feed_c, lzw_enc_finish_c,
+      lzw_dec_init_c, lzw_dec_feed_c, lzw_dec_finish_c, lzw_decompress_into },
+    { CODEC_STORED, "guardado", stored_bound, stored_enc_init, stored_enc_feed, stored_enc_finish,
+      stored_dec_init, stored_dec_feed, stored_dec_finish, stored_decode },
+    { CODEC_RLE, "rle", rle_bound, rle_enc_init, rle_enc_feed, rle_enc_finish,
+      rle_dec_init, rle_dec_feed, rle_dec_finish, rle_decode },
+    // Formato original: solo se lee
+    { LZW_VERSION_FIXED, "lzw-fijo", NULL, NULL, NULL, NULL,
+      lzw_dec_init_c, lzw_dec_feed_c, lzw_dec_finish_c, lzw_decompress_into },
+};
+#define NCODECS (sizeof(codecs) / sizeof(codecs[0]))
+
+const Codec* codec_get(int id) {
+    for (size_t i = 0; i < NCODECS; ++i)
+        if (codecs[i].id == id) return &codecs[i];
+    return NULL;
+}
+
+const Codec* codec_find(const char* name) {
+    for (size_t i = 0; i < NCODECS; ++i)
+        if (strcmp(codecs[i].name, name) == 0) return &codecs[i];
+    return NULL;
+}
+
+const char* codec_name(int id) {
+    if (id == CODEC_BLOCKS) return "bloques";
+    const Codec *c = codec_get(id);
+    return c ? c->name : "?";
+}
+
+// ------------------------------------------------------
+// Histograma con cuatro tablas: cada byte de una palabra de 32
+// bits incrementa una tabla distinta, así los incrementos de
+// bytes iguales seguidos no esperan unos a otros
+// ------------------------------------------------------
+void codec_histogram(const uint8_t* data, size_t len, uint32_t hist[256]) {
+    uint32_t h[4][256];
+    memset(h, 0, sizeof(h));
+    size_t i = 0;
+    for (; i + 4 <= len; i += 4) {
+        uint32_t w;
+        memcpy(&w, data + i, sizeof(w));
+        h[0][w & 0xff]++;
+        h[1][(w >> 8) & 0xff]++;
+        h[2][(w >> 16) & 0xff]++;
+        h[3][w >> 24]++;
+    }
+    for (; i < len; ++i) h[0][data[i]]++;
+    for (int b = 0; b < 256; ++b) hist[b] = h[0][b] + h[1][b] + h[2][b] + h[3][b];
+}
+
+// Bytes iguales al anterior dentro de [data, data + len)
+static size_t count_repeats(const uint8_t* data, size_t len) {
+    size_t n = 0;
+    for (size_t i = 1; i < len; ++i) n += data[i] == data[i - 1];
+    return n;
+}
+
+double codec_entropy(const uint8_t* data, size_t len, double* runs) {
+    uint32_t hist[256], part[256];
+    size_t total = 0, repeats = 0;
+    memset(hist, 0, sizeof(hist));
+
+    // Datos grandes: CODEC_SAMPLE_SLICES trozos repartidos
+    size_t slices = len > CODEC_SAMPLE ? CODEC_SAMPLE_SLICES : 1;
+    size_t slice = len > CODEC_SAMPLE ? CODEC_SAMPLE / CODEC_SAMPLE_SLICES : len;
+    for (size_t s = 0; s < slices; ++s) {
+        const uint8_t *p = data + (slices > 1 ? (len - slice) / (slices - 1) * s : 0);
+        codec_histogram(p, slice, part);
+        for (int b = 0; b < 256; ++b) hist[b] += part[b];
+        repeats += count_repeats(p, slice);
+        total += slice;
+    }
+
+    if (runs) *runs = total > slices ? (double)repeats / (double)(total - slices) : 0.0;
+    if (total == 0) return 0.0;
+    double bits = 0.0;
+    for (int b = 0; b < 256; ++b) {
+        if (hist[b] == 0) continue;
+        double p = (double)hist[b] / (double)total;
+        bits -= p * log2(p);
+    }
+    return bits;
+}
+
+// ------------------------------------------------------
+// Las repeticiones no cuentan en la entropía de orden 0, así que
+// se descuentan: bits * (1 - runs). Por debajo de CODEC_LZW_BITS LZW
+// siempre gana; por encima de CODEC_STORED_BITS nunca. En medio
+// decide una prueba con LZW sobre los primeros CODEC_TRIAL bytes.
+// ------------------------------------------------------
+static int lzw_trial_gains(const uint8_t* data, size_t len) {
+    size_t n = len < CODEC_TRIAL ? len : CODEC_TRIAL;
+    size_t out = 0;
+    uint8_t *c = lzw_compress(data, n, &out);
+    free(c);
+    return c && out < n;
+}
+
+int codec_choose(const uint8_t* data, size_t len) {
+    double runs;
+    double bits = codec_entropy(data, len, &runs);
+    if (len < LZW_HEADER_SIZE) return CODEC_STORED;
+    if (runs >= CODEC_RLE_RUNS) return CODEC_RLE;
+    bits *= 1.0 - runs;
+    if (bits >= CODEC_STORED_BITS) return CODEC_STORED;
+    if (bits <= CODEC_LZW_BITS) return CODEC_LZW;
+    return lzw_trial_gains(data, len) ? CODEC_LZW : CODEC_STORED;
+}
+
+// ------------------------------------------------------
+// Compresión y descompresión de un bloque en memoria
+// ------------------------------------------------------
+static uint8_t* stored_compress(const uint8_t* input, size_t input_size, size_t* out_size) {
+    uint8_t *out = malloc(LZW_HEADER_SIZE + input_size);
+    if (!out) return NULL;
+    write_header(out, CODEC_STORED, (uint64_t)input_size);
+    memcpy(out + LZW_HEADER_SIZE, input, input_size);
+    *out_size = LZW_HEADER_SIZE + input_size;
+    return out;
+}
+
+uint8_t* codec_compress(int id, const uint8_t* input, size_t input_size, size_t* out_size) {
+    if (!input && input_size > 0) return NULL;
+    if (id == CODEC_AUTO) id = codec_choose(input, input_size);
+    const Codec *c = codec_get(id);
+    if (!c || !c->enc_init) return NULL;
+    if (id == CODEC_STORED) return stored_compress(input, input_size, out_size);
+
+    MemSink m = { NULL, 0, c->bound(input_size) };
+    m.data = malloc(m.cap);
+    if (!m.data) return NULL;
+    void *ctx = c->enc_init((uint64_t)input_size, mem_sink, &m);
+    int ok = ctx && c->enc_feed(ctx, input, input_size);
+    if (ctx) ok = c->enc_finish(ctx, out_size) && ok;
+
+    // La estimación falló: mejor sin comprimir que crecer
+    if (!ok || *out_size > LZW_HEADER_SIZE + input_size) {
+        free(m.data);
+        return stored_compress(input, input_size, out_size);
+    }
+    uint8_t *shrunk = realloc(m.data, m.len);
+    return shrunk ? shrunk : m.data;
+}
+
+static int decode_single(const uint8_t* input, size_t input_size, uint8_t* out, size_t cap, size_t* out_len) {
+    const Codec *c = codec_get(codec_format(input, input_size));
+    return c && c->decode(input, input_size, out, cap, out_len);
+}
+
+int codec_decompress_into(const uint8_t* input, size_t input_size, uint8_t* out, size_t cap, size_t* out_len) {
+    if (codec_format(input, input_size) != CODEC_BLOCKS)
+        return decode_single(input, input_size, out, cap, out_len);
+
+    // Contenedor: cada bloque con su códec
+    LZWBlockHeader h;
+    if (!lzw_block_header(input, input_size, &h) || h.orig_size > cap) return 0;
+    const uint8_t *table = input + input_size - (size_t)h.nblocks * sizeof(uint32_t);
+    const uint8_t *block = input + LZW_BLOCKS_HEADER_SIZE;
+    size_t total = 0;
+    for (uint32_t i = 0; i < h.nblocks; ++i) {
+        uint32_t len;
+        memcpy(&len, table + (size_t)i * sizeof(uint32_t), sizeof(uint32_t));
+        if (len > (size_t)(table - block) || codec_format(block, len) == CODEC_BLOCKS) return 0;
+        size_t n = 0;
+        if (!decode_single(block, len, out + total, cap - total, &n)) return 0;
+        total += n;
+        block += len;
+    }
+    *out_len = total;
+    return 1;
+}
+
+int codec_format(const uint8_t* header, size_t comp_size) {
+    return lzw_blob_format(header, comp_size);
+}
+
+int codec_orig_size(const uint8_t* header, size_t comp_size, uint64_t* orig_size) {
+    int id = codec_format(header, comp_size);
+    if (id == CODEC_STORED || id == CODEC_RLE) {
+        memcpy(orig_size, header + 4, sizeof(uint64_t));
+        return id != CODEC_STORED || *orig_size == comp_size - LZW_HEADER_SIZE;
+    }
+    return lzw_orig_size(header, comp_size, orig_size);
+}
+
+// ------------------------------------------------------
+// API incremental común
+// ------------------------------------------------------
+struct CodecEnc {
+    const Codec *c;
+    void *ctx;
+};
+
+struct CodecDec {
+    const Codec *c;          // NULL hasta completar la cabecera
+    void *ctx;
+    uint8_t header[LZW_HEADER_SIZE];
+    size_t header_len;
+    size_t comp_size;
+    codec_sink sink;
+    void *user;
+    int failed;
+};
+
+CodecEnc* codec_enc_init(int id, uint64_t orig_size, codec_sink sink, void* user) {
+    const Codec *c = codec_get(id);
+    if (!c || !c->enc_init) return NULL;
+    CodecEnc *e = malloc(sizeof(CodecEnc));
+    if (!e) return NULL;
+    e->c = c;
+    e->ctx = c->enc_init(orig_size, sink, user);
+    if (!e->ctx) {
+        free(e);
+        return NULL;
+    }
+    return e;
+}
+
+int codec_enc_feed(CodecEnc* e, const uint8_t* input, size_t input_size) {
+    return e && e->c->enc_feed(e->ctx, input, input_size);
+}
+
+int codec_enc_finish(CodecEnc* e, size_t* out_size) {
+    if (!e) return 0;
+    int ok = e->c->enc_finish(e->ctx, out_size);
+    free(e);
+    return ok;
+}
+
+CodecDec* codec_dec_init(size_t comp_size, codec_sink sink, void* user) {
+    CodecDec *d = calloc(1, sizeof(CodecDec));
+    if (!d) return NULL;
+    d->comp_size = comp_size;
+    d->sink = sink;
+    d->user = user;
+    return d;
+}
+
+int codec_dec_feed(CodecDec* d, const uint8_t* input, size_t input_size) {
+    if (!d || d->failed) return 0;
+    if (!d->c) {
+        while (input_size > 0 && d->header_len < LZW_HEADER_SIZE) {
+            d->header[d->header_len++] = *input++;
+            input_size--;
+        }
+        if (d->header_len < LZW_HEADER_SIZE) return 1;
+        d->c = codec_get(codec_format(d->header, d->comp_size));
+        d->ctx = d->c ? d->c->dec_init(d->comp_size, d->sink, d->user) : NULL;
+        if (!d->ctx || !d->c->dec_feed(d->ctx, d->header, LZW_HEADER_SIZE)) {
+            d->failed = 1;
+            return 0;
+        }
+    }
+    if (input_size > 0 && !d->c->dec_feed(d->ctx, input, input_size)) d->failed = 1;
+    return !d->failed;
+}
+
+int codec_dec_finish(CodecDec* d, uint64_t* out_size) {
+    if (!d) return 0;
+    int ok = d->ctx && d->c->dec_finish(d->ctx, out_size) && !d->failed;
+    free(d);
+    return ok;
+}
@@ -0,0 +1,98 @@
+#ifndef CODEC_H
+#define CODEC_H
+#include "compression.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// -------------------------------------------------------
+// Registro de códecs. Todos los blobs empiezan por la misma
+// cabecera de LZW_HEADER_SIZE bytes ["FSZ"][u8 códec][u64 tamaño
+// original]; el byte de códec (la "versión" de los formatos LZW)
+// dice cómo leer el resto:
+//  - LZW (1 y 2): los formatos de compression.h.
+//  - Contenedor de bloques (3): cada bloque es un blob completo con
+//    su propio códec, así que en un archivo grande cada bloque se
+//    guarda con el que le conviene.
+//  - Guardado (4): los bytes tal cual. Se escribe y se lee a
+//    velocidad de memcpy y no crece más que la cabecera; un rango
+//    se lee directamente, sin descomprimir lo anterior.
+//  - RLE (5): [u8 c] seguido de c + 1 bytes literales (c < 128) o
+//    de un byte que se repite c - 125 veces (c >= 128, de 3 a 130).
+//
+// codec_choose elige el códec de unos datos a partir de una muestra:
+// histograma de bytes (entropía de orden 0) y fracción de bytes que
+// repiten el anterior; en los casos dudosos, una prueba corta con LZW.
+// -------------------------------------------------------
+#define CODEC_AUTO 0                      // Elegir por la muestra
+#define CODEC_LZW LZW_VERSION_VARIABLE
+#define CODEC_BLOCKS LZW_VERSION_BLOCKS
+#define CODEC_STORED 4
+#define CODEC_RLE 5
+
+#define CODEC_SAMPLE (64 * 1024)          // Bytes que mira codec_choose
+#define CODEC_SAMPLE_SLICES 16            // Trozos repartidos por los datos
+#define CODEC_STORED_BITS 7.5             // Entropía (bits/byte) a partir de la que no se comprime
+#define CODEC_LZW_BITS 6.0                // Entropía hasta la que se usa LZW sin probar
+#define CODEC_TRIAL (16 * 1024)           // Bytes de la prueba con LZW entre los dos umbrales
+#define CODEC_RLE_RUNS 0.85               // Fracción de repeticiones a partir de la que se usa RLE
+
+typedef lzw_sink codec_sink;
+typedef struct {
+    int id;                  // Byte de códec de la cabecera
+    const char *name;
+    // Tamaño máximo de la salida para orig bytes
+    size_t (*bound)(size_t orig);
+    // Compresión incremental (el contexto es de cada códec)
+    void* (*enc_init)(uint64_t orig_size, codec_sink sink, void* user);
+    int (*enc_feed)(void* ctx, const uint8_t* input, size_t input_size);
+    int (*enc_finish)(void* ctx, size_t* out_size);
+    // Descompresión incremental: recibe el blob completo, cabecera incluida
+    void* (*dec_init)(size_t comp_size, codec_sink sink, void* user);
+    int (*dec_feed)(void* ctx, const uint8_t* input, size_t input_size);
+    int (*dec_finish)(void* ctx, uint64_t* out_size);
+    // Descompresión de un blob entero en un buffer de cap bytes
+    int (*decode)(const uint8_t* input, size_t input_size, uint8_t* out, size_t cap, size_t* out_len);
+} Codec;
+
+// Códec registrado con ese id o nombre (NULL si no hay)
+const Codec* codec_get(int id);
+const Codec* codec_find(const char* name);
+// Nombre del formato de un id, incluido el contenedor de bloques
+const char* codec_name(int id);
+
+// Histograma de bytes con cuatro tablas parciales (sin dependencias
+// entre bytes seguidos, así el compilador puede vectorizarlo)
+void codec_histogram(const uint8_t* data, size_t len, uint32_t hist[256]);
+
+// Entropía de orden 0 en bits por byte y fracción de bytes iguales
+// al anterior (en *runs) de una muestra de los datos
+double codec_entropy(const uint8_t* data, size_t len, double* runs);
+int codec_choose(const uint8_t* data, size_t len);
+
+// Comprime con el códec id (CODEC_AUTO elige); si la salida crece
+// más que un blob guardado, se guarda sin comprimir
+uint8_t* codec_compress(int id, const uint8_t* input, size_t input_size, size_t* out_size);
+
+// Descomprime un blob de cualquier formato (también contenedores)
+int codec_decompress_into(const uint8_t* input, size_t input_size, uint8_t* out, size_t cap, size_t* out_len);
+
+// Formato de un blob a partir de su cabecera, o -1
+int codec_format(const uint8_t* header, size_t comp_size);
+
+// Tamaño original de la cabecera (LZW_HEADER_SIZE bytes) de un blob
+int codec_orig_size(const uint8_t* header, size_t comp_size, uint64_t* orig_size);
+
+// API incremental de cualquier códec. El decodificador elige el
+// códec al completar la cabecera (no acepta contenedores).
+typedef struct CodecEnc CodecEnc;
+typedef struct CodecDec CodecDec;
+
+CodecEnc* codec_enc_init(int id, uint64_t orig_size, codec_sink sink, void* user);
+int codec_enc_feed(CodecEnc* e, const uint8_t* input, size_t input_size);
+int codec_enc_finish(CodecEnc* e, size_t* out_size);
+
+CodecDec* codec_dec_init(size_t comp_size, codec_sink sink, void* user);
+int codec_dec_feed(CodecDec* d, const uint8_t* input, size_t input_size);
+int codec_dec_finish(CodecDec* d, uint64_t* out_size);
+
+#endif // CODEC_H
@@ -1,216 +1,743 @@
 #include "compression.h"
+#include "metrics.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 
-// Estructura para representar una entrada en el diccionario LZW
+// ------------------------------------------------------
+// Tabla hash del diccionario LZW.
+// Asocia cada par (prefijo, carácter) con su código en O(1)
+// usando direccionamiento abierto con sondeo lineal.
+// El tamaño es el doble del máximo de entradas para que el
+// factor de carga nunca supere 0.5.
+// ------------------------------------------------------
+#define DICT_HASH_BITS 17
+#define DICT_HASH_SIZE (1u << DICT_HASH_BITS)
+#define DICT_HASH_MASK (DICT_HASH_SIZE - 1)
+
 typedef struct {
-    unsigned short prefix;   // Código del prefijo (subcadena previa)
-    unsigned char character; // Carácter añadido al prefijo
-    int used;                 // Marca si esta entrada está en uso
-} DictEntry;
+    uint32_t key;   // (prefijo << 8 | carácter) + 1; 0 = vacío
+    uint16_t code;  // Código asignado a la combinación
+} DictSlot;
+
+// Clave única de 24 bits para la combinación (prefijo, carácter)
+static inline uint32_t dict_key(unsigned short prefix, unsigned char ch) {
+    return (((uint32_t)prefix << 8) | ch) + 1;
+}
+
+// Hash multiplicativo (Fibonacci) sobre la clave
+static inline uint32_t dict_hash(uint32_t key) {
+    return (key * 2654435761u) >> (32 - DICT_HASH_BITS);
+}
 
 // ------------------------------------------------------
 // Busca si existe en el diccionario una combinación
-// (prefijo, carácter) y devuelve su índice o -1 si no existe.
+// (prefijo, carácter). Devuelve su código o -1 si no existe;
+// en ese caso *slot queda apuntando a la casilla libre donde
+// debe insertarse.
 // ------------------------------------------------------
-static int dict_find(DictEntry *dict, unsigned short prefix, unsigned char ch, int dict_size) {
-    for (int i = 256; i < dict_size; ++i) { // Solo busca a partir de códigos >255 (entradas nuevas)
-        if (dict[i].used && dict[i].prefix == prefix && dict[i].character == ch)
-            return i;
+static int dict_find(DictSlot *dict, unsigned short prefix, unsigned char ch, uint32_t *slot) {
+    uint32_t key = dict_key(prefix, ch);
+    uint32_t h = dict_hash(key);
+    while (dict[h].key != 0) {
+        if (dict[h].key == key) return dict[h].code;
+        h = (h + 1) & DICT_HASH_MASK;
     }
+    *slot = h;
     return -1;
 }
 
 // ------------------------------------------------------
-// Comprime un buffer usando LZW.
-// Entrada: input, input_size
-// Salida: buffer comprimido (dinámico), tamaño en *out_size_bytes
+// Escritor de bits: acumula códigos en una palabra de 64 bits
+// (LSB primero) y vuelca 32 bits de una sola vez.
 // ------------------------------------------------------
-uint8_t* lzw_compress(const uint8_t* input, size_t input_size, size_t* out_size_bytes) {
-    if (!input) return NULL;
+typedef struct {
+    uint8_t *p;      // Siguiente byte libre de la salida
+    uint64_t acc;    // Bits pendientes
+    int nbits;       // Cantidad de bits pendientes en acc
+} BitWriter;
+
+static inline void bw_put(BitWriter *bw, uint32_t code, int width) {
+    bw->acc |= (uint64_t)code << bw->nbits;
+    bw->nbits += width;
+    if (bw->nbits >= 32) {
+        uint32_t word = (uint32_t)bw->acc;
+        memcpy(bw->p, &word, sizeof(uint32_t));
+        bw->p += sizeof(uint32_t);
+        bw->acc >>= 32;
+        bw->nbits -= 32;
+    }
+}
 
-    // Crear diccionario con 65536 entradas (máximo para uint16_t)
-    DictEntry *dict = calloc(65536, sizeof(DictEntry));
-    if (!dict) return NULL;
+static inline void bw_flush(BitWriter *bw) {
+    while (bw->nbits > 0) {
+        *bw->p++ = (uint8_t)bw->acc;
+        bw->acc >>= 8;
+        bw->nbits -= 8;
+    }
+    bw->nbits = 0;
+}
+
+// Ancho en bits necesario para representar códigos < n (entre 9 y 16)
+static inline int lzw_width(uint32_t n) {
+    if (n <= (1u << LZW_MIN_BITS)) return LZW_MIN_BITS;
+    int w = 32 - __builtin_clz(n - 1);
+    return w > LZW_MAX_BITS ? LZW_MAX_BITS : w;
+}
 
-    // Inicializar con los 256 símbolos básicos
-    for (int i = 0; i < 256; ++i) dict[i].used = 1;
-    int dict_size = 256;
+// ------------------------------------------------------
+// Contexto de compresión incremental. Guarda todo el estado del
+// bucle LZW entre llamadas a lzw_enc_feed y acumula la salida en
+// un buffer fijo que se vuelca al sink cuando se llena.
+// ------------------------------------------------------
+struct LZWEncCtx {
+    DictSlot *dict;          // Tabla hash del diccionario
+    uint32_t dict_size;      // Siguiente código libre
+    unsigned short prefix;   // Prefijo actual
+    int has_prefix;          // Si prefix es válido
+
+    uint64_t declared;       // Tamaño original anunciado en la cabecera
+    uint64_t consumed;       // Bytes de entrada procesados
+
+    // Seguimiento de la tasa de compresión una vez lleno el diccionario
+    uint64_t reset_pos;      // Posición de entrada del último reinicio
+    uint64_t out_bits;       // Bits emitidos desde el último reinicio
+    double best_ratio;       // Mejor tasa observada con este diccionario
+    uint64_t next_check;     // Próxima posición de control
+
+    uint8_t *buf;            // Buffer de salida
+    BitWriter bw;            // Escritor de bits sobre buf
+    size_t written;          // Bytes ya entregados al sink
+    lzw_sink sink;
+    void *user;
+    int failed;
+};
+
+// Entrega al sink los bytes completos del buffer de salida
+static int enc_flush(LZWEncCtx *e) {
+    size_t n = (size_t)(e->bw.p - e->buf);
+    if (n > 0 && !e->failed) {
+        if (!e->sink(e->user, e->buf, n)) e->failed = 1;
+        e->written += n;
+    }
+    e->bw.p = e->buf;
+    return !e->failed;
+}
 
-    unsigned short prefix = 0;
-    int has_prefix = 0;
+LZWEncCtx* lzw_enc_init(uint64_t orig_size, lzw_sink sink, void* user) {
+    LZWEncCtx *e = calloc(1, sizeof(LZWEncCtx));
+    if (!e) return NULL;
+
+    // Crear tabla hash del diccionario. Los 256 símbolos básicos
+    // son implícitos (código = byte) y no ocupan casillas.
+    e->dict = calloc(DICT_HASH_SIZE, sizeof(DictSlot));
+    e->buf = malloc(LZW_STREAM_BUF);
+    if (!e->dict || !e->buf) {
+        free(e->dict);
+        free(e->buf);
+        free(e);
+        return NULL;
+    }
+    e->dict_size = LZW_FIRST_CODE;
+    e->declared = orig_size;
+    e->next_check = LZW_CHECK_GAP;
+    e->sink = sink;
+    e->user = user;
+
+    // ---------------- Cabecera ----------------
+    memcpy(e->buf, LZW_MAGIC, 3);
+    e->buf[3] = LZW_VERSION_VARIABLE;
+    memcpy(e->buf + 4, &orig_size, sizeof(uint64_t));
+    e->bw.p = e->buf + LZW_HEADER_SIZE;
+    return e;
+}
 
-    // Lista dinámica de códigos resultantes
-    uint16_t *codes = malloc(sizeof(uint16_t) * (input_size + 16));
-    size_t codes_cap = input_size + 16;
-    size_t codes_len = 0;
+int lzw_enc_feed(LZWEncCtx* e, const uint8_t* input, size_t input_size) {
+    if (!e || e->failed) return 0;
+    if (input_size == 0) return 1;
+
+    // Copias locales del estado para el bucle principal
+    DictSlot *dict = e->dict;
+    uint32_t dict_size = e->dict_size;
+    unsigned short prefix = e->prefix;
+    BitWriter bw = e->bw;
+    const uint8_t *limit = e->buf + LZW_STREAM_BUF - 2 * sizeof(uint32_t);
+    size_t i = 0;
+
+    // Primer carácter: se guarda como prefijo
+    if (!e->has_prefix) {
+        prefix = input[0];
+        e->has_prefix = 1;
+        i = 1;
+    }
 
     // Recorrido de los bytes de entrada
-    for (size_t idx = 0; idx < input_size; ++idx) {
-        unsigned char ch = input[idx];
-
-        // Primer carácter: se guarda como prefijo
-        if (!has_prefix) {
-            prefix = ch;
-            has_prefix = 1;
-            continue;
-        }
+    for (; i < input_size; ++i) {
+        unsigned char ch = input[i];
 
         // Buscar combinación (prefijo, ch) en el diccionario
-        int found = dict_find(dict, prefix, ch, dict_size);
+        uint32_t slot = 0;
+        int found = dict_find(dict, prefix, ch, &slot);
 
         if (found != -1) {
             // Si existe: el nuevo prefijo es esa entrada
             prefix = (unsigned short)found;
-        } else {
-            // Si no existe: emitir el código actual
-            if (codes_len >= codes_cap) {
-                codes_cap *= 2;
-                codes = realloc(codes, sizeof(uint16_t) * codes_cap);
-            }
-            codes[codes_len++] = prefix;
+            continue;
+        }
 
+        // Si no existe: emitir el código actual
+        int width = lzw_width(dict_size);
+        bw_put(&bw, prefix, width);
+        e->out_bits += (uint64_t)width;
+
+        if (dict_size < LZW_MAX_CODES) {
             // Añadir nueva entrada al diccionario
-            if (dict_size < 65536) {
-                dict[dict_size].used = 1;
-                dict[dict_size].prefix = prefix;
-                dict[dict_size].character = ch;
-                dict_size++;
+            dict[slot].key = dict_key(prefix, ch);
+            dict[slot].code = (uint16_t)dict_size;
+            if (++dict_size == LZW_MAX_CODES) METRIC_ADD(lzw_dict_full, 1);
+        } else {
+            uint64_t idx = e->consumed + i;
+            if (idx >= e->next_check) {
+                // Diccionario lleno: si la tasa empeora, reiniciarlo
+                double ratio = (double)(idx - e->reset_pos) / (double)(e->out_bits ? e->out_bits : 1);
+                if (ratio >= e->best_ratio) {
+                    e->best_ratio = ratio;
+                } else {
+                    bw_put(&bw, LZW_CLEAR_CODE, width);
+                    memset(dict, 0, DICT_HASH_SIZE * sizeof(DictSlot));
+                    dict_size = LZW_FIRST_CODE;
+                    METRIC_ADD(lzw_dict_reset, 1);
+                    e->best_ratio = 0.0;
+                    e->reset_pos = idx;
+                    e->out_bits = 0;
+                }
+                e->next_check = idx + LZW_CHECK_GAP;
             }
-            // Nuevo prefijo = carácter actual
-            prefix = ch;
+        }
+        // Nuevo prefijo = carácter actual
+        prefix = ch;
+
+        // Buffer casi lleno: volcarlo
+        if (bw.p > limit) {
+            e->bw = bw;
+            if (!enc_flush(e)) return 0;
+            bw.p = e->bw.p;
         }
     }
 
+    e->dict_size = dict_size;
+    e->prefix = prefix;
+    e->bw = bw;
+    e->consumed += input_size;
+    return 1;
+}
+
+int lzw_enc_finish(LZWEncCtx* e, size_t* out_size_bytes) {
+    if (!e) return 0;
+
     // Emitir último prefijo si existe
-    if (has_prefix) {
-        if (codes_len >= codes_cap) {
-            codes_cap *= 2;
-            codes = realloc(codes, sizeof(uint16_t) * codes_cap);
+    if (e->has_prefix) bw_put(&e->bw, e->prefix, lzw_width(e->dict_size));
+    bw_flush(&e->bw);
+    enc_flush(e);
+
+    int ok = !e->failed && e->consumed == e->declared;
+    if (out_size_bytes) *out_size_bytes = e->written;
+
+    free(e->dict);
+    free(e->buf);
+    free(e);
+    return ok;
+}
+
+// Sink en memoria para la versión de un solo bloque
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+} MemSink;
+
+static int mem_sink(void *user, const uint8_t *data, size_t len) {
+    MemSink *m = user;
+    if (m->len + len > m->cap) return 0;
+    memcpy(m->data + m->len, data, len);
+    m->len += len;
+    return 1;
+}
+
+// ------------------------------------------------------
+// Comprime un buffer usando LZW con códigos de ancho variable.
+// Entrada: input, input_size
+// Salida: buffer comprimido (dinámico), tamaño en *out_size_bytes
+// ------------------------------------------------------
+uint8_t* lzw_compress(const uint8_t* input, size_t input_size, size_t* out_size_bytes) {
+    if (!input) return NULL;
+
+    // Peor caso: un código de 16 bits por byte más los CLEAR
+    size_t max_codes = input_size + input_size / LZW_CHECK_GAP + 2;
+    MemSink m = { NULL, 0, LZW_HEADER_SIZE + max_codes * sizeof(uint16_t) + sizeof(uint64_t) };
+    m.data = malloc(m.cap);
+    if (!m.data) return NULL;
+
+    LZWEncCtx *e = lzw_enc_init((uint64_t)input_size, mem_sink, &m);
+    if (!e) {
+        free(m.data);
+        return NULL;
+    }
+    int ok = lzw_enc_feed(e, input, input_size);
+    if (!lzw_enc_finish(e, out_size_bytes) || !ok) {
+        free(m.data);
+        return NULL;
+    }
+
+    // Ajustar el buffer al tamaño real
+    uint8_t *shrunk = realloc(m.data, m.len);
+    return shrunk ? shrunk : m.data;
+}
+
+// ------------------------------------------------------
+// Lector de códigos. Para el formato original lee códigos fijos
+// de 16 bits; para el formato de ancho variable recarga hasta 64
+// bits de una vez y extrae cada código con una máscara.
+// ------------------------------------------------------
+typedef struct {
+    const uint8_t *p;    // Siguiente byte sin consumir
+    const uint8_t *end;  // Fin de los datos
+    uint64_t acc;        // Bits cargados pendientes (LSB primero)
+    int nbits;           // Cantidad de bits válidos en acc
+} BitReader;
+
+static inline void br_refill(BitReader *br) {
+    if (br->end - br->p >= 8) {
+        uint64_t word;
+        memcpy(&word, br->p, sizeof(uint64_t));
+        br->acc |= word << br->nbits;
+        br->p += (63 - br->nbits) >> 3;
+        br->nbits |= 56;
+    } else {
+        while (br->nbits <= 56 && br->p < br->end) {
+            br->acc |= (uint64_t)(*br->p++) << br->nbits;
+            br->nbits += 8;
         }
-        codes[codes_len++] = prefix;
     }
+}
 
-    // ---------------- Empaquetar salida ----------------
-    size_t header = sizeof(uint64_t) + sizeof(uint32_t);
-    size_t data_bytes = codes_len * sizeof(uint16_t);
-    *out_size_bytes = header + data_bytes;
+// Devuelve 0 si no quedan bits suficientes para otro código
+static inline int br_get(BitReader *br, int width, uint32_t *code) {
+    if (br->nbits < width) {
+        br_refill(br);
+        if (br->nbits < width) return 0;
+    }
+    *code = (uint32_t)(br->acc & ((1u << width) - 1));
+    br->acc >>= width;
+    br->nbits -= width;
+    return 1;
+}
 
-    uint8_t *outbuf = malloc(*out_size_bytes);
-    uint8_t *p = outbuf;
+// ------------------------------------------------------
+// Identifica el formato de un blob. El formato original no tiene
+// firma (empieza por el tamaño original), así que además de la
+// firma se comprueba que el blob no sea un blob original válido:
+// en ese formato el tamaño total es siempre 12 + 2 * cantidad.
+// ------------------------------------------------------
+int lzw_blob_format(const uint8_t* input, size_t input_size) {
+    if (input_size < LZW_HEADER_SIZE) return -1;
+    uint32_t cnt = 0;
+    memcpy(&cnt, input + sizeof(uint64_t), sizeof(uint32_t));
+    int legacy_ok = cnt > 0 &&
+        (uint64_t)input_size == LZW_HEADER_SIZE + (uint64_t)cnt * sizeof(uint16_t);
+    if (memcmp(input, LZW_MAGIC, 3) == 0 && !legacy_ok)
+        return input[3];
+    return LZW_VERSION_FIXED;
+}
 
-    // Guardar tamaño original (8 bytes)
-    uint64_t orig = (uint64_t)input_size;
-    memcpy(p, &orig, sizeof(uint64_t));
-    p += sizeof(uint64_t);
+// ------------------------------------------------------
+// Tabla plana del decodificador. Cada código guarda solo su
+// prefijo, su último carácter, su primer carácter y su longitud;
+// las frases se reconstruyen recorriendo la cadena de prefijos
+// y escribiendo hacia atrás directamente en la salida.
+//
+// Además se recuerda en qué posición absoluta de la salida se
+// escribió por última vez la frase de cada código: mientras esa
+// posición siga dentro del buffer de salida, la frase se copia
+// con memcpy en lugar de recorrer la cadena. Las frases cortas se
+// siguen reconstruyendo por la cadena: la tabla cabe en caché y la
+// posición antigua de la salida probablemente no.
+// ------------------------------------------------------
+#define DEC_COPY_MIN 4
+typedef struct {
+    uint16_t prefix;     // Código del prefijo
+    uint8_t ch;          // Último carácter de la frase
+    uint8_t first;       // Primer carácter de la frase
+    uint32_t len;        // Longitud de la frase
+} DecEntry;
 
-    // Guardar cantidad de códigos generados (4 bytes)
-    uint32_t cnt = (uint32_t)codes_len;
-    memcpy(p, &cnt, sizeof(uint32_t));
-    p += sizeof(uint32_t);
+typedef struct {
+    DecEntry *tab;       // LZW_MAX_CODES entradas
+    uint64_t *pos;       // Posición absoluta de la frase de cada código
+    uint64_t base;       // Posición absoluta del inicio del buffer de salida
+    uint32_t dict_size;  // Siguiente código libre
+    uint32_t first_code; // Primer código libre tras un reinicio
+    uint32_t prev;       // Código anterior
+    int have_prev;       // Si prev es válido
+} LZWDecoder;
+
+static int dec_init(LZWDecoder *d, uint32_t first_code) {
+    d->tab = malloc(LZW_MAX_CODES * sizeof(DecEntry));
+    d->pos = malloc(LZW_MAX_CODES * sizeof(uint64_t));
+    if (!d->tab || !d->pos) {
+        free(d->tab);
+        free(d->pos);
+        return 0;
+    }
+    for (uint32_t i = 0; i < 256; ++i) {
+        d->tab[i].prefix = 0;
+        d->tab[i].ch = (uint8_t)i;
+        d->tab[i].first = (uint8_t)i;
+        d->tab[i].len = 1;
+    }
+    d->base = 0;
+    d->first_code = first_code;
+    d->dict_size = first_code;
+    d->prev = 0;
+    d->have_prev = 0;
+    return 1;
+}
 
-    // Guardar los códigos (2 bytes cada uno)
-    memcpy(p, codes, data_bytes);
+static void dec_free(LZWDecoder *d) {
+    free(d->tab);
+    free(d->pos);
+}
 
-    // Liberar memoria temporal
-    free(dict);
-    free(codes);
+static void dec_reset(LZWDecoder *d) {
+    d->dict_size = d->first_code;
+    d->have_prev = 0;
+}
 
-    return outbuf;
+// Ancho del siguiente código: el codificador va una entrada por delante
+static inline int dec_width(const LZWDecoder *d) {
+    uint32_t enc_size = d->dict_size + (d->have_prev ? 1 : 0);
+    if (enc_size > LZW_MAX_CODES) enc_size = LZW_MAX_CODES;
+    return lzw_width(enc_size);
+}
+
+// Longitud de la frase que producirá code (0 si el código es inválido)
+static inline uint32_t dec_phrase_len(const LZWDecoder *d, uint32_t code) {
+    if (code < d->dict_size) return d->tab[code].len;
+    if (code == d->dict_size && d->have_prev) return d->tab[d->prev].len + 1;
+    return 0;
 }
 
 // ------------------------------------------------------
-// Descomprime un buffer generado por lzw_compress.
-// Entrada: buffer comprimido, tamaño
-// Salida: buffer original, tamaño en *out_size_bytes
+// Decodifica un código escribiendo su frase en out + out_pos, que
+// debe tener espacio para dec_phrase_len(d, code) bytes, y registra
+// la nueva entrada del diccionario. Devuelve la longitud escrita.
 // ------------------------------------------------------
-uint8_t* lzw_decompress(const uint8_t* input, size_t input_size, size_t* out_size_bytes) {
-    if (!input || input_size < (sizeof(uint64_t) + sizeof(uint32_t))) return NULL;
+static inline uint32_t dec_code(LZWDecoder *d, uint32_t code, uint8_t *out, size_t out_pos) {
+    DecEntry *tab = d->tab;
+    uint8_t *dst = out + out_pos;
+    uint64_t at = d->base + out_pos;
+    uint32_t len, c;
+
+    if (code < d->dict_size) {
+        len = tab[code].len;
+        c = code;
+    } else {
+        // Caso especial (KwKwK): frase anterior + su primer carácter
+        len = tab[d->prev].len + 1;
+        dst[len - 1] = tab[d->prev].first;
+        c = d->prev;
+    }
 
-    const uint8_t *p = input;
-    uint64_t orig_size = 0;
-    memcpy(&orig_size, p, sizeof(uint64_t));
-    p += sizeof(uint64_t);
+    if (c < 256) {
+        dst[0] = (uint8_t)c;
+    } else if (tab[c].len > DEC_COPY_MIN && d->pos[c] >= d->base) {
+        // Frase larga que sigue en el buffer: copiarla
+        memcpy(dst, out + (d->pos[c] - d->base), tab[c].len);
+    } else {
+        // Recorrer la cadena de prefijos escribiendo hacia atrás
+        uint8_t *w = dst + tab[c].len;
+        while (c >= 256) {
+            *--w = tab[c].ch;
+            c = tab[c].prefix;
+        }
+        *--w = (uint8_t)c;
+    }
+
+    // Añadir nueva entrada: frase anterior + primer carácter de la
+    // actual. Su frase es justo la anterior seguida de esta.
+    if (d->have_prev && d->dict_size < LZW_MAX_CODES) {
+        uint32_t prev_len = tab[d->prev].len;
+        DecEntry *e = &tab[d->dict_size];
+        e->prefix = (uint16_t)d->prev;
+        e->ch = dst[0];
+        e->first = tab[d->prev].first;
+        e->len = prev_len + 1;
+        d->pos[d->dict_size] = at - prev_len;
+        d->dict_size++;
+    }
+    if (code >= 256 && code < d->dict_size) d->pos[code] = at;
+    d->prev = code;
+    d->have_prev = 1;
+    return len;
+}
 
+// ------------------------------------------------------
+// Decodifica un blob simple (formato original o variable) en out,
+// que tiene espacio para cap bytes. El tamaño original declarado
+// debe caber en out.
+// ------------------------------------------------------
+static int decode_single(const uint8_t* input, size_t input_size, int version,
+                         uint8_t* out, size_t cap, size_t* out_len) {
+    uint64_t orig_size = 0;
     uint32_t cnt = 0;
-    memcpy(&cnt, p, sizeof(uint32_t));
-    p += sizeof(uint32_t);
+    LZWDecoder dec;
+    if (version == LZW_VERSION_FIXED) {
+        memcpy(&orig_size, input, sizeof(uint64_t));
+        memcpy(&cnt, input + sizeof(uint64_t), sizeof(uint32_t));
+        if ((uint64_t)input_size < LZW_HEADER_SIZE + (uint64_t)cnt * sizeof(uint16_t)) return 0;
+        if (orig_size > cap || !dec_init(&dec, 256)) return 0;
+    } else {
+        memcpy(&orig_size, input + 4, sizeof(uint64_t));
+        if (orig_size > cap || !dec_init(&dec, LZW_FIRST_CODE)) return 0;
+    }
 
-    const uint16_t *codes = (const uint16_t *)p;
+    size_t out_pos = 0;
+    int ok = 1;
+
+    if (version == LZW_VERSION_FIXED) {
+        const uint8_t *codes = input + LZW_HEADER_SIZE;
+        for (uint32_t i = 0; i < cnt; ++i) {
+            uint16_t code;
+            memcpy(&code, codes + (size_t)i * sizeof(uint16_t), sizeof(uint16_t));
+            uint32_t len = dec_phrase_len(&dec, code);
+            if (len == 0 || out_pos + len > orig_size) { ok = 0; break; }
+            out_pos += dec_code(&dec, code, out, out_pos);
+        }
+    } else {
+        BitReader br = { input + LZW_HEADER_SIZE, input + input_size, 0, 0 };
+        uint32_t code;
+        while (out_pos < orig_size && br_get(&br, dec_width(&dec), &code)) {
+            if (code == LZW_CLEAR_CODE) {
+                dec_reset(&dec);
+                continue;
+            }
+            uint32_t len = dec_phrase_len(&dec, code);
+            if (len == 0 || out_pos + len > orig_size) { ok = 0; break; }
+            out_pos += dec_code(&dec, code, out, out_pos);
+        }
+    }
+    dec_free(&dec);
 
-    // Diccionario de secuencias
-    unsigned char **seq = calloc(65536, sizeof(unsigned char*));
-    size_t *seqlen = calloc(65536, sizeof(size_t));
+    // Datos corruptos: códigos inválidos o más bytes que los declarados
+    *out_len = out_pos;
+    return ok;
+}
 
-    // Inicializar con símbolos básicos
-    for (int i = 0; i < 256; ++i) {
-        seq[i] = malloc(1);
-        seq[i][0] = (unsigned char)i;
-        seqlen[i] = 1;
+// ------------------------------------------------------
+// Descomprime un blob en un buffer ya reservado de cap bytes.
+// Los contenedores de bloques se decodifican bloque a bloque.
+// ------------------------------------------------------
+int lzw_decompress_into(const uint8_t* input, size_t input_size, uint8_t* out, size_t cap, size_t* out_len) {
+    if (!input) return 0;
+    int version = lzw_blob_format(input, input_size);
+    if (version == LZW_VERSION_FIXED || version == LZW_VERSION_VARIABLE)
+        return decode_single(input, input_size, version, out, cap, out_len);
+    if (version != LZW_VERSION_BLOCKS) return 0;
+
+    LZWBlockHeader h;
+    if (!lzw_block_header(input, input_size, &h) || h.orig_size > cap) return 0;
+    const uint8_t *table = input + input_size - (size_t)h.nblocks * sizeof(uint32_t);
+    const uint8_t *block = input + LZW_BLOCKS_HEADER_SIZE;
+    size_t total = 0;
+    for (uint32_t i = 0; i < h.nblocks; ++i) {
+        uint32_t len;
+        memcpy(&len, table + (size_t)i * sizeof(uint32_t), sizeof(uint32_t));
+        if (len > (size_t)(table - block)) return 0;
+        int v = lzw_blob_format(block, len);
+        size_t n = 0;
+        if ((v != LZW_VERSION_FIXED && v != LZW_VERSION_VARIABLE) ||
+            !decode_single(block, len, v, out + total, cap - total, &n))
+            return 0;
+        total += n;
+        block += len;
     }
-    int dict_size = 256;
+    *out_len = total;
+    return 1;
+}
+
+// ------------------------------------------------------
+// Descomprime un buffer generado por lzw_compress.
+// Acepta el formato original (códigos fijos de 16 bits), el de
+// ancho variable con códigos CLEAR y los contenedores de bloques.
+// La salida se reserva una sola vez con el tamaño indicado en la
+// cabecera.
+// Entrada: buffer comprimido, tamaño
+// Salida: buffer original, tamaño en *out_size_bytes
+// ------------------------------------------------------
+uint8_t* lzw_decompress(const uint8_t* input, size_t input_size, size_t* out_size_bytes) {
+    if (!input || input_size < LZW_HEADER_SIZE) return NULL;
+    uint64_t orig_size = 0;
+    if (!lzw_orig_size(input, input_size, &orig_size)) return NULL;
 
     // Buffer de salida
     uint8_t *out = malloc(orig_size ? orig_size : 1);
-    size_t out_pos = 0;
+    if (!out) return NULL;
+    if (!lzw_decompress_into(input, input_size, out, orig_size, out_size_bytes)) {
+        free(out);
+        return NULL;
+    }
+    return out;
+}
+
+// ------------------------------------------------------
+// Contexto de descompresión incremental. Los bytes comprimidos
+// llegan por trozos; los bits sobrantes de un trozo se conservan
+// en el acumulador y la salida se vuelca al sink cada vez que el
+// buffer fijo no tiene sitio para la siguiente frase.
+// ------------------------------------------------------
+struct LZWDecCtx {
+    LZWDecoder d;            // Tabla del diccionario
+    uint8_t header[LZW_HEADER_SIZE];
+    size_t header_len;       // Bytes de cabecera recibidos
+    size_t comp_size;        // Tamaño total del blob comprimido
+    int version;             // 0 mientras no se haya leído la cabecera
+    uint64_t orig_size;      // Tamaño original declarado
+    uint32_t cnt;            // Cantidad de códigos (formato original)
+    uint32_t codes_read;     // Códigos leídos (formato original)
+    uint64_t acc;            // Bits pendientes entre trozos
+    int nbits;
+    uint8_t *out;            // Buffer de salida
+    size_t out_pos;
+    lzw_sink sink;
+    void *user;
+    int failed;
+};
+
+// Entrega la salida acumulada al sink y desplaza la ventana
+static int dec_flush(LZWDecCtx *c) {
+    if (c->out_pos > 0 && !c->failed) {
+        if (!c->sink(c->user, c->out, c->out_pos)) c->failed = 1;
+    }
+    c->d.base += c->out_pos;
+    c->out_pos = 0;
+    return !c->failed;
+}
 
-    uint16_t prev_code = 0;
-    int have_prev = 0;
+LZWDecCtx* lzw_dec_init(size_t comp_size, lzw_sink sink, void* user) {
+    LZWDecCtx *c = calloc(1, sizeof(LZWDecCtx));
+    if (!c) return NULL;
+    c->out = malloc(LZW_STREAM_BUF);
+    if (!c->out) {
+        free(c);
+        return NULL;
+    }
+    c->comp_size = comp_size;
+    c->sink = sink;
+    c->user = user;
+    return c;
+}
 
-    // Reconstrucción
-    for (uint32_t i = 0; i < cnt; ++i) {
-        uint16_t code = codes[i];
-        unsigned char *entry = NULL;
-        size_t entry_len = 0;
+int lzw_dec_feed(LZWDecCtx* c, const uint8_t* input, size_t input_size) {
+    if (!c || c->failed) return 0;
 
-        if (code < dict_size && seq[code]) {
-            // Entrada conocida
-            entry = seq[code];
-            entry_len = seqlen[code];
-        }
-        else if (code == dict_size && have_prev) {
-            // Caso especial: entrada aún no registrada
-            size_t l = seqlen[prev_code];
-            entry = malloc(l + 1);
-            memcpy(entry, seq[prev_code], l);
-            entry[l] = seq[prev_code][0];
-            entry_len = l + 1;
+    // Completar la cabecera
+    while (input_size > 0 && c->header_len < LZW_HEADER_SIZE) {
+        c->header[c->header_len++] = *input++;
+        input_size--;
+    }
+    if (c->header_len < LZW_HEADER_SIZE) return 1;
+    if (c->version == 0) {
+        c->version = lzw_blob_format(c->header, c->comp_size);
+        uint32_t first_code = LZW_FIRST_CODE;
+        if (c->version == LZW_VERSION_FIXED) {
+            memcpy(&c->orig_size, c->header, sizeof(uint64_t));
+            memcpy(&c->cnt, c->header + sizeof(uint64_t), sizeof(uint32_t));
+            first_code = 256;
+        } else if (c->version == LZW_VERSION_VARIABLE) {
+            memcpy(&c->orig_size, c->header + 4, sizeof(uint64_t));
+        } else {
+            c->failed = 1;
+            return 0;
         }
-        else {
-            entry = NULL;
-            entry_len = 0;
+        if (!dec_init(&c->d, first_code)) {
+            c->failed = 1;
+            return 0;
         }
+    }
 
-        if (entry) {
-            // Guardar en salida
-            if (out_pos + entry_len > orig_size)
-                out = realloc(out, out_pos + entry_len);
-
-            memcpy(out + out_pos, entry, entry_len);
-            out_pos += entry_len;
-
-            // Añadir nueva entrada al diccionario
-            if (have_prev && dict_size < 65536) {
-                size_t l = seqlen[prev_code];
-                seq[dict_size] = malloc(l + 1);
-                memcpy(seq[dict_size], seq[prev_code], l);
-                seq[dict_size][l] = entry[0];
-                seqlen[dict_size] = l + 1;
-                dict_size++;
-            }
+    // En el formato original los códigos son fijos de 16 bits (LSB primero)
+    int fixed = c->version == LZW_VERSION_FIXED;
+    BitReader br = { input, input + input_size, c->acc, c->nbits };
+    uint32_t code;
+    while (c->d.base + c->out_pos < c->orig_size) {
+        if (fixed && c->codes_read == c->cnt) break;
+        if (!br_get(&br, fixed ? 16 : dec_width(&c->d), &code)) break;
+        if (fixed) {
+            c->codes_read++;
+        } else if (code == LZW_CLEAR_CODE) {
+            dec_reset(&c->d);
+            continue;
         }
-        prev_code = code;
-        have_prev = 1;
+        uint32_t len = dec_phrase_len(&c->d, code);
+        if (len == 0 || c->d.base + c->out_pos + len > c->orig_size) {
+            c->failed = 1;
+            return 0;
+        }
+        if (c->out_pos + len > LZW_STREAM_BUF && !dec_flush(c)) return 0;
+        c->out_pos += dec_code(&c->d, code, c->out, c->out_pos);
     }
+    c->acc = br.acc;
+    c->nbits = br.nbits;
+    return 1;
+}
 
-    // Liberar memoria del diccionario
-    for (int i = 0; i < dict_size; ++i)
-        if (seq[i]) free(seq[i]);
-    free(seq);
-    free(seqlen);
+int lzw_dec_finish(LZWDecCtx* c, uint64_t* out_size_bytes) {
+    if (!c) return 0;
+    dec_flush(c);
+    uint64_t total = c->d.base;
+    int ok = !c->failed && c->version != 0 && total == c->orig_size;
+    if (out_size_bytes) *out_size_bytes = total;
+    if (c->version != 0) dec_free(&c->d);
+    free(c->out);
+    free(c);
+    return ok;
+}
 
-    *out_size_bytes = out_pos;
-    return out;
+// ------------------------------------------------------
+// Lee el tamaño original de la cabecera de un blob.
+// Devuelve 0 si la cabecera no es válida.
+// ------------------------------------------------------
+int lzw_orig_size(const uint8_t* header, size_t comp_size, uint64_t* orig_size) {
+    int version = lzw_blob_format(header, comp_size);
+    if (version == LZW_VERSION_FIXED) {
+        memcpy(orig_size, header, sizeof(uint64_t));
+    } else if (version == LZW_VERSION_VARIABLE || version == LZW_VERSION_BLOCKS) {
+        memcpy(orig_size, header + 4, sizeof(uint64_t));
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+// ------------------------------------------------------
+// Cabecera de un contenedor de bloques:
+// ["FSZ"][3][u64 tamaño original][u32 tamaño de bloque][u32 bloques]
+// ------------------------------------------------------
+void lzw_block_header_write(uint8_t* out, uint64_t orig_size, uint32_t block_size, uint32_t nblocks) {
+    memcpy(out, LZW_MAGIC, 3);
+    out[3] = LZW_VERSION_BLOCKS;
+    memcpy(out + 4, &orig_size, sizeof(uint64_t));
+    memcpy(out + 12, &block_size, sizeof(uint32_t));
+    memcpy(out + 16, &nblocks, sizeof(uint32_t));
 }
 
+int lzw_block_header(const uint8_t* header, size_t comp_size, LZWBlockHeader* h) {
+    if (comp_size < LZW_BLOCKS_HEADER_SIZE ||
+        lzw_blob_format(header, comp_size) != LZW_VERSION_BLOCKS) return 0;
+    memcpy(&h->orig_size, header + 4, sizeof(uint64_t));
+    memcpy(&h->block_size, header + 12, sizeof(uint32_t));
+    memcpy(&h->nblocks, header + 16, sizeof(uint32_t));
+    if (h->block_size == 0) return 0;
+    // Debe caber la tabla de tamaños al final
+    return (uint64_t)comp_size >= LZW_BLOCKS_HEADER_SIZE + (uint64_t)h->nblocks * sizeof(uint32_t);
+}
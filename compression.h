@@ -4,7 +4,77 @@
 #include <stddef.h>
 #include <stdint.h>
 
+// -------------------------------------------------------
+// Formatos de blob LZW:
+//  - Original (fijo): [u64 tamaño original][u32 cantidad][u16 códigos...]
+//  - Variable: ["FSZ"][u8 versión][u64 tamaño original][bits...]
+//    Códigos de 9 a 16 bits empaquetados LSB primero. El código
+//    CLEAR reinicia el diccionario cuando la tasa empeora.
+//  - Bloques: ["FSZ"][3][u64 tamaño original][u32 tamaño de bloque]
+//    [u32 bloques][blob variable por bloque...][u32 tamaño de cada bloque...]
+//    Cada bloque tiene su propio diccionario, así que pueden
+//    comprimirse y descomprimirse en paralelo o por separado.
+// lzw_compress genera siempre el formato variable; lzw_decompress
+// lee los tres.
+// -------------------------------------------------------
+#define LZW_MAGIC "FSZ"
+#define LZW_VERSION_FIXED 1
+#define LZW_VERSION_VARIABLE 2
+#define LZW_VERSION_BLOCKS 3
+#define LZW_HEADER_SIZE 12       // Cabecera común a todos los formatos
+#define LZW_BLOCKS_HEADER_SIZE 20 // Cabecera de un contenedor de bloques
+#define LZW_MIN_BITS 9
+#define LZW_MAX_BITS 16
+#define LZW_MAX_CODES 65536
+#define LZW_CLEAR_CODE 256       // Reinicia el diccionario
+#define LZW_FIRST_CODE 257       // Primer código libre tras los 256 bytes y CLEAR
+#define LZW_CHECK_GAP 10000      // Bytes entre controles de la tasa con diccionario lleno
+
+#define LZW_STREAM_BUF (256 * 1024) // Buffer de salida de los contextos incrementales
+
 uint8_t* lzw_compress(const uint8_t* input, size_t input_size, size_t* out_size_bytes);
 uint8_t* lzw_decompress(const uint8_t* input, size_t input_size, size_t* out_size_bytes);
 
+// Descomprime en un buffer ya reservado de cap bytes
+int lzw_decompress_into(const uint8_t* input, size_t input_size, uint8_t* out, size_t cap, size_t* out_len);
+
+// Formato (LZW_VERSION_*) de un blob a partir de su cabecera, o -1
+int lzw_blob_format(const uint8_t* header, size_t comp_size);
+
+// Lee el tamaño original de la cabecera (LZW_HEADER_SIZE bytes) de un blob
+int lzw_orig_size(const uint8_t* header, size_t comp_size, uint64_t* orig_size);
+
+// Cabecera de un contenedor de bloques (LZW_BLOCKS_HEADER_SIZE bytes)
+typedef struct {
+    uint64_t orig_size;   // Tamaño original total
+    uint32_t block_size;  // Tamaño original de cada bloque (el último puede ser menor)
+    uint32_t nblocks;     // Cantidad de bloques
+} LZWBlockHeader;
+
+void lzw_block_header_write(uint8_t* out, uint64_t orig_size, uint32_t block_size, uint32_t nblocks);
+int lzw_block_header(const uint8_t* header, size_t comp_size, LZWBlockHeader* h);
+
+// -------------------------------------------------------
+// API incremental (init / feed / finish). Los datos producidos
+// se entregan al sink en trozos de hasta LZW_STREAM_BUF bytes,
+// así que la memoria usada no depende del tamaño del archivo.
+// El sink devuelve 0 para abortar. finish siempre libera el
+// contexto y devuelve 0 si hubo algún error. Los contenedores de
+// bloques no se aceptan aquí: se leen bloque a bloque.
+// -------------------------------------------------------
+typedef int (*lzw_sink)(void* user, const uint8_t* data, size_t len);
+
+typedef struct LZWEncCtx LZWEncCtx;
+typedef struct LZWDecCtx LZWDecCtx;
+
+// orig_size debe coincidir con el total de bytes entregados a feed
+LZWEncCtx* lzw_enc_init(uint64_t orig_size, lzw_sink sink, void* user);
+int lzw_enc_feed(LZWEncCtx* ctx, const uint8_t* input, size_t input_size);
+int lzw_enc_finish(LZWEncCtx* ctx, size_t* out_size_bytes);
+
+// comp_size es el tamaño total del blob que se va a entregar
+LZWDecCtx* lzw_dec_init(size_t comp_size, lzw_sink sink, void* user);
+int lzw_dec_feed(LZWDecCtx* ctx, const uint8_t* input, size_t input_size);
+int lzw_dec_finish(LZWDecCtx* ctx, uint64_t* out_size_bytes);
+
 #endif // COMPRESSION_H
@@ -0,0 +1,171 @@
+#include "dedup.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define DEDUP_MIN_BUCKETS 1024
+
+// --------------------------------------------------------
+// MurmurHash3 x64_128 (semilla 0) por partes: los bloques de 16
+// bytes se procesan según llegan y el resto se guarda para la
+// siguiente llamada
+// --------------------------------------------------------
+#define C1 0x87c37b91114253d5ull
+#define C2 0x4cf5ad432745937full
+
+static uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+static uint64_t fmix64(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ull;
+    k ^= k >> 33;
+    return k;
+}
+
+static void hash_block(DedupHasher* s, const uint8_t* p) {
+    uint64_t k1, k2;
+    memcpy(&k1, p, 8);
+    memcpy(&k2, p + 8, 8);
+    k1 *= C1; k1 = rotl64(k1, 31); k1 *= C2; s->h1 ^= k1;
+    s->h1 = rotl64(s->h1, 27); s->h1 += s->h2; s->h1 = s->h1 * 5 + 0x52dce729;
+    k2 *= C2; k2 = rotl64(k2, 33); k2 *= C1; s->h2 ^= k2;
+    s->h2 = rotl64(s->h2, 31); s->h2 += s->h1; s->h2 = s->h2 * 5 + 0x38495ab5;
+}
+
+void dedup_hash_init(DedupHasher* s) {
+    memset(s, 0, sizeof(*s));
+}
+
+void dedup_hash_update(DedupHasher* s, const void* data, size_t len) {
+    const uint8_t *p = data;
+    s->total += len;
+    if (s->tail_len > 0) {
+        size_t n = 16 - s->tail_len < len ? 16 - s->tail_len : len;
+        memcpy(s->tail + s->tail_len, p, n);
+        s->tail_len += n;
+        p += n;
+        len -= n;
+        if (s->tail_len < 16) return;
+        hash_block(s, s->tail);
+        s->tail_len = 0;
+    }
+    for (; len >= 16; p += 16, len -= 16) hash_block(s, p);
+    memcpy(s->tail, p, len);
+    s->tail_len = len;
+}
+
+void dedup_hash_final(DedupHasher* s, uint64_t out[2]) {
+    uint64_t k1 = 0, k2 = 0;
+    const uint8_t *t = s->tail;
+    for (size_t i = s->tail_len; i > 8; --i) k2 ^= (uint64_t)t[i - 1] << (8 * (i - 9));
+    if (s->tail_len > 8) {
+        k2 *= C2; k2 = rotl64(k2, 33); k2 *= C1; s->h2 ^= k2;
+    }
+    for (size_t i = s->tail_len < 8 ? s->tail_len : 8; i > 0; --i) k1 ^= (uint64_t)t[i - 1] << (8 * (i - 1));
+    if (s->tail_len > 0) {
+        k1 *= C1; k1 = rotl64(k1, 31); k1 *= C2; s->h1 ^= k1;
+    }
+    uint64_t h1 = s->h1 ^ s->total, h2 = s->h2 ^ s->total;
+    h1 += h2;
+    h2 += h1;
+    h1 = fmix64(h1);
+    h2 = fmix64(h2);
+    h1 += h2;
+    h2 += h1;
+    out[0] = h1;
+    out[1] = h2;
+    if (!dedup_hash_known(out)) out[0] = 1;  // 0 significa "desconocido"
+}
+
+void dedup_hash(const void* data, size_t len, uint64_t out[2]) {
+    DedupHasher s;
+    dedup_hash_init(&s);
+    dedup_hash_update(&s, data, len);
+    dedup_hash_final(&s, out);
+}
+
+// --------------------------------------------------------
+// Tabla hash → blob
+// --------------------------------------------------------
+static size_t bucket_of(const DedupTable* t, const uint64_t hash[2]) {
+    return (size_t)(hash[0] & (t->nbuckets - 1));
+}
+
+void dedup_init(DedupTable* t) {
+    memset(t, 0, sizeof(*t));
+}
+
+void dedup_clear(DedupTable* t) {
+    for (size_t i = 0; i < t->nbuckets; ++i) {
+        DedupEntry *e = t->buckets[i];
+        while (e) {
+            DedupEntry *next = e->next;
+            free(e);
+            e = next;
+        }
+        t->buckets[i] = NULL;
+    }
+    t->count = 0;
+}
+
+void dedup_free(DedupTable* t) {
+    dedup_clear(t);
+    free(t->buckets);
+    t->buckets = NULL;
+    t->nbuckets = 0;
+}
+
+DedupEntry* dedup_find(const DedupTable* t, const uint64_t hash[2]) {
+    if (!t->buckets || !dedup_hash_known(hash)) return NULL;
+    for (DedupEntry *e = t->buckets[bucket_of(t, hash)]; e; e = e->next)
+        if (e->hash[0] == hash[0] && e->hash[1] == hash[1]) return e;
+    return NULL;
+}
+
+// Duplica la tabla cuando hay más entradas que cubos
+static void dedup_grow(DedupTable* t) {
+    size_t n = t->nbuckets ? t->nbuckets * 2 : DEDUP_MIN_BUCKETS;
+    DedupEntry **b = calloc(n, sizeof(DedupEntry*));
+    if (!b) return;
+    for (size_t i = 0; i < t->nbuckets; ++i) {
+        DedupEntry *e = t->buckets[i];
+        while (e) {
+            DedupEntry *next = e->next;
+            e->next = b[e->hash[0] & (n - 1)];
+            b[e->hash[0] & (n - 1)] = e;
+            e = next;
+        }
+    }
+    free(t->buckets);
+    t->buckets = b;
+    t->nbuckets = n;
+}
+
+DedupEntry* dedup_add(DedupTable* t, const uint64_t hash[2], long position,
+                      uint64_t comp_size, uint64_t orig_size) {
+    if (!dedup_hash_known(hash)) return NULL;
+    if (t->count >= t->nbuckets) dedup_grow(t);
+    if (!t->buckets) return NULL;
+    DedupEntry *e = malloc(sizeof(DedupEntry));
+    if (!e) return NULL;
+    e->hash[0] = hash[0];
+    e->hash[1] = hash[1];
+    e->position = position;
+    e->comp_size = comp_size;
+    e->orig_size = orig_size;
+    e->refs = 0;
+    size_t b = bucket_of(t, hash);
+    e->next = t->buckets[b];
+    t->buckets[b] = e;
+    t->count++;
+    return e;
+}
+
+void dedup_remove(DedupTable* t, DedupEntry* e) {
+    DedupEntry **link = &t->buckets[bucket_of(t, e->hash)];
+    while (*link != e) link = &(*link)->next;
+    *link = e->next;
+    t->count--;
+    free(e);
+}
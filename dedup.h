@@ -0,0 +1,61 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// -------------------------------------------------------
+// Deduplicación por contenido. Cada blob se identifica por un hash
+// de 128 bits (MurmurHash3 x64_128, no criptográfico) del contenido
+// original. La tabla lleva, por hash, el blob que lo guarda y
+// cuántas entradas del índice lo usan; un archivo idéntico a uno ya
+// guardado solo añade una referencia. El hash 0 queda reservado
+// para "desconocido" (blobs de versiones anteriores).
+// -------------------------------------------------------
+typedef struct {
+    uint64_t h1, h2;
+    uint64_t total;          // Bytes procesados
+    uint8_t tail[16];        // Bytes que aún no completan un bloque
+    size_t tail_len;
+} DedupHasher;
+
+void dedup_hash_init(DedupHasher* s);
+void dedup_hash_update(DedupHasher* s, const void* data, size_t len);
+void dedup_hash_final(DedupHasher* s, uint64_t out[2]);
+void dedup_hash(const void* data, size_t len, uint64_t out[2]);
+
+static inline bool dedup_hash_known(const uint64_t hash[2]) {
+    return (hash[0] | hash[1]) != 0;
+}
+
+typedef struct DedupEntry {
+    uint64_t hash[2];
+    long position;           // Blob en storage
+    uint64_t comp_size;
+    uint64_t orig_size;
+    uint32_t refs;           // Entradas del índice que lo usan
+    struct DedupEntry *next; // Siguiente en el mismo cubo
+} DedupEntry;
+
+typedef struct {
+    DedupEntry **buckets;    // Tabla hash encadenada
+    size_t nbuckets;         // Potencia de dos
+    size_t count;
+
+    uint64_t hits;           // Archivos guardados como referencia
+    uint64_t saved;          // Bytes comprimidos que no se escribieron
+} DedupTable;
+
+void dedup_init(DedupTable* t);
+void dedup_free(DedupTable* t);
+void dedup_clear(DedupTable* t);
+
+DedupEntry* dedup_find(const DedupTable* t, const uint64_t hash[2]);
+
+// Registra un blob nuevo sin referencias (NULL si falta memoria)
+DedupEntry* dedup_add(DedupTable* t, const uint64_t hash[2], long position,
+                      uint64_t comp_size, uint64_t orig_size);
+
+void dedup_remove(DedupTable* t, DedupEntry* e);
+
+#endif // DEDUP_H
@@ -0,0 +1,98 @@
+#include "epoch.h"
+#include <sched.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Ranura por la que empieza a buscar cada hilo: así cada lector
+// suele quedarse con la suya y no comparte línea de caché
+static __thread unsigned slot_hint = EPOCH_SLOTS;
+static unsigned next_hint;
+
+void epoch_init(Epoch* ep) {
+    memset(ep, 0, sizeof(*ep));
+    ep->global = 1;
+}
+
+void epoch_destroy(Epoch* ep) {
+    for (size_t i = 0; i < ep->n; ++i) ep->items[i].release(ep->items[i].ptr);
+    free(ep->items);
+    ep->items = NULL;
+    ep->n = ep->cap = 0;
+}
+
+int epoch_enter(Epoch* ep) {
+    if (slot_hint == EPOCH_SLOTS)
+        slot_hint = __atomic_fetch_add(&next_hint, 1, __ATOMIC_RELAXED) % EPOCH_SLOTS;
+    uint64_t e = __atomic_load_n(&ep->global, __ATOMIC_SEQ_CST);
+    while (1) {
+        for (unsigned i = 0; i < EPOCH_SLOTS; ++i) {
+            unsigned s = (slot_hint + i) % EPOCH_SLOTS;
+            uint64_t free_slot = 0;
+            if (__atomic_compare_exchange_n(&ep->slots[s].epoch, &free_slot, e, false,
+                                            __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+                slot_hint = s;
+                // El anuncio es visible antes de cualquier lectura posterior
+                __atomic_thread_fence(__ATOMIC_SEQ_CST);
+                return (int)s;
+            }
+        }
+        sched_yield();  // Todas ocupadas
+    }
+}
+
+void epoch_exit(Epoch* ep, int slot) {
+    __atomic_store_n(&ep->slots[slot].epoch, 0, __ATOMIC_RELEASE);
+}
+
+void epoch_retire(Epoch* ep, void* ptr, void (*release)(void*)) {
+    if (ep->n == ep->cap) {
+        size_t cap = ep->cap ? ep->cap * 2 : 256;
+        EpochItem *grown = realloc(ep->items, sizeof(EpochItem) * cap);
+        if (!grown) {
+            // Sin memoria para apuntarlo: esperar a los lectores y liberar ya
+            epoch_synchronize(ep);
+            release(ptr);
+            return;
+        }
+        ep->items = grown;
+        ep->cap = cap;
+    }
+    EpochItem *it = &ep->items[ep->n++];
+    it->ptr = ptr;
+    it->release = release;
+    it->epoch = __atomic_load_n(&ep->global, __ATOMIC_RELAXED);
+}
+
+// Época más antigua anunciada (o la actual si no hay lectores)
+static uint64_t oldest_reader(Epoch* ep, uint64_t now) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    uint64_t min = now;
+    for (int i = 0; i < EPOCH_SLOTS; ++i) {
+        uint64_t e = __atomic_load_n(&ep->slots[i].epoch, __ATOMIC_ACQUIRE);
+        if (e && e < min) min = e;
+    }
+    return min;
+}
+
+// Libera lo retirado antes de la época min
+static void release_before(Epoch* ep, uint64_t min) {
+    size_t kept = 0;
+    for (size_t i = 0; i < ep->n; ++i) {
+        if (ep->items[i].epoch < min) ep->items[i].release(ep->items[i].ptr);
+        else ep->items[kept++] = ep->items[i];
+    }
+    ep->n = kept;
+}
+
+void epoch_reclaim(Epoch* ep) {
+    if (ep->n == 0) return;
+    uint64_t now = __atomic_add_fetch(&ep->global, 1, __ATOMIC_SEQ_CST);
+    release_before(ep, oldest_reader(ep, now));
+}
+
+void epoch_synchronize(Epoch* ep) {
+    uint64_t now = __atomic_add_fetch(&ep->global, 1, __ATOMIC_SEQ_CST);
+    while (oldest_reader(ep, now) < now) sched_yield();
+    release_before(ep, now);
+}
@@ -0,0 +1,54 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+#include <stddef.h>
+#include <stdint.h>
+
+// -------------------------------------------------------
+// Reclamación por épocas para lectores sin cerrojos. Un lector
+// anuncia en una ranura la época global al entrar y la borra al
+// salir; mientras tanto puede seguir punteros que un escritor ya ha
+// desenganchado. El escritor no libera lo que desengancha: lo retira
+// con la época en que lo hizo, y epoch_reclaim solo libera lo
+// retirado antes de la época más antigua que sigue anunciada.
+//
+// Los lectores nunca esperan (salvo que haya más de EPOCH_SLOTS a la
+// vez). epoch_retire, epoch_reclaim y epoch_synchronize son del
+// escritor: quien las llame debe serializarlas.
+// -------------------------------------------------------
+#define EPOCH_SLOTS 128
+
+typedef struct {
+    uint64_t epoch;                          // 0 = libre
+    char pad[64 - sizeof(uint64_t)];         // Una línea de caché por lector
+} EpochSlot;
+
+typedef struct {
+    void *ptr;
+    void (*release)(void*);
+    uint64_t epoch;                          // Época en que se retiró
+} EpochItem;
+
+typedef struct {
+    uint64_t global;
+    EpochSlot slots[EPOCH_SLOTS];
+    EpochItem *items;                        // Retirados pendientes
+    size_t n, cap;
+} Epoch;
+
+void epoch_init(Epoch* ep);
+// Libera todo lo pendiente (no puede quedar ningún lector)
+void epoch_destroy(Epoch* ep);
+
+// Entra y sale de una sección de lectura; enter devuelve la ranura
+int epoch_enter(Epoch* ep);
+void epoch_exit(Epoch* ep, int slot);
+
+// Retira ptr: release(ptr) se llamará cuando ningún lector lo vea
+void epoch_retire(Epoch* ep, void* ptr, void (*release)(void*));
+// Libera lo retirado que ya no puede ver ningún lector
+void epoch_reclaim(Epoch* ep);
+// Espera a que salgan los lectores que ya estaban dentro y libera
+// todo lo retirado
+void epoch_synchronize(Epoch* ep);
+
+#endif // EPOCH_H
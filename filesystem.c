@@ -1,236 +1,2404 @@
 #include "filesystem.h"
 #include "compression.h"
+#include "codec.h"
+#include "metrics.h"
+#include "threadpool.h"
+#include "pagedindex.h"
+#include "uring.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
-// Estructura de metadatos para cada archivo
+// Tamaño de los trozos con los que se leen y escriben los archivos
+#define FS_CHUNK (64 * 1024)
+
+// Los archivos mayores que un bloque se guardan como contenedor de
+// bloques independientes, comprimidos y descomprimidos en paralelo
+#define FS_BLOCK_SIZE (1024 * 1024)
+
+// Bloques por hilo que se procesan en cada tanda
+#define FS_BLOCKS_PER_THREAD 2
+
+// Valor que marca en el índice en memoria un archivo borrado que
+// sigue en el índice en disco
+#define FS_DELETED (-2L)
+
+// Con más cambios que esto (o que la cuarta parte del índice en
+// disco) save reescribe el .idx entero en vez de actualizarlo
+#define FS_IDX_REWRITE_MIN 4096
+
+// Nodos retirados del B-tree que se acumulan antes de intentar
+// liberarlos al soltar el cerrojo del escritor
+#define FS_RECLAIM_BATCH 1024
+
+// Estructura de metadatos para cada archivo (formato .meta)
 typedef struct {
     char name[256];      // Nombre del archivo
     long position;       // Posición dentro de storage.bin
     size_t comp_size;    // Tamaño del archivo comprimido
 } MetaEntry;
 
+static void compact_reset(FileSystem* fs);
+static bool segment_retired(const FileSystem* fs, uint32_t seg);
+static void blob_scan(FileSystem* fs);
+static void journal_recover(FileSystem* fs);
+static BTree* index_create(FileSystem* fs);
+static bool sync_pending(FileSystem* fs);
+static bool compact_pending(const FileSystem* fs);
+
+// Reloj de pared en segundos
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Cerrojo del escritor; es recursivo, así que una operación puede
+// llamar a otra pública
+static void fs_lock(FileSystem* fs) {
+    pthread_mutex_lock(&fs->lock);
+}
+
+// Al soltarlo se liberan los nodos retirados que ya no ve nadie
+static void fs_unlock(FileSystem* fs) {
+    if (fs->epoch.n >= FS_RECLAIM_BATCH) epoch_reclaim(&fs->epoch);
+    pthread_mutex_unlock(&fs->lock);
+}
+
+// La caché se toca siempre con su cerrojo; al invalidar sube
+// cache_gen para que no entre una lectura empezada antes
+static void fs_cache_invalidate(FileSystem* fs, const char* name) {
+    pthread_mutex_lock(&fs->cache_lock);
+    if (name) cache_invalidate(&fs->cache, name);
+    else cache_clear(&fs->cache);
+    fs->cache_gen++;
+    pthread_mutex_unlock(&fs->cache_lock);
+}
+
 // --------------------------------------------------------
 // Inicializa el sistema de archivos
 // --------------------------------------------------------
 void fs_init(FileSystem* fs, const char* storage_name) {
-    fs->index = btree_create(); // Crea un B-tree vacío
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&fs->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    pthread_mutex_init(&fs->cache_lock, NULL);
+    fs->cache_gen = 0;
+    epoch_init(&fs->epoch);
+    fs->index = index_create(fs);      // Crea un B-tree vacío
+    fs->disk = NULL;                   // Sin índice en disco
+    fs->views[0].index = fs->index;
+    fs->views[0].disk = NULL;
+    fs->view = &fs->views[0];
+    fs->blobs_valid = false;           // Se calculan al hacer falta
+    dedup_init(&fs->dedup);
+    memset(&fs->compact, 0, sizeof(fs->compact));
+    fs->compact.moved_from = fs->compact.moved_to = -1;
+    fs->codec = CODEC_AUTO;            // Códec elegido por archivo
+    fs->ingest_uring = FS_URING;       // Ingesta con io_uring si lo hay
+    fs->pool = NULL;            // El pool de hilos se crea al necesitarlo
+    cache_init(&fs->cache, CACHE_DEFAULT_BUDGET);
     strncpy(fs->storage_file, storage_name, sizeof(fs->storage_file)-1);
     fs->storage_file[sizeof(fs->storage_file)-1] = '\0';
 
-    // Asegura que el archivo de almacenamiento exista
-    FILE *f = fopen(fs->storage_file, "ab");
-    if (f) fclose(f);
+    // Abre (o crea) el archivo de almacenamiento para toda la sesión
+    if (!storage_open(&fs->storage, fs->storage_file))
+        printf("Error: no se pudo abrir almacenamiento\n");
 
     printf("Inicializado: %s\n", fs->storage_file);
+
+    // Índice de la sesión anterior: último checkpoint más el diario
+    char journal_file[600];
+    snprintf(journal_file, sizeof(journal_file), "%s.jnl", fs->storage_file);
+    fs->last_checkpoint = now_sec();
+    if (journal_open(&fs->journal, journal_file)) journal_recover(fs);
+    else printf("Error: no se pudo abrir el diario %s\n", journal_file);
+}
+
+// --------------------------------------------------------
+// Cierra el sistema de archivos volcando lo pendiente
+// --------------------------------------------------------
+void fs_close(FileSystem* fs) {
+    if (fs->journal.buf_len > 0) sync_pending(fs);
+    journal_close(&fs->journal);
+    compact_reset(fs);
+    free(fs->compact.retired);
+    dedup_free(&fs->dedup);
+    btree_destroy(fs->index);
+    fs->index = NULL;
+    if (fs->disk) {
+        pidx_close(fs->disk);
+        free(fs->disk);
+    }
+    fs->disk = NULL;
+    epoch_destroy(&fs->epoch);  // Nodos retirados que quedaban
+    storage_close(&fs->storage);
+    cache_free(&fs->cache);
+    tp_destroy(fs->pool);
+    fs->pool = NULL;
+    pthread_mutex_destroy(&fs->cache_lock);
+    pthread_mutex_destroy(&fs->lock);
+}
+
+// --------------------------------------------------------
+// Fuerza el volcado de lo pendiente en storage.bin
+// --------------------------------------------------------
+static bool sync_pending(FileSystem* fs) {
+    if (!storage_commit(&fs->storage)) {
+        printf("Error: no se pudo volcar almacenamiento\n");
+        return false;
+    }
+    if (fs->journal.buf_len > 0 && !journal_commit(&fs->journal, fs->storage.sync)) {
+        printf("Error: no se pudo escribir el diario\n");
+        return false;
+    }
+    return true;
+}
+
+bool fs_sync(FileSystem* fs) {
+    fs_lock(fs);
+    bool ok = sync_pending(fs);
+    fs_unlock(fs);
+    return ok;
+}
+
+// --------------------------------------------------------
+// Elige entre leer con mmap (por defecto) o con pread
+// --------------------------------------------------------
+void fs_set_read_mode(FileSystem* fs, bool use_mmap) {
+    __atomic_store_n(&fs->storage.use_mmap, use_mmap, __ATOMIC_RELAXED);
+    printf("Modo de lectura: %s\n", use_mmap ? "mmap" : "pread");
+}
+
+// --------------------------------------------------------
+// Elige cómo lee fs_create_many los archivos: io_uring (por
+// defecto si el sistema lo tiene) o hilos con fread
+// --------------------------------------------------------
+bool fs_set_ingest(FileSystem* fs, bool use_uring) {
+    if (use_uring) {
+        Uring *u = uring_create(2);
+        if (!u) {
+            printf("Error: io_uring no disponible\n");
+            return false;
+        }
+        uring_destroy(u);
+    }
+    fs_lock(fs);
+    fs->ingest_uring = use_uring;
+    fs_unlock(fs);
+    printf("Ingesta: %s\n", use_uring ? "io_uring" : "hilos");
+    return true;
+}
+
+// --------------------------------------------------------
+// Cambia el presupuesto de la caché (0 la desactiva)
+// --------------------------------------------------------
+void fs_set_cache(FileSystem* fs, size_t budget) {
+    pthread_mutex_lock(&fs->cache_lock);
+    cache_set_budget(&fs->cache, budget);
+    pthread_mutex_unlock(&fs->cache_lock);
+    printf("Cache: %zu bytes\n", budget);
+}
+
+// --------------------------------------------------------
+// Muestra los contadores de la caché
+// --------------------------------------------------------
+void fs_cache_stats(FileSystem* fs) {
+    pthread_mutex_lock(&fs->cache_lock);
+    ContentCache c = fs->cache;
+    pthread_mutex_unlock(&fs->cache_lock);
+    uint64_t total = c.hits + c.misses;
+    printf("Cache: %zu archivos, %zu de %zu bytes\n", c.count, c.used, c.budget);
+    printf("Aciertos %llu, fallos %llu (%.1f%%), expulsiones %llu\n",
+           (unsigned long long)c.hits, (unsigned long long)c.misses,
+           total ? 100.0 * (double)c.hits / (double)total : 0.0,
+           (unsigned long long)c.evictions);
+}
+
+// --------------------------------------------------------
+// Fija el códec de los archivos nuevos ("auto" lo elige por archivo)
+// --------------------------------------------------------
+static bool set_codec(FileSystem* fs, const char* name) {
+    const Codec *c = codec_find(name);
+    if (strcmp(name, "auto") != 0 && (!c || !c->enc_init)) {
+        printf("Error: codec desconocido %s\n", name);
+        return false;
+    }
+    fs->codec = c ? c->id : CODEC_AUTO;
+    printf("Codec: %s\n", name);
+    return true;
+}
+
+bool fs_set_codec(FileSystem* fs, const char* name) {
+    fs_lock(fs);
+    bool ok = set_codec(fs, name);
+    fs_unlock(fs);
+    return ok;
+}
+
+// --------------------------------------------------------
+// Métricas: latencias por operación, bytes, sucesos de LZW y forma
+// del índice. Con json se escriben como un objeto JSON en una línea.
+// --------------------------------------------------------
+#if FS_METRICS
+static void stats_json(FileSystem* fs, FILE* out, int height, size_t nodes) {
+    fprintf(out, "{\"ops\":{");
+    for (int op = 0; op < METRIC_NOPS; ++op) {
+        const MetricHist *h = &metrics.ops[op];
+        fprintf(out, "%s\"%s\":{\"count\":%llu,\"errors\":%llu,\"total_ns\":%llu,\"max_ns\":%llu,"
+                "\"p50_ns\":%llu,\"p99_ns\":%llu,\"buckets\":[", op ? "," : "",
+                metrics_op_name((MetricOp)op), (unsigned long long)h->count,
+                (unsigned long long)h->errors, (unsigned long long)h->total_ns,
+                (unsigned long long)h->max_ns, (unsigned long long)metrics_percentile(h, 0.50),
+                (unsigned long long)metrics_percentile(h, 0.99));
+        for (int b = 0; b < METRIC_BUCKETS; ++b)
+            fprintf(out, "%s%llu", b ? "," : "", (unsigned long long)h->buckets[b]);
+        fprintf(out, "]}");
+    }
+    fprintf(out, "},\"bytes\":{\"in\":%llu,\"out\":%llu,\"read\":%llu},"
+            "\"lzw\":{\"dict_full\":%llu,\"dict_reset\":%llu},"
+            "\"btree\":{\"keys\":%zu,\"height\":%d,\"nodes\":%zu},",
+            (unsigned long long)metrics.bytes_in, (unsigned long long)metrics.bytes_out,
+            (unsigned long long)metrics.bytes_read, (unsigned long long)metrics.lzw_dict_full,
+            (unsigned long long)metrics.lzw_dict_reset, fs->index->count, height, nodes);
+    if (fs->disk)
+        fprintf(out, "\"disk_index\":{\"keys\":%llu,\"height\":%u,\"pages\":%u}}\n",
+                (unsigned long long)fs->disk->h.count, fs->disk->h.height, fs->disk->h.npages);
+    else
+        fprintf(out, "\"disk_index\":null}\n");
+}
+#endif
+
+static void show_stats(FileSystem* fs, FILE* json) {
+#if FS_METRICS
+    int height;
+    size_t nodes;
+    btree_shape(fs->index, &height, &nodes);
+    if (json) {
+        stats_json(fs, json, height, nodes);
+        return;
+    }
+
+    printf("%-8s %10s %8s %10s %10s %10s %10s\n", "Op", "n", "errores", "media us", "p50 us", "p99 us", "max us");
+    for (int op = 0; op < METRIC_NOPS; ++op) {
+        const MetricHist *h = &metrics.ops[op];
+        printf("%-8s %10llu %8llu %10.1f %10.1f %10.1f %10.1f\n", metrics_op_name((MetricOp)op),
+               (unsigned long long)h->count, (unsigned long long)h->errors,
+               h->count ? (double)h->total_ns / (double)h->count / 1e3 : 0.0,
+               (double)metrics_percentile(h, 0.50) / 1e3, (double)metrics_percentile(h, 0.99) / 1e3,
+               (double)h->max_ns / 1e3);
+    }
+    // Histogramas: solo los cubos con algo, por su límite superior
+    for (int op = 0; op < METRIC_NOPS; ++op) {
+        const MetricHist *h = &metrics.ops[op];
+        if (h->count == 0) continue;
+        printf("  %-7s", metrics_op_name((MetricOp)op));
+        for (int b = 0; b < METRIC_BUCKETS; ++b)
+            if (h->buckets[b])
+                printf(" <%lluus:%llu", (unsigned long long)(metrics_bucket_limit(b) / 1000),
+                       (unsigned long long)h->buckets[b]);
+        printf("\n");
+    }
+    printf("Bytes: entrada %llu, comprimidos %llu (%.3f), leidos de storage %llu\n",
+           (unsigned long long)metrics.bytes_in, (unsigned long long)metrics.bytes_out,
+           metrics.bytes_in ? (double)metrics.bytes_out / (double)metrics.bytes_in : 0.0,
+           (unsigned long long)metrics.bytes_read);
+    printf("LZW: diccionario lleno %llu veces, %llu reinicios\n",
+           (unsigned long long)metrics.lzw_dict_full, (unsigned long long)metrics.lzw_dict_reset);
+    printf("B-tree en memoria: %zu llaves, altura %d, %zu nodos\n", fs->index->count, height, nodes);
+    if (fs->disk)
+        printf("Indice en disco: %llu llaves, altura %u, %u paginas\n",
+               (unsigned long long)fs->disk->h.count, fs->disk->h.height, fs->disk->h.npages);
+#else
+    (void)fs;
+    if (json) fprintf(json, "null\n");  // Siempre una línea
+    printf("Metricas desactivadas (compilado con FS_METRICS=0)\n");
+#endif
+}
+
+void fs_stats(FileSystem* fs, FILE* json) {
+    fs_lock(fs);
+    show_stats(fs, json);
+    fs_unlock(fs);
+}
+
+void fs_stats_reset(FileSystem* fs) {
+    (void)fs;
+    metrics_reset();
+    printf("Metricas a cero\n");
+}
+
+// --------------------------------------------------------
+// Ajusta los umbrales del group commit
+// --------------------------------------------------------
+void fs_set_commit(FileSystem* fs, size_t bytes, unsigned ms, bool sync) {
+    fs_lock(fs);
+    storage_set_commit(&fs->storage, bytes, ms, sync);
+    printf("Group commit: %zu bytes, %u ms, fdatasync %s\n",
+           fs->storage.commit_bytes, fs->storage.commit_ms, sync ? "si" : "no");
+    fs_unlock(fs);
+}
+
+// --------------------------------------------------------
+// Índice: el .idx en disco (si hay uno abierto) más los cambios
+// posteriores, que se guardan en el B-tree en memoria. Un borrado
+// de algo que está en disco se anota como FS_DELETED.
+//
+// Los lectores usan la vista publicada (fs->view) dentro de una
+// sección de época; el escritor, que es quien la cambia, puede usar
+// fs->index y fs->disk directamente.
+// --------------------------------------------------------
+static bool view_get(const FsView* v, const char* name, BTreeValue* out) {
+    if (btree_get(v->index, name, out)) return out->position != FS_DELETED;
+    PidxValue dv;
+    if (v->disk && pidx_lookup(v->disk, name, &dv)) {
+        out->position = (long)dv.position;
+        out->comp_size = dv.comp_size;
+        out->orig_size = dv.orig_size;
+        out->hash[0] = dv.hash[0];
+        out->hash[1] = dv.hash[1];
+        return true;
+    }
+    return false;
+}
+
+static const FsView* view_current(FileSystem* fs) {
+    return __atomic_load_n(&fs->view, __ATOMIC_ACQUIRE);
+}
+
+static bool index_get(FileSystem* fs, const char* name, BTreeValue* out) {
+    FsView v = { fs->index, fs->disk };
+    return view_get(&v, name, out);
+}
+
+// Los nodos que el B-tree deja de usar se liberan cuando ya no los
+// puede estar recorriendo ningún lector
+static void retire_node(void* user, void* node) {
+    FileSystem *fs = user;
+    epoch_retire(&fs->epoch, node, free);
+}
+
+static BTree* index_create(FileSystem* fs) {
+    BTree *t = btree_create(BTREE_T);
+    if (t) btree_share(t, retire_node, fs);
+    return t;
+}
+
+// Publica fs->index y fs->disk como vista de los lectores; cuando
+// ya no queda ninguno en la anterior libera el B-tree y el .idx que
+// se sustituyeron
+static void view_switch(FileSystem* fs, BTree* old_index, PagedIndex* old_disk) {
+    FsView *next = fs->view == &fs->views[0] ? &fs->views[1] : &fs->views[0];
+    next->index = fs->index;
+    next->disk = fs->disk;
+    __atomic_store_n(&fs->view, next, __ATOMIC_RELEASE);
+    epoch_synchronize(&fs->epoch);
+    if (old_index && old_index != fs->index) btree_destroy(old_index);
+    if (old_disk && old_disk != fs->disk) {
+        pidx_close(old_disk);
+        free(old_disk);
+    }
+}
+
+// Bytes que ocupa un blob en storage (tamaño delante y datos)
+static int64_t blob_bytes(const BTreeValue* v) {
+    return (int64_t)(sizeof(size_t) + v->comp_size);
+}
+
+// --------------------------------------------------------
+// Referencias a blobs. Varias llaves pueden compartir un blob (el
+// de su hash en la tabla de dedup); los bytes vivos del segmento se
+// cuentan al llegar la primera referencia y se descuentan al irse
+// la última. Un blob sin hash, o con un hash cuya entrada es otra
+// copia, solo lo usa su llave.
+// --------------------------------------------------------
+static void blob_ref(FileSystem* fs, const BTreeValue* v) {
+    if (!fs->blobs_valid) return;
+    DedupEntry *e = NULL;
+    if (dedup_hash_known(v->hash)) {
+        e = dedup_find(&fs->dedup, v->hash);
+        if (!e) e = dedup_add(&fs->dedup, v->hash, v->position, v->comp_size, v->orig_size);
+        else if (e->position != v->position) e = NULL;
+    }
+    if (e && e->refs++ > 0) return; // Ya contado
+    storage_add_live(&fs->storage, (uint64_t)v->position, blob_bytes(v));
+}
+
+static void blob_unref(FileSystem* fs, const BTreeValue* v) {
+    if (!fs->blobs_valid) return;
+    DedupEntry *e = dedup_hash_known(v->hash) ? dedup_find(&fs->dedup, v->hash) : NULL;
+    if (e && e->position == v->position) {
+        if (e->refs > 1) {
+            e->refs--;
+            return;
+        }
+        dedup_remove(&fs->dedup, e);
+    }
+    storage_add_live(&fs->storage, (uint64_t)v->position, -blob_bytes(v));
+}
+
+// Blob ya guardado con el mismo contenido que se puede compartir:
+// no vale si su segmento se está compactando (la copia no vería la
+// llave nueva) o ya se copió
+static DedupEntry* dedup_lookup(FileSystem* fs, const uint64_t hash[2], uint64_t orig_size) {
+    DedupEntry *e = dedup_find(&fs->dedup, hash);
+    if (!e || e->orig_size != orig_size) return NULL;
+    uint32_t seg = STORAGE_SEG((uint64_t)e->position);
+    if (seg >= fs->storage.nsegs || fs->storage.segs[seg].fd < 0 || segment_retired(fs, seg))
+        return NULL;
+    const FsCompactor *c = &fs->compact;
+    for (size_t i = c->qdone; i < c->nqueue; ++i)
+        if (c->queue[i] == seg) return NULL;
+    return e;
+}
+
+// Hash del resto de src; lo deja de nuevo al principio
+static bool hash_stream(FILE* src, uint64_t hash[2]) {
+    uint8_t *buf = malloc(FS_CHUNK);
+    if (!buf) return false;
+    DedupHasher h;
+    dedup_hash_init(&h);
+    size_t n;
+    while ((n = fread(buf, 1, FS_CHUNK, src)) > 0) dedup_hash_update(&h, buf, n);
+    bool ok = !ferror(src);
+    free(buf);
+    dedup_hash_final(&h, hash);
+    return ok && fseek(src, 0, SEEK_SET) == 0;
+}
+
+static bool index_remove(FileSystem* fs, const char* name) {
+    static const BTreeValue deleted = { FS_DELETED, 0, 0, { 0, 0 } };
+    BTreeValue old;
+    if (!index_get(fs, name, &old)) return false;
+    blob_unref(fs, &old);
+    if (fs->disk) return btree_insert(fs->index, name, &deleted);
+    btree_delete(fs->index, name);
+    return true;
+}
+
+// Cambia el índice en disco por el de path, con los cambios en
+// memoria vacíos; si no se puede abrir todo sigue como estaba
+static bool index_attach(FileSystem* fs, const char* path) {
+    PagedIndex *px = malloc(sizeof(PagedIndex));
+    BTree *index = px ? index_create(fs) : NULL;
+    if (!index || !pidx_open(px, path)) {
+        if (index) btree_destroy(index);
+        free(px);
+        return false;
+    }
+    snprintf(fs->disk_path, sizeof(fs->disk_path), "%s", path);
+    BTree *old_index = fs->index;
+    PagedIndex *old = fs->disk;
+    fs->disk = px;
+    fs->index = index;
+    view_switch(fs, old_index, old);
+    return true;
+}
+
+static PidxValue disk_value(const BTreeValue* v) {
+    PidxValue d = { v->position, v->comp_size, v->orig_size, { v->hash[0], v->hash[1] } };
+    return d;
+}
+
+// Recorrido en orden del índice combinado desde la primera llave
+// >= from: el .idx y los cambios en memoria avanzan a la vez con sus
+// cursores; la versión en memoria sustituye a la del disco y las
+// eliminaciones no salen. Como el orden es el de strcmp, quien busca
+// un rango para (devolviendo falso) en la primera llave que lo pasa.
+// Todo el recorrido es una sección de época: ve una sola versión
+// del índice aunque el escritor siga cambiándolo.
+static void view_scan(const FsView* view, const char* from, fs_visit fn, void* user) {
+    PidxIter it;
+    PidxValue dv;
+    BTreeCursor cur;
+    const char *mkey = NULL;
+    const BTreeValue *mval = NULL;
+    pidx_iter_seek(&it, view->disk, from);
+    btree_cursor_seek(&cur, view->index, from);
+    bool has_disk = pidx_iter_next(&it, &dv);
+    bool has_mem = btree_cursor_next(&cur, &mkey, &mval);
+    while (has_disk || has_mem) {
+        int c = !has_mem ? -1 : !has_disk ? 1 : strcmp(it.key, mkey);
+        if (c < 0) {
+            if (!fn(user, it.key, &dv)) return;
+            has_disk = pidx_iter_next(&it, &dv);
+            continue;
+        }
+        if (c == 0) has_disk = pidx_iter_next(&it, &dv);
+        if (mval->position != FS_DELETED) {
+            PidxValue v = disk_value(mval);
+            if (!fn(user, mkey, &v)) return;
+        }
+        has_mem = btree_cursor_next(&cur, &mkey, &mval);
+    }
+}
+
+void fs_scan(FileSystem* fs, const char* from, fs_visit fn, void* user) {
+    int slot = epoch_enter(&fs->epoch);
+    view_scan(view_current(fs), from, fn, user);
+    epoch_exit(&fs->epoch, slot);
+}
+
+// Recorrido del escritor (no cambia el índice mientras dura)
+static void index_foreach(FileSystem* fs, fs_visit fn, void* user) {
+    FsView v = { fs->index, fs->disk };
+    view_scan(&v, NULL, fn, user);
+}
+
+// --------------------------------------------------------
+// Diario: cada cambio del índice se anota con su valor completo,
+// así que repetirlo sobre un índice que ya lo tiene no cambia nada.
+// Los registros se escriben con el group commit de storage y
+// siempre después de los blobs a los que apuntan.
+// --------------------------------------------------------
+static void journal_put(FileSystem* fs, const char* key, const BTreeValue* value) {
+    PidxValue v = disk_value(value);
+    if (fs->journal.fd >= 0 && !journal_append(&fs->journal, JOURNAL_PUT, key, &v))
+        printf("Error: no se pudo anotar %s en el diario\n", key);
+}
+
+static void journal_del(FileSystem* fs, const char* key) {
+    if (fs->journal.fd >= 0 && !journal_append(&fs->journal, JOURNAL_DEL, key, NULL))
+        printf("Error: no se pudo anotar %s en el diario\n", key);
+}
+
+// Vuelca los registros pendientes si venció algún umbral
+static void journal_tick(FileSystem* fs) {
+    if (journal_due(&fs->journal, fs->storage.commit_bytes, fs->storage.commit_ms)) sync_pending(fs);
+}
+
+// El blob debe estar completo en storage: un registro escrito sin
+// que llegaran sus datos (un corte sin fdatasync) se descarta
+static bool blob_present(FileSystem* fs, const PidxValue* v) {
+    uint32_t seg = STORAGE_SEG((uint64_t)v->position);
+    if (v->position < 0 || seg >= fs->storage.nsegs || fs->storage.segs[seg].fd < 0) return false;
+    return STORAGE_OFF((uint64_t)v->position) + sizeof(size_t) + v->comp_size <= fs->storage.segs[seg].size;
+}
+
+typedef struct {
+    FileSystem *fs;
+    uint64_t dropped;
+} ReplayCtx;
+
+static void replay_entry(void* user, JournalOp op, const char* key, const PidxValue* value) {
+    ReplayCtx *r = user;
+    if (op == JOURNAL_DEL) {
+        index_remove(r->fs, key);
+        return;
+    }
+    BTreeValue v = { (long)value->position, value->comp_size, value->orig_size,
+                     { value->hash[0], value->hash[1] } };
+    if (!blob_present(r->fs, value) || !btree_insert(r->fs->index, key, &v)) r->dropped++;
+}
+
+// Abre el índice base del diario y le aplica los registros
+static void journal_recover(FileSystem* fs) {
+    Journal *j = &fs->journal;
+    if (j->base[0] && !index_attach(fs, j->base))
+        printf("Error: no se pudo abrir el indice %s del diario\n", j->base);
+    ReplayCtx r = { fs, 0 };
+    uint64_t n = journal_replay(j, replay_entry, &r);
+    if (j->base[0] || n > 0)
+        printf("Recuperado indice %s + %llu cambios del diario\n",
+               j->base[0] ? j->base : "vacio", (unsigned long long)n);
+    if (r.dropped > 0)
+        printf("Aviso: %llu cambios apuntan a datos que no llegaron a storage\n",
+               (unsigned long long)r.dropped);
+}
+
+// --------------------------------------------------------
+// Sink de los contextos de códec: al final de storage.bin
+// --------------------------------------------------------
+static int storage_sink(void* user, const uint8_t* data, size_t len) {
+    return storage_append((Storage*)user, data, len);
+}
+
+// --------------------------------------------------------
+// Trabajo de compresión o descompresión de un bloque
+// --------------------------------------------------------
+typedef struct {
+    const uint8_t *in;   // Datos de entrada
+    size_t in_len;
+    uint8_t *out;        // Salida (reservada por el trabajo al comprimir)
+    size_t out_cap;      // Capacidad de out al descomprimir
+    size_t out_len;
+    int codec;           // Códec al comprimir (CODEC_AUTO = elegir)
+    int ok;
+} BlockJob;
+
+static void compress_job(void* arg) {
+    BlockJob *j = arg;
+    j->out = codec_compress(j->codec, j->in, j->in_len, &j->out_len);
+    j->ok = j->out != NULL;
+}
+
+static void decompress_job(void* arg) {
+    BlockJob *j = arg;
+    j->ok = codec_decompress_into(j->in, j->in_len, j->out, j->out_cap, &j->out_len);
+}
+
+// Hilos de trabajo disponibles (el pool se crea la primera vez; si
+// dos lectores lo crean a la vez, el que llega tarde destruye el suyo)
+static int fs_threads(FileSystem* fs) {
+    ThreadPool *pool = __atomic_load_n(&fs->pool, __ATOMIC_ACQUIRE);
+    if (!pool && tp_cpu_count() > 1) {
+        ThreadPool *fresh = tp_create(tp_cpu_count());
+        if (fresh && !__atomic_compare_exchange_n(&fs->pool, &pool, fresh, false,
+                                                  __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            tp_destroy(fresh);
+        else pool = fresh;
+    }
+    return pool ? tp_size(pool) : 1;
+}
+
+// Ejecuta n trabajos en el pool (o en este hilo si no hay pool) y
+// espera solo a ellos: otros lectores pueden estar usando el pool
+static void run_jobs(FileSystem* fs, BlockJob* jobs, int n, tp_task fn) {
+    ThreadPool *pool = __atomic_load_n(&fs->pool, __ATOMIC_ACQUIRE);
+    if (!pool || n == 1) {
+        for (int i = 0; i < n; ++i) fn(&jobs[i]);
+        return;
+    }
+    TpGroup group = { 0 };
+    for (int i = 0; i < n; ++i) tp_submit_group(pool, &group, fn, &jobs[i]);
+    tp_wait_group(pool, &group);
+}
+
+// --------------------------------------------------------
+// Comprime src como contenedor de bloques hacia storage.bin. Se leen
+// tandas de varios bloques, se comprimen en paralelo y se escriben
+// en orden; al final va la tabla con el tamaño de cada bloque.
+// Cada bloque elige su códec.
+// --------------------------------------------------------
+static bool create_blocks(FileSystem* fs, FILE* src, size_t orig_size, size_t* comp_size) {
+    uint32_t nblocks = (uint32_t)((orig_size + FS_BLOCK_SIZE - 1) / FS_BLOCK_SIZE);
+    int batch = fs_threads(fs) * FS_BLOCKS_PER_THREAD;
+
+    uint8_t header[LZW_BLOCKS_HEADER_SIZE];
+    lzw_block_header_write(header, (uint64_t)orig_size, FS_BLOCK_SIZE, nblocks);
+    bool ok = storage_append(&fs->storage, header, sizeof(header));
+    size_t total = sizeof(header);
+
+    uint32_t *table = malloc(sizeof(uint32_t) * nblocks);
+    uint8_t *in = malloc((size_t)batch * FS_BLOCK_SIZE);
+    BlockJob *jobs = calloc(batch, sizeof(BlockJob));
+    if (!table || !in || !jobs) ok = false;
+
+    for (uint32_t b = 0; ok && b < nblocks; b += batch) {
+        int k = nblocks - b < (uint32_t)batch ? (int)(nblocks - b) : batch;
+
+        // Leer la tanda de bloques
+        for (int i = 0; i < k; ++i) {
+            size_t off = (size_t)(b + i) * FS_BLOCK_SIZE;
+            size_t len = orig_size - off < FS_BLOCK_SIZE ? orig_size - off : FS_BLOCK_SIZE;
+            jobs[i].in = in + (size_t)i * FS_BLOCK_SIZE;
+            jobs[i].in_len = len;
+            jobs[i].codec = fs->codec;
+            if (fread(in + (size_t)i * FS_BLOCK_SIZE, 1, len, src) != len) ok = false;
+        }
+        if (!ok) break;
+
+        // Comprimir en paralelo y escribir en orden
+        run_jobs(fs, jobs, k, compress_job);
+        for (int i = 0; i < k; ++i) {
+            if (ok && jobs[i].ok) {
+                ok = storage_append(&fs->storage, jobs[i].out, jobs[i].out_len);
+                table[b + i] = (uint32_t)jobs[i].out_len;
+                total += jobs[i].out_len;
+            } else {
+                ok = false;
+            }
+            free(jobs[i].out);
+        }
+    }
+
+    // Tabla de tamaños al final del contenedor
+    if (ok) ok = storage_append(&fs->storage, table, sizeof(uint32_t) * nblocks);
+    total += sizeof(uint32_t) * nblocks;
+
+    free(table);
+    free(in);
+    free(jobs);
+    *comp_size = total;
+    return ok;
+}
+
+// --------------------------------------------------------
+// Comprime src (orig_size bytes) y lo añade al final de
+// storage.bin precedido de su tamaño comprimido; devuelve su
+// posición en *pos y el formato usado en *codec. El archivo se lee
+// y se comprime por trozos de FS_CHUNK bytes (o por tandas de
+// bloques si es grande), así que la memoria usada no depende de su
+// tamaño. El códec de un archivo pequeño se elige con su primer
+// trozo.
+// --------------------------------------------------------
+static bool append_stream(FileSystem* fs, FILE* src, size_t orig_size, long* pos, size_t* comp_size,
+                          int* codec) {
+    *pos = (long)storage_tell(&fs->storage);
+    *comp_size = 0;
+    if (!storage_append(&fs->storage, comp_size, sizeof(size_t))) return false; // Se corrige al terminar
+
+    bool ok;
+    if (orig_size > FS_BLOCK_SIZE) {
+        // Archivo grande: bloques independientes en paralelo
+        *codec = CODEC_BLOCKS;
+        ok = create_blocks(fs, src, orig_size, comp_size);
+    } else {
+        // Comprimir por trozos con el códec elegido
+        uint8_t *chunk = malloc(FS_CHUNK);
+        size_t n = chunk ? fread(chunk, 1, FS_CHUNK, src) : 0;
+        *codec = fs->codec != CODEC_AUTO ? fs->codec : codec_choose(chunk, n);
+        CodecEnc *enc = chunk ? codec_enc_init(*codec, (uint64_t)orig_size, storage_sink, &fs->storage) : NULL;
+        ok = enc != NULL;
+        while (ok && n > 0) {
+            ok = codec_enc_feed(enc, chunk, n);
+            n = fread(chunk, 1, FS_CHUNK, src);
+        }
+        if (enc) ok = codec_enc_finish(enc, comp_size) && ok;
+        free(chunk);
+    }
+
+    // Escribir el tamaño comprimido delante de los datos
+    if (ok) ok = storage_patch(&fs->storage, (uint64_t)*pos, comp_size, sizeof(size_t));
+    return ok;
 }
 
 // --------------------------------------------------------
 // Crea (guarda) un archivo en el sistema de archivos virtual
 // --------------------------------------------------------
-bool fs_create(FileSystem* fs, const char* filename) {
+static bool create_file(FileSystem* fs, const char* filename) {
+    if (strlen(filename) > BTREE_KEY_MAX) {
+        printf("Error: nombre demasiado largo %s\n", filename);
+        return false;
+    }
     FILE *src = fopen(filename, "rb");
     if (!src) {
         printf("Error: no se pudo abrir %s\n", filename);
         return false;
     }
 
-    // Leer archivo original
+    // Tamaño del archivo original
     fseek(src, 0, SEEK_END);
     size_t orig_size = ftell(src);
     fseek(src, 0, SEEK_SET);
-    uint8_t *buf = malloc(orig_size);
-    if (!buf) { fclose(src); return false; }
-    fread(buf, 1, orig_size, src);
-    fclose(src);
 
-    // Comprimir con LZW
-    size_t comp_size = 0;
-    uint8_t *comp = lzw_compress(buf, orig_size, &comp_size);
-    free(buf);
-    if (!comp) {
-        printf("Error: compresion fallida\n");
+    // Si ya hay un blob con el mismo contenido, la llave lo comparte
+    BTreeValue value = { 0, 0, orig_size, { 0, 0 } }, old;
+    int codec = CODEC_AUTO;
+    blob_scan(fs);
+    if (!hash_stream(src, value.hash)) {
+        fclose(src);
+        printf("Error: no se pudo leer %s\n", filename);
         return false;
     }
+    DedupEntry *dup = dedup_lookup(fs, value.hash, orig_size);
+    if (dup) {
+        value.position = dup->position;
+        value.comp_size = dup->comp_size;
+        fs->dedup.hits++;
+        fs->dedup.saved += (uint64_t)blob_bytes(&value);
+    } else {
+        // Añadir al final de storage.bin
+        size_t comp_size = 0;
+        bool ok = append_stream(fs, src, orig_size, &value.position, &comp_size, &codec);
+        if (ok) ok = storage_blob_done(&fs->storage);
+        value.comp_size = comp_size;
+        if (!ok) {
+            fclose(src);
+            printf("Error: compresion fallida\n");
+            return false;
+        }
+    }
+    fclose(src);
 
-    // Guardar en storage.bin
-    FILE *storage = fopen(fs->storage_file, "ab");
-    if (!storage) {
-        free(comp);
-        printf("Error: no se pudo abrir almacenamiento\n");
+    // Insertar en el índice (B-tree) junto con los tamaños
+    bool had = index_get(fs, filename, &old);
+    if (!btree_insert(fs->index, filename, &value)) {
+        printf("Error: no se pudo indexar %s\n", filename);
         return false;
     }
-    long pos = ftell(storage); // Posición inicial
-    fwrite(&comp_size, sizeof(size_t), 1, storage); // Tamaño comprimido
-    fwrite(comp, 1, comp_size, storage);            // Datos comprimidos
-    fclose(storage);
-    free(comp);
+    blob_ref(fs, &value);
+    if (had) blob_unref(fs, &old);
+    journal_put(fs, filename, &value);
+    journal_tick(fs);
+    fs_cache_invalidate(fs, filename); // El contenido anterior ya no vale
+    METRIC_ADD(bytes_in, orig_size);
+    if (!dup) METRIC_ADD(bytes_out, sizeof(size_t) + value.comp_size);
 
-    // Insertar en el índice (B-tree)
-    btree_insert(&fs->index, filename, pos);
+    if (dup)
+        printf("Guardado '%s' (orig %zu bytes, duplicado: sin escribir)\n", filename, orig_size);
+    else
+        printf("Guardado '%s' (orig %zu bytes -> comp %zu bytes, %s)\n",
+               filename, orig_size, (size_t)value.comp_size, codec_name(codec));
+    return true;
+}
+
+bool fs_create(FileSystem* fs, const char* filename) {
+    METRIC_START(t);
+    fs_lock(fs);
+    bool ok = create_file(fs, filename);
+    fs_unlock(fs);
+    METRIC_END(METRIC_CREATE, t, ok);
+    return ok;
+}
+
+// --------------------------------------------------------
+// Ingesta en paralelo de muchos archivos (fs_create_many).
+// Etapas:
+//  1. Lectura: cada archivo se lee completo a memoria y se calcula
+//     su hash; los que ya están guardados no se comprimen. Con
+//     io_uring un solo hilo tiene en vuelo las aperturas, statx,
+//     lecturas y cierres de FS_INGEST_URING_DEPTH archivos, enviados
+//     por tandas con una llamada; si no lo hay, leen
+//     FS_INGEST_READERS hilos con fopen y fread.
+//  2. Pool de compresión: comprime cada archivo leído.
+//  3. Anexador (hilo que llama): escribe los blobs en storage.bin
+//     en el orden de entrada y asigna las posiciones; un archivo
+//     igual a otro de la misma tanda comparte el blob de ese.
+//  4. Inserción de todas las entradas en el índice al final.
+// Solo hay FS_INGEST_WINDOW archivos en vuelo por delante del
+// anexador, lo que acota la memoria. Los archivos mayores que un
+// bloque no se leen a memoria: el anexador los guarda por el
+// camino normal (append_stream) al llegar su turno.
+// --------------------------------------------------------
+#define FS_INGEST_READERS 2
+#define FS_INGEST_WINDOW_PER_THREAD 8
+#define FS_INGEST_URING_DEPTH 64
 
-    printf("Guardado '%s' (orig %zu bytes -> comp %zu bytes)\n",
-           filename, orig_size, comp_size);
+typedef struct {
+    const char *path;
+    uint8_t *data;       // Contenido leído
+    size_t orig_size;
+    uint8_t *comp;       // Blob comprimido
+    size_t comp_size;
+    long pos;            // Posición asignada en storage.bin
+    int codec;           // Formato del blob
+    uint64_t hash[2];    // Hash del contenido (0 si no se pudo leer)
+    int large;           // Se guarda por append_stream
+    int dup;             // Ya guardado: no se comprime
+    int ready;           // Lista para el anexador
+    int ok;
+} IngestItem;
+
+typedef struct {
+    FileSystem *fs;
+    IngestItem *items;
+    int n;
+    int next_read;       // Siguiente archivo a leer
+    int appended;        // Archivos ya escritos por el anexador
+    int window;          // Archivos en vuelo como máximo
+    ThreadPool *pool;
+    Uring *uring;        // NULL: lectura con hilos
+    pthread_mutex_t lock;
+    pthread_cond_t item_ready;  // Algún archivo quedó listo
+    pthread_cond_t progress;    // El anexador avanzó
+} Ingest;
+
+// Marca un archivo como listo y despierta al anexador
+static void ingest_done(Ingest* in, IngestItem* it) {
+    pthread_mutex_lock(&in->lock);
+    it->ready = 1;
+    pthread_cond_broadcast(&in->item_ready);
+    pthread_mutex_unlock(&in->lock);
+}
+
+typedef struct {
+    Ingest *in;
+    IngestItem *it;
+} IngestJob;
+
+static void ingest_compress(void* arg) {
+    IngestJob *job = arg;
+    IngestItem *it = job->it;
+    it->comp = codec_compress(job->in->fs->codec, it->data, it->orig_size, &it->comp_size);
+    it->ok = it->comp != NULL;
+    if (it->ok) it->codec = codec_format(it->comp, it->comp_size);
+    free(it->data);
+    it->data = NULL;
+    ingest_done(job->in, it);
+    free(job);
+}
+
+// Siguiente archivo por leer dentro de la ventana; con wait espera
+// a que el anexador haga sitio. NULL si no quedan (o si, sin wait,
+// la ventana está llena).
+static IngestItem* ingest_take(Ingest* in, bool wait) {
+    pthread_mutex_lock(&in->lock);
+    while (wait && in->next_read < in->n && in->next_read >= in->appended + in->window)
+        pthread_cond_wait(&in->progress, &in->lock);
+    IngestItem *it = NULL;
+    if (in->next_read < in->n && in->next_read < in->appended + in->window)
+        it = &in->items[in->next_read++];
+    pthread_mutex_unlock(&in->lock);
+    return it;
+}
+
+// Archivo grande: solo se calcula su hash; el anexador lo guarda
+// por append_stream. Cierra src.
+static void ingest_large(IngestItem* it, FILE* src) {
+    it->large = 1;
+    it->ok = 1;
+    if (!hash_stream(src, it->hash)) it->hash[0] = it->hash[1] = 0;
+    fclose(src);
+}
+
+// Archivo leído (o que no se pudo leer): si hace falta comprimirlo
+// se manda al pool; si no, queda listo para el anexador
+static void ingest_loaded(Ingest* in, IngestItem* it) {
+    if (it->ok && it->data) dedup_hash(it->data, it->orig_size, it->hash);
+
+    // El anexador es el único que cambia la tabla, y lo hace
+    // con el cerrojo tomado
+    if (it->ok && dedup_hash_known(it->hash)) {
+        pthread_mutex_lock(&in->lock);
+        const DedupEntry *e = dedup_find(&in->fs->dedup, it->hash);
+        it->dup = e && e->orig_size == it->orig_size;
+        pthread_mutex_unlock(&in->lock);
+    }
+    if (it->large || it->dup || !it->ok) {
+        free(it->data);
+        it->data = NULL;
+        ingest_done(in, it);
+        return;
+    }
+    IngestJob *job = malloc(sizeof(IngestJob));
+    if (!job) {
+        free(it->data);
+        it->data = NULL;
+        it->ok = 0;
+        ingest_done(in, it);
+        return;
+    }
+    job->in = in;
+    job->it = it;
+    tp_submit(in->pool, ingest_compress, job);
+}
+
+// Hilo lector: toma el siguiente archivo dentro de la ventana
+static void* ingest_reader(void* arg) {
+    Ingest *in = arg;
+    IngestItem *it;
+    while ((it = ingest_take(in, true)) != NULL) {
+        FILE *src = fopen(it->path, "rb");
+        if (!src) {
+            ingest_done(in, it);
+            continue;
+        }
+        fseek(src, 0, SEEK_END);
+        it->orig_size = ftell(src);
+        fseek(src, 0, SEEK_SET);
+        if (it->orig_size > FS_BLOCK_SIZE) {
+            ingest_large(it, src);
+        } else {
+            it->data = malloc(it->orig_size ? it->orig_size : 1);
+            it->ok = it->data && fread(it->data, 1, it->orig_size, src) == it->orig_size;
+            fclose(src);
+        }
+        ingest_loaded(in, it);
+    }
+    return NULL;
+}
+
+// --------------------------------------------------------
+// Lectura con io_uring. Cada archivo ocupa un hueco y pasa por dos
+// tandas de peticiones: openat y statx a la vez y, con el tamaño y
+// el descriptor, read enlazado con close. El user de cada petición
+// es hueco * 4 + operación.
+// --------------------------------------------------------
+enum { URING_OPEN, URING_STAT, URING_READ, URING_CLOSE };
+
+typedef struct {
+    IngestItem *it;
+    UringStat st;
+    int fd;
+    int stat_res;
+    int pending;         // Peticiones de la tanda aún sin terminar
+    int reading;         // En la segunda tanda
+} UringSlot;
+
+// Terminadas openat y statx: pide la lectura y el cierre o resuelve
+// aquí el archivo. Devuelve verdadero si sigue en vuelo.
+static bool uring_opened(Ingest* in, UringSlot* sl, uint64_t slot) {
+    IngestItem *it = sl->it;
+    if (sl->fd < 0 || sl->stat_res < 0 || !uring_stat_regular(&sl->st)) {
+        if (sl->fd >= 0) close(sl->fd);
+        return false;
+    }
+    it->orig_size = (size_t)uring_stat_size(&sl->st);
+    if (it->orig_size > FS_BLOCK_SIZE) {
+        FILE *src = fdopen(sl->fd, "rb");
+        if (src) ingest_large(it, src);
+        else close(sl->fd);
+        return false;
+    }
+    it->data = malloc(it->orig_size ? it->orig_size : 1);
+    if (!it->data ||
+        !uring_read(in->uring, sl->fd, it->data, (unsigned)it->orig_size, 0, true, slot * 4 + URING_READ) ||
+        !uring_close(in->uring, sl->fd, slot * 4 + URING_CLOSE)) {
+        // La cola tiene sitio para dos peticiones por hueco: no pasa
+        close(sl->fd);
+        return false;
+    }
+    sl->pending = 2;
+    sl->reading = 1;
     return true;
 }
 
+static void* ingest_uring_reader(void* arg) {
+    Ingest *in = arg;
+    Uring *u = in->uring;
+    int nslots = in->window;
+    UringSlot *slots = calloc(nslots, sizeof(UringSlot));
+    int *free_slots = malloc(sizeof(int) * nslots);
+    if (!slots || !free_slots) {
+        free(slots);
+        free(free_slots);
+        return ingest_reader(in);
+    }
+    int nfree = 0, inflight = 0;
+    for (int i = nslots; i-- > 0;) free_slots[nfree++] = i;
+
+    while (1) {
+        // Cada archivo nuevo pide openat y statx; si no hay nada en
+        // vuelo se espera a que el anexador deje sitio
+        IngestItem *it;
+        while (nfree > 0 && (it = ingest_take(in, inflight == 0)) != NULL) {
+            int s = free_slots[--nfree];
+            UringSlot *sl = &slots[s];
+            memset(sl, 0, sizeof(*sl));
+            sl->it = it;
+            sl->fd = -1;
+            sl->pending = 2;
+            inflight++;
+            if (!uring_openat(u, it->path, O_RDONLY | O_CLOEXEC, (uint64_t)s * 4 + URING_OPEN) ||
+                !uring_statx(u, it->path, &sl->st, (uint64_t)s * 4 + URING_STAT))
+                sl->pending = -1;   // No cabe (no pasa): se resuelve abajo
+        }
+        if (inflight == 0) break;
+
+        // Una llamada envía lo preparado y espera la primera terminada
+        if (!uring_submit(u, 1)) {
+            // El núcleo aún puede escribir en los huecos en vuelo: se
+            // dan por perdidos sin liberarlos y el resto se lee con fread
+            printf("Error: io_uring dejo de responder; se sigue con lecturas normales\n");
+            for (int i = 0; i < nslots; ++i) {
+                if (!slots[i].it) continue;
+                slots[i].it->data = NULL;
+                slots[i].it->ok = 0;
+                ingest_done(in, slots[i].it);
+            }
+            free(free_slots);
+            return ingest_reader(in);
+        }
+
+        uint64_t user;
+        int res;
+        while (uring_next(u, &user, &res)) {
+            uint64_t s = user / 4;
+            UringSlot *sl = &slots[s];
+            switch (user % 4) {
+            case URING_OPEN: sl->fd = res; break;
+            case URING_STAT: sl->stat_res = res; break;
+            case URING_READ: sl->it->ok = res >= 0 && (size_t)res == sl->it->orig_size; break;
+            case URING_CLOSE:
+                // Cancelado porque la lectura falló: se cierra aquí
+                if (res == -ECANCELED) close(sl->fd);
+                break;
+            }
+            if (--sl->pending > 0) continue;
+            if (!sl->reading && uring_opened(in, sl, s)) continue;
+            ingest_loaded(in, sl->it);
+            sl->it = NULL;
+            free_slots[nfree++] = (int)s;
+            inflight--;
+        }
+
+        // Peticiones que no cupieron en la cola
+        for (int i = 0; i < nslots; ++i) {
+            if (!slots[i].it || slots[i].pending != -1) continue;
+            ingest_loaded(in, slots[i].it);
+            slots[i].it = NULL;
+            free_slots[nfree++] = i;
+            inflight--;
+        }
+    }
+    free(slots);
+    free(free_slots);
+    return NULL;
+}
+
+static int create_many(FileSystem* fs, const char** paths, int n) {
+    Ingest in;
+    memset(&in, 0, sizeof(in));
+    in.fs = fs;
+    in.items = calloc(n > 0 ? n : 1, sizeof(IngestItem));
+    in.n = n;
+    in.pool = tp_create(tp_cpu_count());
+    in.window = (in.pool ? tp_size(in.pool) : 1) * FS_INGEST_WINDOW_PER_THREAD;
+    if (!in.items || !in.pool) {
+        free(in.items);
+        tp_destroy(in.pool);
+        return 0;
+    }
+    for (int i = 0; i < n; ++i) in.items[i].path = paths[i];
+    blob_scan(fs);
+    pthread_mutex_init(&in.lock, NULL);
+    pthread_cond_init(&in.item_ready, NULL);
+    pthread_cond_init(&in.progress, NULL);
+
+    // Con io_uring basta un lector con muchos archivos en vuelo; la
+    // cola tiene sitio para dos peticiones por archivo
+    pthread_t readers[FS_INGEST_READERS];
+    int nreaders = 0;
+    if (fs->ingest_uring && n > 1) {
+        if (in.window < FS_INGEST_URING_DEPTH) in.window = FS_INGEST_URING_DEPTH;
+        in.uring = uring_create(2 * (unsigned)in.window);
+        if (in.uring && pthread_create(&readers[0], NULL, ingest_uring_reader, &in) == 0) {
+            nreaders = 1;
+        } else {
+            uring_destroy(in.uring);
+            in.uring = NULL;
+            in.window = (in.pool ? tp_size(in.pool) : 1) * FS_INGEST_WINDOW_PER_THREAD;
+        }
+    }
+    for (int r = 0; !in.uring && r < FS_INGEST_READERS; ++r)
+        if (pthread_create(&readers[nreaders], NULL, ingest_reader, &in) == 0) nreaders++;
+    if (nreaders == 0) {
+        // Sin hilos lectores: leer aquí todo sin ventana
+        in.window = n;
+        ingest_reader(&in);
+    }
+
+    // Anexador: escribe los blobs en el orden de entrada. Cada
+    // archivo anota como latencia el tiempo desde el anterior (la
+    // suma es lo que tarda la tanda).
+    METRIC_START(t);
+    for (int i = 0; i < n; ++i) {
+        IngestItem *it = &in.items[i];
+        pthread_mutex_lock(&in.lock);
+        while (!it->ready) pthread_cond_wait(&in.item_ready, &in.lock);
+        pthread_mutex_unlock(&in.lock);
+
+        // Blob igual ya guardado, antes o en esta misma tanda
+        const DedupEntry *dup = NULL;
+        if (it->ok && dedup_hash_known(it->hash))
+            dup = dedup_lookup(fs, it->hash, it->orig_size);
+        if (dup) {
+            it->pos = dup->position;
+            it->comp_size = dup->comp_size;
+            fs->dedup.hits++;
+            fs->dedup.saved += sizeof(size_t) + it->comp_size;
+        } else if (it->ok && (it->large || it->dup)) {
+            // Grande, o el blob que se esperaba compartir no se puede usar
+            FILE *src = fopen(it->path, "rb");
+            it->ok = src && append_stream(fs, src, it->orig_size, &it->pos, &it->comp_size, &it->codec);
+            if (src) fclose(src);
+        } else if (it->ok) {
+            it->pos = (long)storage_tell(&fs->storage);
+            it->ok = storage_append(&fs->storage, &it->comp_size, sizeof(size_t)) &&
+                     storage_append(&fs->storage, it->comp, it->comp_size);
+        }
+        free(it->comp);
+        it->comp = NULL;
+        if (it->ok && !dup) it->ok = storage_blob_done(&fs->storage);
+
+        // Blob nuevo: queda en la tabla (sin referencias hasta que
+        // se indexe) para los siguientes archivos iguales
+        if (it->ok && !dup && dedup_hash_known(it->hash) && !dedup_find(&fs->dedup, it->hash)) {
+            pthread_mutex_lock(&in.lock);
+            dedup_add(&fs->dedup, it->hash, it->pos, it->comp_size, it->orig_size);
+            pthread_mutex_unlock(&in.lock);
+        }
+
+        if (it->ok && dup) {
+            printf("Guardado '%s' (orig %zu bytes, duplicado: sin escribir)\n",
+                   it->path, it->orig_size);
+        } else if (it->ok) {
+            printf("Guardado '%s' (orig %zu bytes -> comp %zu bytes, %s)\n",
+                   it->path, it->orig_size, it->comp_size, codec_name(it->codec));
+        } else {
+            printf("Error: no se pudo guardar %s\n", it->path);
+        }
+        if (it->ok) METRIC_ADD(bytes_in, it->orig_size);
+        if (it->ok && !dup) METRIC_ADD(bytes_out, sizeof(size_t) + it->comp_size);
+#if FS_METRICS
+        uint64_t done = metrics_now();
+        metrics_record(METRIC_CREATE, done - t, it->ok);
+        t = done;
+#endif
+
+        pthread_mutex_lock(&in.lock);
+        in.appended = i + 1;
+        pthread_cond_broadcast(&in.progress);
+        pthread_mutex_unlock(&in.lock);
+    }
+
+    for (int r = 0; r < nreaders; ++r) pthread_join(readers[r], NULL);
+    uring_destroy(in.uring);
+    tp_destroy(in.pool);
+    bool ok = storage_commit(&fs->storage);
+
+    // Inserción en el índice de todos los archivos guardados
+    int count = 0;
+    for (int i = 0; ok && i < n; ++i) {
+        if (!in.items[i].ok) continue;
+        const IngestItem *it = &in.items[i];
+        BTreeValue value = { it->pos, it->comp_size, it->orig_size, { it->hash[0], it->hash[1] } }, old;
+        bool had = index_get(fs, it->path, &old);
+        if (!btree_insert(fs->index, it->path, &value)) {
+            printf("Error: no se pudo indexar %s\n", it->path);
+            continue;
+        }
+        blob_ref(fs, &value);
+        if (had) blob_unref(fs, &old);
+        journal_put(fs, it->path, &value);
+        fs_cache_invalidate(fs, it->path);
+        count++;
+    }
+    journal_tick(fs);
+
+    pthread_mutex_destroy(&in.lock);
+    pthread_cond_destroy(&in.item_ready);
+    pthread_cond_destroy(&in.progress);
+    free(in.items);
+    return count;
+}
+
+int fs_create_many(FileSystem* fs, const char** paths, int n) {
+    fs_lock(fs);
+    int r = create_many(fs, paths, n);
+    fs_unlock(fs);
+    return r;
+}
+
 // --------------------------------------------------------
-// Lee (muestra) un archivo del sistema virtual
+// Sink que solo deja pasar el rango [skip, skip + remaining) de
+// la salida y corta la descompresión al completarlo
 // --------------------------------------------------------
-bool fs_read(FileSystem* fs, const char* filename) {
+typedef struct {
+    FILE *out;           // Destino (o NULL si se escribe en mem)
+    uint8_t *mem;
+    uint64_t skip;       // Bytes que aún hay que descartar
+    uint64_t remaining;  // Bytes que aún hay que escribir
+} RangeSink;
+
+static int range_write(RangeSink* r, const uint8_t* data, size_t len) {
+    if (r->skip >= len) {
+        r->skip -= len;
+        return 1;
+    }
+    data += r->skip;
+    len -= (size_t)r->skip;
+    r->skip = 0;
+    if (len > r->remaining) len = (size_t)r->remaining;
+    r->remaining -= len;
+    if (!r->out) {
+        memcpy(r->mem, data, len);
+        r->mem += len;
+        return 1;
+    }
+    return fwrite(data, 1, len, r->out) == len;
+}
+
+static int range_sink(void* user, const uint8_t* data, size_t len) {
+    RangeSink *r = user;
+    if (r->remaining == 0) return 0;  // Rango completo: parar
+    return range_write(r, data, len);
+}
+
+// --------------------------------------------------------
+// Descomprime el rango [offset, offset + length) de un contenedor
+// de bloques que empieza en la posición blob_pos de storage.bin
+// (ya leídos sus primeros LZW_HEADER_SIZE bytes, en head). Solo se
+// leen y descomprimen los bloques que cubren el rango, por tandas
+// en paralelo, y se escriben en orden en r.
+// --------------------------------------------------------
+static bool read_blocks(FileSystem* fs, uint64_t blob_pos, size_t comp_size, const uint8_t* head,
+                        uint64_t offset, uint64_t length, RangeSink* r) {
+    uint8_t header[LZW_BLOCKS_HEADER_SIZE];
+    LZWBlockHeader h;
+    memcpy(header, head, LZW_HEADER_SIZE);
+    size_t rest = LZW_BLOCKS_HEADER_SIZE - LZW_HEADER_SIZE;
+    if (!storage_read(&fs->storage, blob_pos + LZW_HEADER_SIZE, header + LZW_HEADER_SIZE, rest) ||
+        !lzw_block_header(header, comp_size, &h)) return false;
+    uint64_t data_pos = blob_pos + LZW_BLOCKS_HEADER_SIZE;
+    if (length == 0 || h.nblocks == 0) return true;
+
+    // Tabla de tamaños al final del contenedor
+    uint32_t *table = malloc(sizeof(uint32_t) * h.nblocks);
+    if (!table) return false;
+    bool ok = storage_read(&fs->storage, blob_pos + comp_size - sizeof(uint32_t) * h.nblocks,
+                           table, sizeof(uint32_t) * h.nblocks);
+
+    // Bloques que cubren el rango y posición del primero
+    uint32_t first = (uint32_t)(offset / h.block_size);
+    uint32_t last = (uint32_t)((offset + length - 1) / h.block_size);
+    if (last >= h.nblocks) last = h.nblocks - 1;
+    uint64_t block_pos = data_pos;
+    for (uint32_t i = 0; i < first; ++i) block_pos += table[i];
+
+    int batch = fs_threads(fs) * FS_BLOCKS_PER_THREAD;
+    size_t in_cap = 0;
+    uint8_t *in = NULL;
+    uint8_t *dec = malloc((size_t)batch * h.block_size);
+    BlockJob *jobs = calloc(batch, sizeof(BlockJob));
+    if (!dec || !jobs) ok = false;
+
+    r->skip = offset - (uint64_t)first * h.block_size;
+    r->remaining = length;
+    for (uint32_t b = first; ok && b <= last; b += batch) {
+        int k = last + 1 - b < (uint32_t)batch ? (int)(last + 1 - b) : batch;
+
+        // Bloques comprimidos de la tanda: directamente de la
+        // proyección o, sin ella, leídos de una vez a un buffer
+        size_t need = 0;
+        for (int i = 0; i < k; ++i) need += table[b + i];
+        const uint8_t *src = storage_view(&fs->storage, block_pos, need);
+        if (!src) {
+            if (need > in_cap) {
+                uint8_t *grown = realloc(in, need);
+                if (!grown) { ok = false; break; }
+                in = grown;
+                in_cap = need;
+            }
+            if (!storage_read(&fs->storage, block_pos, in, need)) { ok = false; break; }
+            src = in;
+        }
+        block_pos += need;
+
+        size_t off = 0;
+        for (int i = 0; i < k; ++i) {
+            jobs[i].in = src + off;
+            jobs[i].in_len = table[b + i];
+            jobs[i].out = dec + (size_t)i * h.block_size;
+            jobs[i].out_cap = h.block_size;
+            off += table[b + i];
+        }
+
+        // Descomprimir en paralelo y escribir en orden
+        run_jobs(fs, jobs, k, decompress_job);
+        for (int i = 0; i < k && ok; ++i)
+            ok = jobs[i].ok && range_write(r, jobs[i].out, jobs[i].out_len);
+    }
+
+    free(table);
+    free(in);
+    free(dec);
+    free(jobs);
+    return ok && r->remaining == 0;
+}
+
+// --------------------------------------------------------
+// Copia [offset, offset + length) de un blob guardado sin comprimir:
+// el rango se lee directamente, sin pasar por lo anterior
+// --------------------------------------------------------
+static bool read_stored(FileSystem* fs, uint64_t blob_pos, uint64_t offset, uint64_t length,
+                        RangeSink* r) {
+    r->skip = 0;
+    r->remaining = length;
+    uint8_t *chunk = NULL;
+    uint64_t at = blob_pos + LZW_HEADER_SIZE + offset;
+    bool ok = true;
+    while (ok && r->remaining > 0) {
+        size_t n = r->remaining < FS_CHUNK ? (size_t)r->remaining : FS_CHUNK;
+        const uint8_t *src = storage_view(&fs->storage, at, n);
+        if (!src) {
+            if (!chunk && !(chunk = malloc(FS_CHUNK))) { ok = false; break; }
+            if (!storage_read(&fs->storage, at, chunk, n)) { ok = false; break; }
+            src = chunk;
+        }
+        ok = range_write(r, src, n);
+        at += n;
+    }
+    free(chunk);
+    return ok;
+}
+
+// --------------------------------------------------------
+// Descomprime [offset, offset + length) del blob en blob_pos
+// (ya leída su cabecera en head) hacia r
+// --------------------------------------------------------
+static bool decode_range(FileSystem* fs, uint64_t blob_pos, size_t comp_size, const uint8_t* head,
+                         uint64_t offset, uint64_t length, RangeSink* r) {
+    int format = codec_format(head, comp_size);
+    if (format == CODEC_BLOCKS)
+        return read_blocks(fs, blob_pos, comp_size, head, offset, length, r);
+    if (format == CODEC_STORED)
+        return read_stored(fs, blob_pos, offset, length, r);
+
+    // Descomprimir por trozos hasta completar el rango. Con mmap
+    // los trozos apuntan a la proyección y no se copia nada.
+    r->skip = offset;
+    r->remaining = length;
+    uint8_t *chunk = NULL;
+    CodecDec *dec = codec_dec_init(comp_size, range_sink, r);
+    bool ok = dec != NULL && codec_dec_feed(dec, head, LZW_HEADER_SIZE);
+    uint64_t at = blob_pos + LZW_HEADER_SIZE;
+    size_t left = comp_size - LZW_HEADER_SIZE;
+    while (ok && left > 0 && r->remaining > 0) {
+        size_t n = left < FS_CHUNK ? left : FS_CHUNK;
+        const uint8_t *src = storage_view(&fs->storage, at, n);
+        if (!src) {
+            if (!chunk && !(chunk = malloc(FS_CHUNK))) { ok = false; break; }
+            if (!storage_read(&fs->storage, at, chunk, n)) { ok = false; break; }
+            src = chunk;
+        }
+        ok = codec_dec_feed(dec, src, n);
+        at += n;
+        left -= n;
+    }
+    // Si se cortó al completar el rango, el contexto queda incompleto
+    if (dec) ok = (codec_dec_finish(dec, NULL) && ok) || r->remaining == 0;
+    free(chunk);
+    return ok;
+}
+
+// Línea con el nombre y el tamaño que precede al contenido
+static void print_read_header(const char* filename, uint64_t offset, uint64_t length, uint64_t orig_size) {
+    if (offset == 0 && length == orig_size)
+        printf("Contenido de '%s' (%llu bytes):\n", filename, (unsigned long long)orig_size);
+    else
+        printf("Contenido de '%s' [%llu, %llu) de %llu bytes:\n", filename,
+               (unsigned long long)offset, (unsigned long long)(offset + length),
+               (unsigned long long)orig_size);
+}
+
+// --------------------------------------------------------
+// Descomprime el rango [offset, offset + length) de un archivo
+// del sistema virtual hacia out. El rango se recorta al tamaño
+// del archivo. Si header es verdadero, antes del contenido se
+// imprime una línea con el nombre y el tamaño. Con sequential se
+// avisa al sistema de que el blob se recorre entero una vez.
+//
+// Los archivos que caben en la caché se descomprimen enteros la
+// primera vez y las lecturas siguientes salen de la caché sin
+// tocar storage.bin. Las lecturas secuenciales (exportaciones)
+// usan la caché pero no la llenan.
+//
+// Se llama dentro de una sección de época (fs_read_to).
+// --------------------------------------------------------
+static bool read_to(FileSystem* fs, const char* filename, uint64_t offset, uint64_t length,
+                    FILE* out, bool header, bool sequential) {
+    // Contenido ya descomprimido en la caché: el rango se copia con
+    // el cerrojo tomado y se escribe sin él. La generación se toma
+    // antes de buscar en el índice: si un escritor cambia el archivo
+    // mientras tanto, lo que se descomprima no entra en la caché
+    pthread_mutex_lock(&fs->cache_lock);
+    uint64_t gen = fs->cache_gen;
+    size_t cached_len = 0;
+    const uint8_t *cached = cache_get(&fs->cache, filename, &cached_len);
+    uint8_t *copy = NULL;
+    if (cached) {
+        if (offset > cached_len) offset = cached_len;
+        if (length > cached_len - offset) length = cached_len - offset;
+        copy = malloc(length ? (size_t)length : 1);
+        if (copy) memcpy(copy, cached + offset, (size_t)length);
+    }
+    pthread_mutex_unlock(&fs->cache_lock);
+    if (copy) {
+        if (header) print_read_header(filename, offset, length, cached_len);
+        bool ok = fwrite(copy, 1, (size_t)length, out) == length;
+        free(copy);
+        return ok;
+    }
+
     // Buscar posición en el índice
-    long pos = btree_search(fs->index, filename);
-    if (pos == -1) {
+    BTreeValue value;
+    if (!view_get(view_current(fs), filename, &value)) {
         printf("Error: '%s' no encontrado\n", filename);
         return false;
     }
+    long pos = value.position;
 
-    FILE *storage = fopen(fs->storage_file, "rb");
-    if (!storage) {
-        printf("Error: no se pudo abrir almacenamiento\n");
+    // Lee tamaño comprimido y la cabecera del blob
+    uint64_t blob_pos = (uint64_t)pos + sizeof(size_t);
+    size_t comp_size = 0;
+    uint8_t head[LZW_HEADER_SIZE];
+    uint64_t orig_size = 0;
+    if (!storage_read(&fs->storage, (uint64_t)pos, &comp_size, sizeof(size_t)) ||
+        comp_size < LZW_HEADER_SIZE ||
+        !storage_read(&fs->storage, blob_pos, head, LZW_HEADER_SIZE) ||
+        !codec_orig_size(head, comp_size, &orig_size)) {
+        printf("Error: descompresion fallida\n");
         return false;
     }
-    fseek(storage, pos, SEEK_SET);
 
-    // Lee tamaño comprimido y datos
-    size_t comp_size;
-    fread(&comp_size, sizeof(size_t), 1, storage);
-    uint8_t *comp = malloc(comp_size);
-    fread(comp, 1, comp_size, storage);
-    fclose(storage);
+    // Recortar el rango al tamaño del archivo
+    if (offset > orig_size) offset = orig_size;
+    if (length > orig_size - offset) length = orig_size - offset;
+    if (header) print_read_header(filename, offset, length, orig_size);
 
-    // Descomprimir con LZW
-    size_t orig_size;
-    uint8_t *orig = lzw_decompress(comp, comp_size, &orig_size);
-    free(comp);
-    if (!orig) {
+    if (sequential) storage_advise(&fs->storage, blob_pos, comp_size, STORAGE_ADV_SEQUENTIAL);
+
+    // Solo las lecturas del archivo entero llenan la caché: un rango
+    // descomprime únicamente los bloques que lo cubren
+    bool ok;
+    bool cacheable = false;
+    if (!sequential && offset == 0 && length == orig_size && orig_size == (size_t)orig_size) {
+        pthread_mutex_lock(&fs->cache_lock);
+        cacheable = cache_accepts(&fs->cache, (size_t)orig_size);
+        pthread_mutex_unlock(&fs->cache_lock);
+    }
+    if (cacheable) {
+        // Descomprimir entero en memoria, escribirlo y guardarlo
+        uint8_t *data = malloc(orig_size ? (size_t)orig_size : 1);
+        RangeSink r = { NULL, data, 0, 0 };
+        ok = data && decode_range(fs, blob_pos, comp_size, head, 0, orig_size, &r) && r.remaining == 0;
+        if (ok) ok = fwrite(data, 1, (size_t)length, out) == length;
+        if (ok) {
+            pthread_mutex_lock(&fs->cache_lock);
+            if (fs->cache_gen == gen) cache_put(&fs->cache, filename, data, (size_t)orig_size);
+            else free(data);
+            pthread_mutex_unlock(&fs->cache_lock);
+        } else {
+            free(data);
+        }
+    } else {
+        RangeSink r = { out, NULL, 0, 0 };
+        ok = decode_range(fs, blob_pos, comp_size, head, offset, length, &r);
+    }
+
+    // Las páginas de una exportación no se van a volver a leer
+    if (sequential) storage_advise(&fs->storage, blob_pos, comp_size, STORAGE_ADV_DONTNEED);
+
+    if (!ok) {
         printf("Error: descompresion fallida\n");
         return false;
     }
+    return true;
+}
+
+static bool fs_read_to(FileSystem* fs, const char* filename, uint64_t offset, uint64_t length,
+                       FILE* out, bool header, bool sequential) {
+    METRIC_START(t);
+    int slot = epoch_enter(&fs->epoch);
+    bool ok = read_to(fs, filename, offset, length, out, header, sequential);
+    epoch_exit(&fs->epoch, slot);
+    METRIC_END(METRIC_READ, t, ok);
+    return ok;
+}
 
-    // Mostrar contenido
-    printf("Contenido de '%s' (%zu bytes):\n", filename, orig_size);
-    fwrite(orig, 1, orig_size, stdout);
+// --------------------------------------------------------
+// Lee (muestra) un archivo del sistema virtual
+// --------------------------------------------------------
+bool fs_read(FileSystem* fs, const char* filename) {
+    if (!fs_read_to(fs, filename, 0, UINT64_MAX, stdout, true, false)) return false;
     printf("\n---\n");
-    free(orig);
     return true;
 }
 
+// --------------------------------------------------------
+// Lee (muestra) solo length bytes de un archivo desde offset.
+// En archivos grandes solo se descomprimen los bloques que
+// cubren el rango.
+// --------------------------------------------------------
+bool fs_read_range(FileSystem* fs, const char* filename, uint64_t offset, uint64_t length) {
+    if (!fs_read_to(fs, filename, offset, length, stdout, true, false)) return false;
+    printf("\n---\n");
+    return true;
+}
+
+// --------------------------------------------------------
+// Escribe en out el rango [offset, offset + length) de un archivo,
+// sin cabecera ni separador
+// --------------------------------------------------------
+bool fs_read_into(FileSystem* fs, const char* filename, uint64_t offset, uint64_t length, FILE* out) {
+    return fs_read_to(fs, filename, offset, length, out, false, false);
+}
+
+bool fs_stat(FileSystem* fs, const char* filename, PidxValue* out) {
+    BTreeValue v;
+    int slot = epoch_enter(&fs->epoch);
+    bool found = view_get(view_current(fs), filename, &v);
+    epoch_exit(&fs->epoch, slot);
+    if (found) *out = disk_value(&v);
+    return found;
+}
+
+// --------------------------------------------------------
+// Exporta un archivo del sistema virtual a un archivo real
+// --------------------------------------------------------
+bool fs_export(FileSystem* fs, const char* filename, const char* dest) {
+    FILE *out = fopen(dest, "wb");
+    if (!out) {
+        printf("Error: no se pudo crear %s\n", dest);
+        return false;
+    }
+    bool ok = fs_read_to(fs, filename, 0, UINT64_MAX, out, false, true);
+    if (fclose(out) != 0) ok = false;
+    if (ok) printf("Exportado '%s' a %s\n", filename, dest);
+    return ok;
+}
+
 // --------------------------------------------------------
 // Elimina un archivo del índice (pero no del storage.bin)
 // --------------------------------------------------------
 bool fs_delete(FileSystem* fs, const char* filename) {
-    btree_delete(&fs->index, filename);
-    printf("Eliminado '%s' del indice \n", filename);
+    METRIC_START(t);
+    fs_lock(fs);
+    bool found = index_remove(fs, filename);
+    if (found) journal_del(fs, filename);
+    journal_tick(fs);
+    fs_cache_invalidate(fs, filename);
+    fs_unlock(fs);
+    if (found) printf("Eliminado '%s' del indice \n", filename);
+    else printf("Error: '%s' no encontrado\n", filename);
+    METRIC_END(METRIC_DELETE, t, found);
+    return found;
+}
+
+// Límite de un listado: llaves con el prefijo o hasta to (incluida)
+typedef struct {
+    const char *prefix;
+    size_t prefix_len;
+    const char *to;
+    size_t count;
+} ListCtx;
+
+static bool print_entry(void* user, const char* key, const PidxValue* value) {
+    ListCtx *l = user;
+    (void)value;
+    if (l->prefix && strncmp(key, l->prefix, l->prefix_len) != 0) return false;
+    if (l->to && strcmp(key, l->to) > 0) return false;
+    printf("- %s\n", key);
+    l->count++;
+    return true;
+}
+
+// Archivos con un prefijo y su posición en storage, para readall
+typedef struct {
+    char *name;
+    uint64_t position;
+} ReadAllItem;
+
+typedef struct {
+    const char *prefix;
+    size_t prefix_len;
+    ReadAllItem *items;
+    size_t n, cap;
+    bool ok;
+} ReadAllCtx;
+
+static bool collect_prefix(void* user, const char* key, const PidxValue* value) {
+    ReadAllCtx *r = user;
+    if (strncmp(key, r->prefix, r->prefix_len) != 0) return false;
+    if (r->n == r->cap) {
+        size_t cap = r->cap ? r->cap * 2 : 256;
+        ReadAllItem *grown = realloc(r->items, sizeof(ReadAllItem) * cap);
+        if (!grown) return r->ok = false;
+        r->items = grown;
+        r->cap = cap;
+    }
+    char *copy = strdup(key);
+    if (!copy) return r->ok = false;
+    r->items[r->n].name = copy;
+    r->items[r->n].position = value->position;
+    r->n++;
     return true;
 }
 
+// Por posición en storage (segmento y desplazamiento); los nombres
+// que comparten blob quedan en el orden del índice
+static int cmp_position(const void* a, const void* b) {
+    const ReadAllItem *x = a, *y = b;
+    if (x->position != y->position) return x->position < y->position ? -1 : 1;
+    return strcmp(x->name, y->name);
+}
+
+// Crea los directorios intermedios de path
+static bool make_parents(char* path) {
+    for (char *p = strchr(path + 1, '/'); p; p = strchr(p + 1, '/')) {
+        *p = '\0';
+        bool ok = mkdir(path, 0755) == 0 || errno == EEXIST;
+        *p = '/';
+        if (!ok) return false;
+    }
+    return true;
+}
+
+// Ruta bajo outdir de un archivo; falso si el nombre saldría de outdir
+static bool readall_dest(char* dest, size_t size, const char* outdir, const char* name) {
+    while (*name == '/') name++;
+    for (const char *c = name; c; c = strchr(c, '/')) {
+        if (*c == '/') c++;
+        if (c[0] == '.' && c[1] == '.' && (c[2] == '/' || c[2] == '\0')) return false;
+    }
+    int n = snprintf(dest, size, "%s/%s", outdir, name);
+    return *name && n > 0 && (size_t)n < size;
+}
+
+// --------------------------------------------------------
+// Exporta a outdir todos los archivos cuyo nombre empieza por
+// prefix (la ruta dentro de outdir es el nombre sin la barra
+// inicial). Los blobs se leen ordenados por su posición en
+// storage, así que storage.bin se recorre de principio a fin
+// en lugar de saltar de un sitio a otro en el orden de los nombres.
+// --------------------------------------------------------
+bool fs_read_all(FileSystem* fs, const char* prefix, const char* outdir) {
+    ReadAllCtx r = { prefix, strlen(prefix), NULL, 0, 0, true };
+    fs_scan(fs, prefix, collect_prefix, &r);
+    bool ok = r.ok;
+    if (!ok) printf("Error: sin memoria para readall\n");
+    qsort(r.items, r.n, sizeof(ReadAllItem), cmp_position);
+
+    double start = now_sec();
+    size_t done = 0;
+    uint64_t bytes = 0;
+    for (size_t i = 0; ok && i < r.n; ++i) {
+        char dest[1024];
+        FILE *out = NULL;
+        if (!readall_dest(dest, sizeof(dest), outdir, r.items[i].name)) {
+            printf("Error: nombre no exportable %s\n", r.items[i].name);
+        } else if (!make_parents(dest) || !(out = fopen(dest, "wb"))) {
+            printf("Error: no se pudo crear %s\n", dest);
+        } else {
+            bool written = fs_read_to(fs, r.items[i].name, 0, UINT64_MAX, out, false, true);
+            bytes += (uint64_t)ftell(out);
+            if (fclose(out) != 0) written = false;
+            if (written) done++;
+        }
+    }
+    for (size_t i = 0; i < r.n; ++i) free(r.items[i].name);
+    free(r.items);
+    printf("Exportados %zu de %zu archivos con prefijo '%s' a %s (%llu bytes, %.3f s)\n",
+           done, r.n, prefix, outdir, (unsigned long long)bytes, now_sec() - start);
+    return ok && done == r.n;
+}
+
 // --------------------------------------------------------
-// Lista todos los archivos almacenados (según el índice)
+// Lista todos los archivos almacenados (según el índice). Las
+// llaves del .idx salen recorriendo sus hojas en orden.
 // --------------------------------------------------------
 void fs_list(FileSystem* fs) {
+    ListCtx l = { NULL, 0, NULL, 0 };
     printf("Archivos en el sistema:\n");
-    btree_list(fs->index);
+    fs_scan(fs, NULL, print_entry, &l);
 }
 
 // --------------------------------------------------------
-// Función auxiliar para guardar metadatos del B-tree
+// Lista los archivos cuyo nombre empieza por prefix. Los cursores
+// se colocan en el prefijo y el recorrido para en la primera llave
+// que ya no lo tiene: O(log n + k) para k resultados.
 // --------------------------------------------------------
-static void save_btree_recursive(BTreeNode* node, FILE* meta, FILE* storage) {
-    if (!node) return;
-    int i;
-    for (i = 0; i < node->n; i++) {
-        if (!node->leaf) save_btree_recursive(node->C[i], meta, storage);
-
-        // Lee tamaño comprimido desde el storage
-        size_t comp_size = 0;
-        fseek(storage, node->positions[i], SEEK_SET);
-        fread(&comp_size, sizeof(size_t), 1, storage);
+void fs_list_prefix(FileSystem* fs, const char* prefix) {
+    ListCtx l = { prefix, strlen(prefix), NULL, 0 };
+    printf("Archivos con prefijo '%s':\n", prefix);
+    fs_scan(fs, prefix, print_entry, &l);
+    printf("%zu archivo(s)\n", l.count);
+}
 
-        // Crea entrada de metadatos
-        MetaEntry entry;
-        strncpy(entry.name, node->keys[i], sizeof(entry.name)-1);
-        entry.name[sizeof(entry.name)-1] = '\0';
-        entry.position = node->positions[i];
-        entry.comp_size = comp_size;
+// Lista los archivos con from <= nombre <= to (orden de strcmp)
+void fs_list_range(FileSystem* fs, const char* from, const char* to) {
+    ListCtx l = { NULL, 0, to, 0 };
+    printf("Archivos entre '%s' y '%s':\n", from, to);
+    if (strcmp(from, to) <= 0) fs_scan(fs, from, print_entry, &l);
+    printf("%zu archivo(s)\n", l.count);
+}
 
-        fwrite(&entry, sizeof(MetaEntry), 1, meta);
-    }
-    if (!node->leaf) save_btree_recursive(node->C[i], meta, storage);
+// --------------------------------------------------------
+// Tamaños de un blob leídos de storage.bin (solo hacen falta al
+// cargar un .meta, que no guarda el tamaño original)
+// --------------------------------------------------------
+static bool blob_sizes(FileSystem* fs, long pos, BTreeValue* v) {
+    uint8_t head[LZW_HEADER_SIZE];
+    size_t comp_size = 0;
+    uint64_t orig_size = 0;
+    v->position = pos;
+    v->hash[0] = v->hash[1] = 0;   // Los .meta no guardan el hash
+    if (!storage_read(&fs->storage, (uint64_t)pos, &comp_size, sizeof(size_t)) ||
+        comp_size < LZW_HEADER_SIZE ||
+        !storage_read(&fs->storage, (uint64_t)pos + sizeof(size_t), head, LZW_HEADER_SIZE) ||
+        !codec_orig_size(head, comp_size, &orig_size)) return false;
+    v->comp_size = comp_size;
+    v->orig_size = orig_size;
+    return true;
 }
 
 // --------------------------------------------------------
-// Guarda el índice en un archivo .meta
+// Segmentos y compactación
 // --------------------------------------------------------
-bool fs_save(FileSystem* fs, const char* save_name) {
-    char meta_file[512];
-    snprintf(meta_file, sizeof(meta_file), "%s.meta", save_name);
 
-    FILE *meta = fopen(meta_file, "wb");
-    if (!meta) {
-        printf("Error: no se pudo crear %s\n", meta_file);
-        return false;
+// Suelta la lista de blobs por copiar y la cola de segmentos
+static void compact_reset(FileSystem* fs) {
+    FsCompactor *c = &fs->compact;
+    for (size_t i = 0; i < c->nmoves; ++i) free(c->moves[i].key);
+    free(c->moves);
+    free(c->queue);
+    c->moves = NULL;
+    c->queue = NULL;
+    c->nmoves = c->next = c->nqueue = c->qdone = 0;
+    c->copied = 0;
+    c->moved_from = c->moved_to = -1;
+}
+
+// Borra los segmentos ya copiados, una vez guardado un índice que
+// no los usa
+static void remove_retired(FileSystem* fs) {
+    FsCompactor *c = &fs->compact;
+    // Un lector que empezó antes de guardar aún puede estar leyendo
+    // una posición antigua
+    if (c->nretired > 0) epoch_synchronize(&fs->epoch);
+    for (size_t i = 0; i < c->nretired; ++i) {
+        if (storage_remove_segment(&fs->storage, c->retired[i]))
+            printf("Borrado segmento %u\n", c->retired[i]);
     }
+    c->nretired = 0;
+}
 
-    // Escribimos un contador temporal (0) que luego corregiremos
-    uint32_t count = 0;
-    fwrite(&count, sizeof(uint32_t), 1, meta);
+// Escritura completa del .idx a partir del índice combinado. Los
+// tamaños vienen del propio índice: no se lee storage.bin.
+typedef struct {
+    FileSystem *fs;
+    PidxWriter *w;
+    PagedIndex *disk;    // Copia del .idx abierto a la que se aplican los cambios
+    bool ok;
+} SaveCtx;
 
-    FILE *storage = fopen(fs->storage_file, "rb");
-    if (!storage) {
-        fclose(meta);
-        printf("Error: no se pudo abrir almacenamiento\n");
+static bool save_entry(void* user, const char* key, const PidxValue* value) {
+    SaveCtx *s = user;
+    return s->ok = pidx_writer_add(s->w, key, value);
+}
+
+// Aplica al .idx abierto un cambio guardado en memoria
+static bool apply_entry(void* user, const char* key, const BTreeValue* value) {
+    SaveCtx *s = user;
+    if (value->position == FS_DELETED) return s->ok = pidx_remove(s->disk, key);
+    PidxValue v = disk_value(value);
+    return s->ok = pidx_put(s->disk, key, &v);
+}
+
+// --------------------------------------------------------
+// Guarda el índice en idx_file. Si ese .idx es el que está abierto
+// solo se escriben las páginas que cambian (*pages); si no, se
+// escribe entero de forma secuencial (*pages = -1) y pasa a ser el
+// abierto. El diario empieza de nuevo sobre el índice guardado.
+// --------------------------------------------------------
+static bool write_index(FileSystem* fs, const char* idx_file, long* pages) {
+    // Los blobs referenciados deben estar en disco antes que el índice
+    // (sincronizados si se van a borrar sus copias anteriores)
+    if (!sync_pending(fs)) return false;
+    if (fs->compact.nretired > 0 && !storage_sync(&fs->storage)) {
+        printf("Error: no se pudo volcar almacenamiento\n");
         return false;
     }
 
-    // Guardar las entradas recorriendo el B-tree
-    long start_pos = ftell(meta);
-    save_btree_recursive(fs->index, meta, storage);
+    SaveCtx ctx = { fs, NULL, NULL, true };
+    size_t changes = fs->index->count;
+    if (fs->disk && strcmp(fs->disk_path, idx_file) == 0 &&
+        (changes <= FS_IDX_REWRITE_MIN || changes <= fs->disk->h.count / 4)) {
+        // Los lectores siguen con el .idx abierto: los cambios se
+        // aplican a otro handle del mismo archivo, que las páginas que
+        // escribe no comparte con la versión publicada, y se cambia por
+        // el abierto junto con un B-tree vacío
+        ctx.disk = malloc(sizeof(PagedIndex));
+        if (ctx.disk && !pidx_open(ctx.disk, idx_file)) {
+            free(ctx.disk);
+            ctx.disk = NULL;
+        }
+        if (ctx.disk) btree_foreach(fs->index, apply_entry, &ctx);
+        size_t written = ctx.disk ? ctx.disk->dirty_count : 0;
+        if (ctx.disk && !ctx.ok) pidx_rollback(ctx.disk);
+        if (!ctx.disk || !ctx.ok || !pidx_commit(ctx.disk)) {
+            if (ctx.disk) {
+                pidx_close(ctx.disk);
+                free(ctx.disk);
+            }
+            printf("Error: no se pudo actualizar %s\n", idx_file);
+            return false;
+        }
+        BTree *old_index = fs->index;
+        PagedIndex *old_disk = fs->disk;
+        fs->disk = ctx.disk;
+        fs->index = index_create(fs);
+        view_switch(fs, old_index, old_disk);
+        *pages = (long)written;
+    } else {
+        ctx.w = pidx_writer_create(idx_file);
+        if (!ctx.w) {
+            printf("Error: no se pudo crear %s\n", idx_file);
+            return false;
+        }
+        index_foreach(fs, save_entry, &ctx);
+        if (!pidx_writer_finish(ctx.w) || !ctx.ok || !index_attach(fs, idx_file)) {
+            printf("Error: no se pudo escribir %s\n", idx_file);
+            return false;
+        }
+        *pages = -1;
+    }
 
-    // Calcular número real de archivos guardados
-    long end_pos = ftell(meta);
-    count = (end_pos - start_pos) / sizeof(MetaEntry);
+    // Si el diario no se puede reiniciar sigue valiendo: sus cambios
+    // se repiten sobre su base al arrancar
+    if (fs->journal.fd >= 0 && !journal_reset(&fs->journal, idx_file))
+        printf("Error: no se pudo reiniciar el diario\n");
+    fs->last_checkpoint = now_sec();
+    remove_retired(fs);
+    return true;
+}
 
-    // Reescribir contador al inicio
-    fseek(meta, 0, SEEK_SET);
-    fwrite(&count, sizeof(uint32_t), 1, meta);
+// Guardados explícitos y checkpoints cuentan como save
+static bool index_save(FileSystem* fs, const char* idx_file, long* pages) {
+    METRIC_START(t);
+    bool ok = write_index(fs, idx_file, pages);
+    METRIC_END(METRIC_SAVE, t, ok);
+    return ok;
+}
 
-    fclose(meta);
-    fclose(storage);
+// --------------------------------------------------------
+// Guarda el índice en <save_name>.idx
+// --------------------------------------------------------
+static bool save_to(FileSystem* fs, const char* save_name) {
+    char idx_file[512];
+    snprintf(idx_file, sizeof(idx_file), "%s.idx", save_name);
+    long pages;
+    if (!index_save(fs, idx_file, &pages)) return false;
+    if (pages >= 0)
+        printf("Guardado en %s (%llu archivos, %ld paginas escritas)\n", idx_file,
+               (unsigned long long)fs->disk->h.count, pages);
+    else
+        printf("Guardado en %s (%llu archivos)\n", idx_file, (unsigned long long)fs->disk->h.count);
+    return true;
+}
+
+bool fs_save(FileSystem* fs, const char* save_name) {
+    fs_lock(fs);
+    bool ok = save_to(fs, save_name);
+    fs_unlock(fs);
+    return ok;
+}
 
-    printf("Guardado en %s (%u archivos)\n", meta_file, count);
+// --------------------------------------------------------
+// Checkpoint: guarda el índice en <storage>.idx (de forma
+// incremental si ya es el abierto) y empieza un diario vacío
+// --------------------------------------------------------
+static bool checkpoint(FileSystem* fs) {
+    char idx_file[600];
+    snprintf(idx_file, sizeof(idx_file), "%s.idx", fs->storage_file);
+    uint64_t changes = fs->journal.records;
+    long pages;
+    if (!index_save(fs, idx_file, &pages)) return false;
+    printf("Checkpoint en %s (%llu cambios, %llu archivos)\n", idx_file,
+           (unsigned long long)changes, (unsigned long long)fs->disk->h.count);
     return true;
 }
 
+bool fs_checkpoint(FileSystem* fs) {
+    fs_lock(fs);
+    bool ok = checkpoint(fs);
+    fs_unlock(fs);
+    return ok;
+}
+
+// Por tamaño se espera al menos un segundo entre intentos, para
+// no repetir sin pausa un checkpoint que falla
+static bool checkpoint_due(const FileSystem* fs) {
+    const Journal *j = &fs->journal;
+    double since = now_sec() - fs->last_checkpoint;
+    // El B-tree compartido no reutiliza los bytes de las llaves
+    // borradas: el checkpoint lo cambia por uno vacío
+    if (since >= 1.0 && fs->index->arena.dead >= FS_CHECKPOINT_BYTES) return true;
+    if (j->fd < 0 || j->records == 0) return false;
+    return since >= FS_CHECKPOINT_SECS ||
+           (since >= 1.0 && j->size + j->buf_len - j->start >= FS_CHECKPOINT_BYTES);
+}
+
+static int tick(FileSystem* fs) {
+    journal_tick(fs);
+    if (checkpoint_due(fs) && !checkpoint(fs)) fs->last_checkpoint = now_sec();
+
+    // Siguiente plazo: volcado de lo pendiente o checkpoint por tiempo
+    const Journal *j = &fs->journal;
+    if (j->fd < 0 || j->records == 0) return -1;
+    double due = fs->last_checkpoint + FS_CHECKPOINT_SECS;
+    double commit = j->last_commit + fs->storage.commit_ms / 1000.0;
+    if (j->buf_len > 0 && commit < due) due = commit;
+    double wait = due - now_sec();
+    return wait > 0.0 ? (int)(wait * 1000.0) + 1 : 0;
+}
+
+int fs_tick(FileSystem* fs) {
+    fs_lock(fs);
+    int r = tick(fs);
+    fs_unlock(fs);
+    return r;
+}
+
+// Fuente de llaves para la carga masiva: lee MetaEntry del .meta
+typedef struct {
+    FileSystem *fs;
+    FILE *meta;
+    MetaEntry entry;
+} LoadCtx;
+
+static bool load_entry(void* user, const char** key, BTreeValue* value) {
+    LoadCtx *l = user;
+    if (fread(&l->entry, sizeof(MetaEntry), 1, l->meta) != 1) return false;
+    l->entry.name[sizeof(l->entry.name)-1] = '\0';
+    *key = l->entry.name;
+    return blob_sizes(l->fs, l->entry.position, value);
+}
+
+// Los bytes vivos, la tabla de dedup y la compactación en curso
+// eran del índice anterior; los segmentos ya copiados se conservan,
+// porque el índice cargado aún puede usarlos
+static void index_forget(FileSystem* fs) {
+    compact_reset(fs);
+    fs->compact.nretired = 0;
+    fs->blobs_valid = false;
+    dedup_clear(&fs->dedup);
+}
+
 // --------------------------------------------------------
-// Carga el índice desde un archivo .meta
+// Carga el índice desde <load_name>.idx o, si no existe, desde el
+// .meta de versiones anteriores. fill es la ocupación de los nodos
+// al cargar un .meta (1.0 = llenos; menos deja hueco para inserciones)
 // --------------------------------------------------------
-bool fs_load(FileSystem* fs, const char* load_name) {
-    char meta_file[512];
+static bool load_index(FileSystem* fs, const char* load_name, double fill) {
+    char idx_file[512], meta_file[512];
+    snprintf(idx_file, sizeof(idx_file), "%s.idx", load_name);
     snprintf(meta_file, sizeof(meta_file), "%s.meta", load_name);
+    if (access(idx_file, F_OK) != 0 && access(meta_file, F_OK) != 0) {
+        printf("Error: no existe %s ni %s\n", idx_file, meta_file);
+        return false;   // El índice actual sigue como estaba
+    }
 
+    // Preferir el .idx: se abre sin leerlo. Los cambios siguientes
+    // se anotan en un diario nuevo sobre él.
+    if (index_attach(fs, idx_file)) {
+        index_forget(fs);
+        printf("Abierto indice %s (%llu archivos)\n", idx_file, (unsigned long long)fs->disk->h.count);
+        if (fs->journal.fd >= 0 && !journal_reset(&fs->journal, idx_file))
+            printf("Error: no se pudo reiniciar el diario\n");
+        fs->last_checkpoint = now_sec();
+        return true;
+    }
+
+    // Sin .idx válido: el .meta. El árbol nuevo se construye aparte y
+    // solo se publica si se pudo leer.
     FILE *meta = fopen(meta_file, "rb");
     if (!meta) {
-        printf("Error: no se pudo abrir %s\n", meta_file);
-        return false;
+        printf("Error: no se pudo abrir %s ni %s\n", idx_file, meta_file);
+        return false;   // El índice actual sigue como estaba
     }
 
     uint32_t count = 0;
     fread(&count, sizeof(uint32_t), 1, meta);
+    long start = ftell(meta);
 
-    fs->index = btree_create();
+    // fs_save escribe las entradas en orden: construir el B-tree de
+    // abajo arriba en tiempo lineal
+    LoadCtx ctx = { fs, meta, { { 0 }, 0, 0 } };
+    BTree *index = btree_bulk_load(BTREE_T, count, fill, load_entry, &ctx);
 
-    // Insertar cada entrada en el B-tree
-    for (uint32_t i = 0; i < count; i++) {
-        MetaEntry entry;
-        fread(&entry, sizeof(MetaEntry), 1, meta);
-        btree_insert(&fs->index, entry.name, entry.position);
+    // Si no vienen ordenadas, insertar cada entrada en el B-tree
+    if (!index) {
+        index = btree_create(BTREE_T);
+        fseek(meta, start, SEEK_SET);
+        for (uint32_t i = 0; index && i < count; i++) {
+            MetaEntry entry;
+            if (fread(&entry, sizeof(MetaEntry), 1, meta) != 1) break;
+            entry.name[sizeof(entry.name)-1] = '\0';
+            BTreeValue value;
+            if (blob_sizes(fs, entry.position, &value)) btree_insert(index, entry.name, &value);
+        }
     }
 
     fclose(meta);
+    if (!index) {
+        printf("Error: no se pudo cargar %s\n", meta_file);
+        return false;
+    }
+    btree_share(index, retire_node, fs);
+    BTree *old_index = fs->index;
+    PagedIndex *old_disk = fs->disk;
+    fs->index = index;
+    fs->disk = NULL;
+    view_switch(fs, old_index, old_disk);
+    index_forget(fs);
 
     printf("Cargado metadata desde %s (%u archivos)\n", meta_file, count);
+
+    // El .meta no se anota en el diario: un checkpoint lo hace
+    // persistente
+    checkpoint(fs);
+    return true;
+}
+
+bool fs_load(FileSystem* fs, const char* load_name, double fill) {
+    METRIC_START(t);
+    fs_lock(fs);
+    bool ok = load_index(fs, load_name, fill);
+    // El índice cargado puede apuntar a otros blobs. La caché se vacía
+    // después de publicarlo para que no entre nada leído del anterior.
+    fs_cache_invalidate(fs, NULL);
+    fs_unlock(fs);
+    METRIC_END(METRIC_LOAD, t, ok);
+    return ok;
+}
+
+// --------------------------------------------------------
+// Bytes vivos por segmento y tabla de dedup: se construyen
+// recorriendo el índice la primera vez que hacen falta y después
+// se mantienen al crear y borrar archivos
+// --------------------------------------------------------
+static bool count_blob(void* user, const char* key, const PidxValue* value) {
+    FileSystem *fs = user;
+    (void)key;
+    BTreeValue v = { (long)value->position, value->comp_size, value->orig_size,
+                     { value->hash[0], value->hash[1] } };
+    blob_ref(fs, &v);
     return true;
 }
+
+static void blob_scan(FileSystem* fs) {
+    if (fs->blobs_valid) return;
+    storage_clear_live(&fs->storage);
+    dedup_clear(&fs->dedup);
+    fs->blobs_valid = true;
+    index_foreach(fs, count_blob, fs);
+}
+
+static bool segment_retired(const FileSystem* fs, uint32_t seg) {
+    for (size_t i = 0; i < fs->compact.nretired; ++i)
+        if (fs->compact.retired[i] == seg) return true;
+    return false;
+}
+
+// --------------------------------------------------------
+// Muestra el tamaño y los bytes vivos de cada segmento
+// --------------------------------------------------------
+static void show_segments(FileSystem* fs) {
+    blob_scan(fs);
+    Storage *st = &fs->storage;
+    printf("Segmentos de %s:\n", st->path);
+    for (uint32_t i = 0; i < st->nsegs; ++i) {
+        const StorageSegment *g = &st->segs[i];
+        if (g->fd < 0) continue;
+        printf("  %6u %14llu bytes, vivos %14lld (%5.1f%%)%s\n", i,
+               (unsigned long long)g->size, (long long)g->live,
+               g->size ? 100.0 * (double)g->live / (double)g->size : 0.0,
+               i == st->active ? "  activo" : segment_retired(fs, i) ? "  copiado" : "");
+    }
+    printf("Total %llu bytes\n", (unsigned long long)storage_total(st));
+    printf("Dedup: %zu blobs con hash, %llu archivos compartidos (%llu bytes sin escribir)\n",
+           fs->dedup.count, (unsigned long long)fs->dedup.hits,
+           (unsigned long long)fs->dedup.saved);
+}
+
+void fs_segments(FileSystem* fs) {
+    fs_lock(fs);
+    show_segments(fs);
+    fs_unlock(fs);
+}
+
+// Recoge las llaves cuyo blob está en un segmento de la cola
+typedef struct {
+    FileSystem *fs;
+    size_t cap;
+    bool ok;
+} MoveCtx;
+
+static int cmp_seg(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static int cmp_move(const void* a, const void* b) {
+    long x = ((const FsMove*)a)->position, y = ((const FsMove*)b)->position;
+    return x < y ? -1 : x > y;
+}
+
+static bool collect_move(void* user, const char* key, const PidxValue* value) {
+    MoveCtx *m = user;
+    FsCompactor *c = &m->fs->compact;
+    uint32_t seg = STORAGE_SEG(value->position);
+    if (!bsearch(&seg, c->queue, c->nqueue, sizeof(uint32_t), cmp_seg)) return true;
+    if (c->nmoves == m->cap) {
+        m->cap = m->cap ? m->cap * 2 : 1024;
+        FsMove *grown = realloc(c->moves, sizeof(FsMove) * m->cap);
+        if (!grown) return m->ok = false;
+        c->moves = grown;
+    }
+    char *copy = strdup(key);
+    if (!copy) return m->ok = false;
+    c->moves[c->nmoves].key = copy;
+    c->moves[c->nmoves].position = (long)value->position;
+    c->nmoves++;
+    return true;
+}
+
+// --------------------------------------------------------
+// Elige los segmentos (salvo el activo) con al menos la fracción
+// dead de bytes muertos y prepara la copia de sus blobs vivos. La
+// copia avanza con fs_compact_step.
+// --------------------------------------------------------
+static bool compact_start(FileSystem* fs, double dead) {
+    FsCompactor *c = &fs->compact;
+    if (compact_pending(fs)) {
+        printf("Compactacion en curso\n");
+        return false;
+    }
+    compact_reset(fs);
+    blob_scan(fs);
+
+    Storage *st = &fs->storage;
+    uint64_t reclaim = 0;
+    c->queue = malloc(sizeof(uint32_t) * st->nsegs);
+    if (!c->queue) return false;
+    for (uint32_t i = 0; i < st->nsegs; ++i) {
+        const StorageSegment *g = &st->segs[i];
+        if (g->fd < 0 || i == st->active || g->size == 0 || segment_retired(fs, i)) continue;
+        uint64_t live = g->live > 0 ? (uint64_t)g->live : 0;
+        if ((double)(g->size - live) < dead * (double)g->size) continue;
+        c->queue[c->nqueue++] = i;
+        reclaim += g->size - live;
+    }
+    if (c->nqueue == 0) {
+        compact_reset(fs);
+        printf("Nada que compactar\n");
+        return true;
+    }
+
+    // Blobs vivos de esos segmentos, ordenados por posición para
+    // leerlos de forma secuencial
+    MoveCtx m = { fs, 0, true };
+    index_foreach(fs, collect_move, &m);
+    if (!m.ok) {
+        compact_reset(fs);
+        printf("Error: sin memoria para compactar\n");
+        return false;
+    }
+    qsort(c->moves, c->nmoves, sizeof(FsMove), cmp_move);
+    printf("Compactando %zu segmentos (%zu archivos vivos, %llu bytes a recuperar)\n",
+           c->nqueue, c->nmoves, (unsigned long long)reclaim);
+    return true;
+}
+
+bool fs_compact_start(FileSystem* fs, double dead) {
+    fs_lock(fs);
+    bool ok = compact_start(fs, dead);
+    fs_unlock(fs);
+    return ok;
+}
+
+static bool compact_pending(const FileSystem* fs) {
+    return fs->compact.qdone < fs->compact.nqueue;
+}
+
+bool fs_compact_pending(FileSystem* fs) {
+    fs_lock(fs);
+    bool ok = compact_pending(fs);
+    fs_unlock(fs);
+    return ok;
+}
+
+// Da por copiados los segmentos de la cola anteriores al del
+// siguiente blob (los blobs están ordenados por posición)
+static void compact_retire(FileSystem* fs) {
+    FsCompactor *c = &fs->compact;
+    while (c->qdone < c->nqueue &&
+           (c->next == c->nmoves || STORAGE_SEG(c->moves[c->next].position) > c->queue[c->qdone])) {
+        uint32_t seg = c->queue[c->qdone++];
+        uint32_t *grown = realloc(c->retired, sizeof(uint32_t) * (c->nretired + 1));
+        if (!grown) continue;
+        c->retired = grown;
+        c->retired[c->nretired++] = seg;
+        printf("Segmento %u compactado (%llu bytes copiados); se borra al guardar\n",
+               seg, (unsigned long long)c->copied);
+        c->copied = 0;
+    }
+}
+
+// Copia el blob de value al final del segmento activo y apunta la
+// llave (y la tabla de dedup) a la copia
+static bool compact_move(FileSystem* fs, const char* key, const BTreeValue* value, uint8_t* chunk) {
+    Storage *st = &fs->storage;
+    BTreeValue moved = *value;
+    moved.position = (long)storage_tell(st);
+    uint64_t len = (uint64_t)blob_bytes(value);
+    bool ok = true;
+    for (uint64_t off = 0; ok && off < len; ) {
+        size_t n = len - off < FS_CHUNK ? (size_t)(len - off) : FS_CHUNK;
+        const uint8_t *p = storage_view(st, (uint64_t)value->position + off, n);
+        if (!p) {
+            ok = storage_read(st, (uint64_t)value->position + off, chunk, n);
+            p = chunk;
+        }
+        ok = ok && storage_append(st, p, n);
+        off += n;
+    }
+    if (ok) ok = storage_blob_done(st) && btree_insert(fs->index, key, &moved);
+    if (!ok) return false;
+    journal_put(fs, key, &moved);
+    storage_add_live(st, (uint64_t)value->position, -(int64_t)len);
+    storage_add_live(st, (uint64_t)moved.position, (int64_t)len);
+    DedupEntry *e = dedup_hash_known(value->hash) ? dedup_find(&fs->dedup, value->hash) : NULL;
+    if (e && e->position == value->position) e->position = moved.position;
+    fs->compact.moved_from = value->position;
+    fs->compact.moved_to = moved.position;
+    return true;
+}
+
+// --------------------------------------------------------
+// Avanza la compactación copiando como mucho budget bytes (al menos
+// un blob). Un segmento cuyos blobs ya están copiados se borra en
+// el siguiente save, cuando el índice guardado deja de usarlo.
+// --------------------------------------------------------
+static void compact_step(FileSystem* fs, size_t budget) {
+    FsCompactor *c = &fs->compact;
+    if (!compact_pending(fs)) return;
+    uint8_t *chunk = malloc(FS_CHUNK);
+    if (!chunk) return;
+
+    uint64_t done = 0;
+    // Las llaves que comparten el último blob copiado se apuntan a
+    // la copia en el mismo paso, aunque se haya agotado budget
+    while (c->next < c->nmoves &&
+           (done < budget || c->moves[c->next].position == c->moved_from)) {
+        compact_retire(fs);
+        const FsMove *m = &c->moves[c->next];
+        BTreeValue cur;
+        // El archivo puede haberse borrado o reescrito desde que se
+        // eligió el segmento: su blob ya está muerto
+        bool live = index_get(fs, m->key, &cur) && cur.position == m->position;
+        if (live && cur.position == c->moved_from) {
+            // Comparte el blob que se acaba de copiar (están juntos
+            // por estar ordenados por posición)
+            cur.position = c->moved_to;
+            if (!btree_insert(fs->index, m->key, &cur)) {
+                printf("Error: no se pudo indexar %s; compactacion cancelada\n", m->key);
+                compact_reset(fs);
+                free(chunk);
+                return;
+            }
+            journal_put(fs, m->key, &cur);
+        } else if (live) {
+            if (!compact_move(fs, m->key, &cur, chunk)) {
+                printf("Error: no se pudo copiar %s; compactacion cancelada\n", m->key);
+                compact_reset(fs);
+                free(chunk);
+                return;
+            }
+            done += (uint64_t)blob_bytes(&cur);
+            c->copied += (uint64_t)blob_bytes(&cur);
+        }
+        c->next++;
+    }
+    free(chunk);
+    journal_tick(fs);
+    compact_retire(fs);
+    if (!compact_pending(fs)) compact_reset(fs);
+}
+
+void fs_compact_step(FileSystem* fs, size_t budget) {
+    fs_lock(fs);
+    compact_step(fs, budget);
+    fs_unlock(fs);
+}
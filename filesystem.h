@@ -1,13 +1,132 @@
 #ifndef FILESYSTEM_H
 #define FILESYSTEM_H
 #include "tree.h"
+#include "threadpool.h"
+#include "storage.h"
+#include "cache.h"
+#include "pagedindex.h"
+#include "dedup.h"
+#include "journal.h"
+#include "epoch.h"
+#include <pthread.h>
 #include <stdbool.h>
-typedef struct { BTreeNode* index; char storage_file[512]; } FileSystem;
+#include <stdint.h>
+#include <stdio.h>
+
+// Ocupación de los nodos del índice al cargar un .meta
+#define FS_LOAD_FILL 1.0
+
+// Compactación: se eligen los segmentos con al menos esta fracción
+// de bytes muertos y sus blobs vivos se copian al segmento activo en
+// pasos de FS_COMPACT_SLICE bytes, entre órdenes y mientras la
+// terminal está inactiva (con FS_COMPACT_PAUSE_MS entre pasos), para
+// que las lecturas no esperen más que un paso
+#define FS_COMPACT_DEAD 0.5
+#define FS_COMPACT_SLICE (1024 * 1024)
+#define FS_COMPACT_PAUSE_MS 10
+
+// Checkpoint (índice en <storage>.idx y diario nuevo) cuando el
+// diario o las llaves borradas del B-tree superan FS_CHECKPOINT_BYTES
+// o, si el diario tiene algo, cada FS_CHECKPOINT_SECS segundos; se
+// hace entre órdenes
+#define FS_CHECKPOINT_BYTES (4 * 1024 * 1024)
+#define FS_CHECKPOINT_SECS 60
+
+typedef struct {
+    char *key;
+    long position;           // Posición del blob al elegir el segmento
+} FsMove;
+
+typedef struct {
+    uint32_t *queue;         // Segmentos elegidos, en orden
+    size_t nqueue, qdone;
+    FsMove *moves;           // Blobs vivos de esos segmentos, por posición
+    size_t nmoves, next;
+    uint64_t copied;         // Bytes copiados del segmento en curso
+    long moved_from, moved_to; // Último blob copiado (otras llaves lo comparten)
+    uint32_t *retired;       // Segmentos ya copiados: se borran al guardar
+    size_t nretired;
+} FsCompactor;
+
+// Índice que ven los lectores: los cambios en memoria y el .idx
+// sobre el que están, que siempre se cambian juntos
+typedef struct {
+    BTree *index;
+    PagedIndex *disk;
+} FsView;
+
+// -------------------------------------------------------
+// Hilos: las lecturas (fs_read*, fs_export, fs_stat, fs_scan,
+// fs_list*, fs_read_all) se pueden hacer desde cualquier hilo a la
+// vez y no toman el cerrojo del escritor: recorren el B-tree (que se
+// cambia copiando los nodos del camino) y el .idx dentro de una
+// sección de época y leen storage.bin con pread o mmap. El resto de
+// operaciones se serializan con lock. Lo que se desengancha del
+// índice se libera cuando ya no queda ningún lector que lo vea.
+// -------------------------------------------------------
+typedef struct {
+    BTree* index;            // Cambios posteriores al .idx (o todo el índice)
+    char storage_file[512];
+    ThreadPool* pool;
+    Storage storage;
+    ContentCache cache;
+    pthread_mutex_t cache_lock;
+    uint64_t cache_gen;      // Sube al invalidar: una lectura anterior no entra
+    PagedIndex *disk;        // Índice en disco abierto (NULL si no hay)
+    char disk_path[512];
+    FsView views[2];         // La publicada y la siguiente
+    FsView *view;
+    Epoch epoch;
+    pthread_mutex_t lock;    // Escritor (recursivo)
+    bool blobs_valid;        // Bytes vivos y tabla de dedup calculados
+    DedupTable dedup;
+    Journal journal;         // Cambios desde el último checkpoint
+    double last_checkpoint;
+    int codec;               // Códec de los archivos nuevos (CODEC_AUTO = elegir)
+    bool ingest_uring;       // fs_create_many lee con io_uring si lo hay
+    FsCompactor compact;
+} FileSystem;
 void fs_init(FileSystem* fs, const char* storage_name);
+void fs_close(FileSystem* fs);
+bool fs_sync(FileSystem* fs);
+void fs_set_read_mode(FileSystem* fs, bool use_mmap);
+bool fs_set_ingest(FileSystem* fs, bool use_uring);
+void fs_set_cache(FileSystem* fs, size_t budget);
+void fs_cache_stats(FileSystem* fs);
+void fs_set_commit(FileSystem* fs, size_t bytes, unsigned ms, bool sync);
+bool fs_set_codec(FileSystem* fs, const char* name);
+// Métricas en texto o, con json, como un objeto JSON en ese FILE
+void fs_stats(FileSystem* fs, FILE* json);
+void fs_stats_reset(FileSystem* fs);
 bool fs_create(FileSystem* fs, const char* filename);
+int fs_create_many(FileSystem* fs, const char** paths, int n);
 bool fs_read(FileSystem* fs, const char* filename);
+bool fs_read_range(FileSystem* fs, const char* filename, uint64_t offset, uint64_t length);
+bool fs_export(FileSystem* fs, const char* filename, const char* dest);
+// Rango de un archivo hacia out, sin cabecera (para salida de máquina)
+bool fs_read_into(FileSystem* fs, const char* filename, uint64_t offset, uint64_t length, FILE* out);
+// Posición y tamaños de un archivo; falso si no existe
+bool fs_stat(FileSystem* fs, const char* filename, PidxValue* out);
+// Exporta a outdir los archivos con ese prefijo, leyéndolos en el
+// orden en que están en storage; falso si alguno falla
+bool fs_read_all(FileSystem* fs, const char* prefix, const char* outdir);
 bool fs_delete(FileSystem* fs, const char* filename);
 void fs_list(FileSystem* fs);
+void fs_list_prefix(FileSystem* fs, const char* prefix);
+// Rango cerrado: from <= nombre <= to
+void fs_list_range(FileSystem* fs, const char* from, const char* to);
+// Recorre en orden los archivos desde el primer nombre >= from (NULL
+// = desde el principio) hasta el final o hasta que fn devuelva falso
+typedef bool (*fs_visit)(void* user, const char* name, const PidxValue* value);
+void fs_scan(FileSystem* fs, const char* from, fs_visit fn, void* user);
 bool fs_save(FileSystem* fs, const char* save_name);
-bool fs_load(FileSystem* fs, const char* load_name);
+bool fs_load(FileSystem* fs, const char* load_name, double fill);
+void fs_segments(FileSystem* fs);
+bool fs_compact_start(FileSystem* fs, double dead);
+bool fs_compact_pending(FileSystem* fs);
+void fs_compact_step(FileSystem* fs, size_t budget);
+bool fs_checkpoint(FileSystem* fs);
+// Trabajo pendiente entre órdenes (volcado del diario, checkpoint);
+// devuelve los ms hasta el siguiente o -1 si no hay
+int fs_tick(FileSystem* fs);
 #endif
@@ -0,0 +1,588 @@
+#include <stdio.h>      // Para printf, fopen
+#include <stdlib.h>     // Para malloc, free, atof
+#include <string.h>     // Para memcpy, strcmp
+#include <stdint.h>
+#include <time.h>       // Para clock_gettime
+#include <fcntl.h>      // Para open
+#include <dirent.h>     // Para borrar el directorio de trabajo
+#include <sys/stat.h>   // Para mkdir
+#include <unistd.h>     // Para dup, dup2, chdir
+#include <pthread.h>    // Para los lectores concurrentes
+#include "compression.h"
+#include "filesystem.h"
+#include "tree.h"
+
+// -------------------------------------------------------
+// Batería de medidas del sistema de archivos completo, para seguir
+// regresiones entre versiones. Genera corpus deterministas en un
+// directorio temporal:
+//  - texto: muchos archivos de texto pequeños
+//  - logs: pocos logs grandes (contenedores de bloques)
+//  - binario: bytes aleatorios (incompresibles)
+//  - duplicados: muchos archivos con pocos contenidos distintos
+// y mide:
+//  - lzw_compress / lzw_decompress en MB/s sobre cada corpus
+//  - latencia p50/p99/máx de fs_create y fs_read (sin caché)
+//  - lecturas/s con 1, 2, 4 y 8 hilos lectores mientras otro hilo
+//    reescribe archivos
+//  - archivos/s de fs_create_many (sin comprimir) leyendo con
+//    io_uring y con hilos
+//  - btree_insert / btree_search en ops/s de 10^3 a 10^6 llaves
+//  - fs_save completo, fs_save incremental y fs_load
+// Los resultados se muestran y se escriben en un CSV con columnas
+// prueba,corpus,metrica,valor,unidad (una fila por medida), que se
+// puede comparar entre ejecuciones.
+//
+// Uso: fsbench [resultados.csv] [escala]
+// La escala multiplica la cantidad de archivos de cada corpus.
+// -------------------------------------------------------
+
+// Reloj de pared en segundos
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Generador pseudoaleatorio determinista (xorshift64)
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+static uint64_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// --------------------------------------------------------
+// Resultados: una línea en pantalla y una fila en el CSV
+// --------------------------------------------------------
+static FILE *results;
+
+static void report(const char* test, const char* corpus, const char* metric, double value, const char* unit) {
+    printf("%-10s %-11s %-22s %14.3f %s\n", test, corpus, metric, value, unit);
+    if (results) fprintf(results, "%s,%s,%s,%.6f,%s\n", test, corpus, metric, value, unit);
+}
+
+// Las funciones fs_* informan por stdout: mientras se mide se
+// manda a /dev/null
+static int saved_stdout = -1;
+
+static void quiet_begin(void) {
+    fflush(stdout);
+    saved_stdout = dup(STDOUT_FILENO);
+    int fd = open("/dev/null", O_WRONLY);
+    if (fd >= 0) {
+        dup2(fd, STDOUT_FILENO);
+        close(fd);
+    }
+}
+
+static void quiet_end(void) {
+    fflush(stdout);
+    if (saved_stdout >= 0) {
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(saved_stdout);
+        saved_stdout = -1;
+    }
+}
+
+static int cmp_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Percentil q (0..1) por rango más cercano; ordena v
+static double percentile(double* v, size_t n, double q) {
+    if (n == 0) return 0.0;
+    qsort(v, n, sizeof(double), cmp_double);
+    size_t k = (size_t)(q * (double)n + 0.999999);
+    return v[k > 0 ? k - 1 : 0];
+}
+
+// Latencias en microsegundos: p50, p99 y máximo
+static void report_latency(const char* test, const char* corpus, double* lat, size_t n) {
+    double max = 0.0;
+    for (size_t i = 0; i < n; ++i) if (lat[i] > max) max = lat[i];
+    report(test, corpus, "p50", percentile(lat, n, 0.50) * 1e6, "us");
+    report(test, corpus, "p99", percentile(lat, n, 0.99) * 1e6, "us");
+    report(test, corpus, "max", max * 1e6, "us");
+}
+
+// --------------------------------------------------------
+// Corpus
+// --------------------------------------------------------
+typedef struct {
+    const char *name;
+    size_t nfiles;
+    char **paths;        // corpus/<name>/NNNNN
+    size_t bytes;        // Total de bytes de los archivos
+} Corpus;
+
+static const char *words[] = {
+    "archivo", "sistema", "arbol", "nodo", "clave", "indice", "bloque",
+    "datos", "comprimir", "leer", "escribir", "diccionario", "codigo",
+    "prefijo", "memoria", "almacenamiento", "the", "of", "and", "file"
+};
+#define NWORDS (sizeof(words) / sizeof(words[0]))
+
+static void fill_text(uint8_t* buf, size_t size) {
+    size_t pos = 0;
+    while (pos < size) {
+        const char *w = words[rng_next() % NWORDS];
+        for (size_t i = 0; w[i] && pos < size; ++i) buf[pos++] = (uint8_t)w[i];
+        if (pos < size) buf[pos++] = (rng_next() % 12 == 0) ? '\n' : ' ';
+    }
+}
+
+// Líneas de log con marca de tiempo, nivel, hilo y campos variables
+static void fill_log(uint8_t* buf, size_t size) {
+    static const char *levels[] = { "INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR" };
+    static const char *paths[] = { "/api/v1/items", "/api/v1/users", "/login", "/static/app.js", "/health" };
+    size_t pos = 0;
+    uint64_t ms = 1700000000000ull;
+    char line[256];
+    while (pos < size) {
+        ms += rng_next() % 50;
+        int n = snprintf(line, sizeof(line),
+                         "%llu.%03llu %s [worker-%u] req=%08llx path=%s/%u status=%u ms=%u\n",
+                         (unsigned long long)(ms / 1000), (unsigned long long)(ms % 1000),
+                         levels[rng_next() % 6], (unsigned)(rng_next() % 16),
+                         (unsigned long long)(rng_next() & 0xffffffffull), paths[rng_next() % 5],
+                         (unsigned)(rng_next() % 1000), rng_next() % 20 ? 200u : 500u,
+                         (unsigned)(rng_next() % 300));
+        size_t k = (size_t)n < size - pos ? (size_t)n : size - pos;
+        memcpy(buf + pos, line, k);
+        pos += k;
+    }
+}
+
+static void fill_binary(uint8_t* buf, size_t size) {
+    for (size_t i = 0; i < size; ++i) buf[i] = (uint8_t)rng_next();
+}
+
+static bool write_file(const char* path, const uint8_t* data, size_t len) {
+    FILE *f = fopen(path, "wb");
+    if (!f) return false;
+    bool ok = fwrite(data, 1, len, f) == len;
+    return fclose(f) == 0 && ok;
+}
+
+static char* corpus_path(const char* name, size_t i) {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "corpus/%s/%05zu", name, i);
+    char *p = malloc(strlen(buf) + 1);
+    strcpy(p, buf);
+    return p;
+}
+
+// Crea nfiles archivos de entre min y max bytes con fill. Con
+// distinct > 0 solo hay distinct contenidos distintos.
+static bool make_corpus(Corpus* c, const char* name, size_t nfiles, size_t min, size_t max,
+                        void (*fill)(uint8_t*, size_t), size_t distinct) {
+    char dir[128];
+    snprintf(dir, sizeof(dir), "corpus/%s", name);
+    mkdir(dir, 0755);
+    c->name = name;
+    c->nfiles = nfiles;
+    c->paths = calloc(nfiles, sizeof(char*));
+    c->bytes = 0;
+    uint8_t *buf = malloc(max);
+
+    uint8_t **variants = distinct ? calloc(distinct, sizeof(uint8_t*)) : NULL;
+    size_t *vsize = distinct ? calloc(distinct, sizeof(size_t)) : NULL;
+    for (size_t v = 0; v < distinct; ++v) {
+        vsize[v] = min + rng_next() % (max - min + 1);
+        variants[v] = malloc(vsize[v]);
+        fill(variants[v], vsize[v]);
+    }
+
+    bool ok = c->paths && buf;
+    for (size_t i = 0; ok && i < nfiles; ++i) {
+        c->paths[i] = corpus_path(name, i);
+        const uint8_t *data = buf;
+        size_t len;
+        if (distinct) {
+            size_t v = rng_next() % distinct;
+            data = variants[v];
+            len = vsize[v];
+        } else {
+            len = min + rng_next() % (max - min + 1);
+            fill(buf, len);
+        }
+        ok = write_file(c->paths[i], data, len);
+        c->bytes += len;
+    }
+    for (size_t v = 0; v < distinct; ++v) free(variants[v]);
+    free(variants);
+    free(vsize);
+    free(buf);
+    return ok;
+}
+
+static void free_corpus(Corpus* c) {
+    for (size_t i = 0; i < c->nfiles; ++i) free(c->paths[i]);
+    free(c->paths);
+}
+
+// Contenido de los primeros archivos de un corpus (hasta limit bytes)
+static uint8_t* corpus_sample(const Corpus* c, size_t limit, size_t* len) {
+    uint8_t *buf = malloc(limit);
+    *len = 0;
+    for (size_t i = 0; buf && i < c->nfiles && *len < limit; ++i) {
+        FILE *f = fopen(c->paths[i], "rb");
+        if (!f) continue;
+        *len += fread(buf + *len, 1, limit - *len, f);
+        fclose(f);
+    }
+    return buf;
+}
+
+// --------------------------------------------------------
+// Compresor: MB/s de lzw_compress y lzw_decompress sobre una
+// muestra de cada corpus
+// --------------------------------------------------------
+static void bench_lzw(const Corpus* c) {
+    size_t len = 0;
+    uint8_t *data = corpus_sample(c, 16 * 1024 * 1024, &len);
+    if (!data || len == 0) {
+        free(data);
+        return;
+    }
+    size_t comp_len = 0, dec_len = 0;
+    double t0 = now_sec();
+    uint8_t *comp = lzw_compress(data, len, &comp_len);
+    double t_c = now_sec() - t0;
+    t0 = now_sec();
+    uint8_t *dec = comp ? lzw_decompress(comp, comp_len, &dec_len) : NULL;
+    double t_d = now_sec() - t0;
+    bool ok = dec && dec_len == len && memcmp(dec, data, len) == 0;
+
+    double mb = (double)len / (1024.0 * 1024.0);
+    report("lzw", c->name, "comprimir", mb / t_c, "MB/s");
+    report("lzw", c->name, "descomprimir", mb / t_d, "MB/s");
+    report("lzw", c->name, "ratio", comp ? (double)comp_len / (double)len : 0.0, "");
+    if (!ok) printf("lzw        %-11s ERROR: la descompresion no coincide\n", c->name);
+    free(dec);
+    free(comp);
+    free(data);
+}
+
+// --------------------------------------------------------
+// Latencia de fs_create de cada archivo de un corpus
+// --------------------------------------------------------
+static void bench_create(FileSystem* fs, const Corpus* c) {
+    double *lat = malloc(sizeof(double) * c->nfiles);
+    size_t failed = 0;
+    quiet_begin();
+    double start = now_sec();
+    for (size_t i = 0; i < c->nfiles; ++i) {
+        double t0 = now_sec();
+        failed += !fs_create(fs, c->paths[i]);
+        lat[i] = now_sec() - t0;
+    }
+    fs_sync(fs);
+    double total = now_sec() - start;
+    quiet_end();
+
+    report_latency("create", c->name, lat, c->nfiles);
+    report("create", c->name, "total", (double)c->bytes / (1024.0 * 1024.0) / total, "MB/s");
+    if (failed) printf("create     %-11s ERROR: %zu archivos sin guardar\n", c->name, failed);
+    free(lat);
+}
+
+// --------------------------------------------------------
+// Latencia de fs_read de cada archivo (caché desactivada: cada
+// lectura descomprime)
+// --------------------------------------------------------
+static void bench_read(FileSystem* fs, const Corpus* c) {
+    double *lat = malloc(sizeof(double) * c->nfiles);
+    size_t failed = 0;
+    quiet_begin();
+    double start = now_sec();
+    for (size_t i = 0; i < c->nfiles; ++i) {
+        double t0 = now_sec();
+        failed += !fs_read(fs, c->paths[i]);
+        lat[i] = now_sec() - t0;
+    }
+    double total = now_sec() - start;
+    quiet_end();
+
+    report_latency("read", c->name, lat, c->nfiles);
+    report("read", c->name, "total", (double)c->bytes / (1024.0 * 1024.0) / total, "MB/s");
+    if (failed) printf("read       %-11s ERROR: %zu archivos sin leer\n", c->name, failed);
+    free(lat);
+}
+
+// --------------------------------------------------------
+// Lectores concurrentes: n hilos leen archivos al azar de un corpus
+// (con pread y sin caché) durante FSBENCH_CONC_SECS segundos
+// mientras un escritor los reescribe uno tras otro. Si las lecturas
+// no se serializan, las lecturas/s crecen con n.
+// --------------------------------------------------------
+#define FSBENCH_CONC_SECS 1.0
+#define FSBENCH_CONC_MAX 8
+
+typedef struct {
+    FileSystem *fs;
+    const Corpus *c;
+    FILE *sink;          // /dev/null propio: sin competir por el cerrojo del FILE
+    int *stop;
+    uint64_t seed;
+    uint64_t done, failed;
+} ConcWorker;
+
+static void* conc_reader(void* arg) {
+    ConcWorker *w = arg;
+    uint64_t x = w->seed;
+    w->sink = fopen("/dev/null", "wb");
+    if (!w->sink) return NULL;
+    while (!__atomic_load_n(w->stop, __ATOMIC_RELAXED)) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        w->failed += !fs_read_into(w->fs, w->c->paths[x % w->c->nfiles], 0, UINT64_MAX, w->sink);
+        w->done++;
+    }
+    fclose(w->sink);
+    return NULL;
+}
+
+static void* conc_writer(void* arg) {
+    ConcWorker *w = arg;
+    for (size_t i = 0; !__atomic_load_n(w->stop, __ATOMIC_RELAXED); i = (i + 1) % w->c->nfiles) {
+        w->failed += !fs_create(w->fs, w->c->paths[i]);
+        w->done++;
+    }
+    return NULL;
+}
+
+static void bench_concurrent(FileSystem* fs, const Corpus* c) {
+    quiet_begin();
+    fs_set_read_mode(fs, false);
+    quiet_end();
+    for (int n = 1; n <= FSBENCH_CONC_MAX; n *= 2) {
+        ConcWorker readers[FSBENCH_CONC_MAX], writer = { fs, c, NULL, NULL, 0, 0, 0 };
+        pthread_t threads[FSBENCH_CONC_MAX], wthread;
+        int stop = 0, started = 0;
+        writer.stop = &stop;
+        quiet_begin();
+        bool wok = pthread_create(&wthread, NULL, conc_writer, &writer) == 0;
+        double t0 = now_sec();
+        for (int i = 0; i < n; ++i) {
+            readers[i] = (ConcWorker){ fs, c, NULL, &stop, rng_next() | 1, 0, 0 };
+            if (pthread_create(&threads[i], NULL, conc_reader, &readers[i]) != 0) break;
+            started++;
+        }
+        while (now_sec() - t0 < FSBENCH_CONC_SECS) usleep(10000);
+        __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+        uint64_t reads = 0, failed = 0;
+        for (int i = 0; i < started; ++i) {
+            pthread_join(threads[i], NULL);
+            reads += readers[i].done;
+            failed += readers[i].failed;
+        }
+        double elapsed = now_sec() - t0;
+        if (wok) pthread_join(wthread, NULL);
+        quiet_end();
+
+        char label[32];
+        snprintf(label, sizeof(label), "%d", n);
+        report("concurr", label, "lecturas", (double)reads / elapsed, "ops/s");
+        report("concurr", label, "escrituras", (double)writer.done / elapsed, "ops/s");
+        if (failed || writer.failed)
+            printf("concurr    %-11s ERROR: %llu lecturas y %llu escrituras fallidas\n", label,
+                   (unsigned long long)failed, (unsigned long long)writer.failed);
+    }
+    quiet_begin();
+    fs_set_read_mode(fs, true);
+    quiet_end();
+}
+
+// --------------------------------------------------------
+// B-tree en memoria: inserción y búsqueda de n llaves parecidas a
+// rutas, en orden aleatorio
+// --------------------------------------------------------
+static void bench_btree(size_t n) {
+    char **keys = malloc(sizeof(char*) * n);
+    for (size_t i = 0; i < n; ++i) {
+        char buf[96];
+        snprintf(buf, sizeof(buf), "/home/usuario/datos/dir%03u/archivo_%08zu.txt",
+                 (unsigned)(rng_next() % 500), i);
+        keys[i] = malloc(strlen(buf) + 1);
+        strcpy(keys[i], buf);
+    }
+    for (size_t i = n; i > 1; --i) {
+        size_t j = rng_next() % i;
+        char *tmp = keys[i - 1];
+        keys[i - 1] = keys[j];
+        keys[j] = tmp;
+    }
+
+    BTree *tree = btree_create(BTREE_T);
+    double t0 = now_sec();
+    for (size_t i = 0; i < n; ++i) {
+        BTreeValue v = { (long)i, 0, 0, { 0, 0 } };
+        btree_insert(tree, keys[i], &v);
+    }
+    double t_ins = now_sec() - t0;
+    size_t found = 0;
+    t0 = now_sec();
+    for (size_t i = n; i-- > 0;) found += btree_search(tree, keys[i]) != -1;
+    double t_find = now_sec() - t0;
+
+    char label[32];
+    snprintf(label, sizeof(label), "%zu", n);
+    report("btree", label, "insertar", (double)n / t_ins, "ops/s");
+    report("btree", label, "buscar", (double)n / t_find, "ops/s");
+    if (found != n || tree->count != n) printf("btree      %-11s ERROR: faltan llaves\n", label);
+
+    btree_destroy(tree);
+    for (size_t i = 0; i < n; ++i) free(keys[i]);
+    free(keys);
+}
+
+// --------------------------------------------------------
+// Ingesta de un corpus entero con fs_create_many, leyendo con
+// io_uring (si lo hay) y con hilos; cada una en un almacenamiento
+// nuevo para que la deduplicación no se salte archivos. Sin
+// comprimir, para medir la lectura y la escritura y no el códec.
+// --------------------------------------------------------
+static void bench_ingest(const Corpus* c) {
+    for (int uring = 1; uring >= 0; --uring) {
+        const char *mode = uring ? "uring" : "hilos";
+        char name[64];
+        snprintf(name, sizeof(name), "ingest_%s.bin", mode);
+        FileSystem fs;
+        quiet_begin();
+        fs_init(&fs, name);
+        fs_set_codec(&fs, "guardado");
+        bool ok = fs_set_ingest(&fs, uring);
+        double t0 = now_sec();
+        int count = ok ? fs_create_many(&fs, (const char**)c->paths, (int)c->nfiles) : 0;
+        double total = now_sec() - t0;
+        fs_close(&fs);
+        quiet_end();
+
+        if (!ok) continue;  // Sin io_uring
+        report("ingest", c->name, mode, (double)c->nfiles / total, "archivos/s");
+        if ((size_t)count != c->nfiles)
+            printf("ingest     %-11s ERROR: %zu archivos sin guardar\n", c->name, c->nfiles - (size_t)count);
+    }
+}
+
+// --------------------------------------------------------
+// Guardar y cargar el índice con todos los corpus: save completo,
+// save incremental tras cambiar el 1% de las llaves y load
+// --------------------------------------------------------
+static void bench_save_load(FileSystem* fs, const Corpus* corpora, int ncorpora) {
+    size_t total = 0;
+    for (int c = 0; c < ncorpora; ++c) total += corpora[c].nfiles;
+
+    quiet_begin();
+    double t0 = now_sec();
+    bool ok = fs_save(fs, "bench");
+    double t_full = now_sec() - t0;
+
+    // Reescribir uno de cada cien archivos (mismo contenido: no
+    // crece storage, solo cambia el índice)
+    size_t changed = 0;
+    for (int c = 0; c < ncorpora; ++c)
+        for (size_t i = 0; i < corpora[c].nfiles; i += 100, ++changed)
+            fs_create(fs, corpora[c].paths[i]);
+    t0 = now_sec();
+    ok = fs_save(fs, "bench") && ok;
+    double t_inc = now_sec() - t0;
+
+    // Con su propio almacenamiento: fs_load reinicia el diario, y el
+    // de storage.bin lo sigue usando fs
+    FileSystem loaded;
+    fs_init(&loaded, "load.bin");
+    t0 = now_sec();
+    ok = fs_load(&loaded, "bench", FS_LOAD_FILL) && ok;
+    double t_load = now_sec() - t0;
+    fs_close(&loaded);
+    quiet_end();
+
+    char label[32];
+    snprintf(label, sizeof(label), "%zu", total);
+    report("save", label, "completo", t_full * 1e3, "ms");
+    snprintf(label, sizeof(label), "%zu", changed);
+    report("save", label, "incremental", t_inc * 1e3, "ms");
+    snprintf(label, sizeof(label), "%zu", total);
+    report("load", label, "idx", t_load * 1e3, "ms");
+    if (!ok) printf("save       ERROR: no se pudo guardar o cargar el indice\n");
+}
+
+// Borra path y, si es un directorio, todo lo que contiene
+static bool remove_tree(const char* path) {
+    struct stat st;
+    if (stat(path, &st) != 0) return false;
+    if (S_ISDIR(st.st_mode)) {
+        DIR *dir = opendir(path);
+        struct dirent *entry;
+        while (dir && (entry = readdir(dir)) != NULL) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+            char child[1024];
+            snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+            remove_tree(child);
+        }
+        if (dir) closedir(dir);
+    }
+    return remove(path) == 0;
+}
+
+int main(int argc, char **argv) {
+    const char *out_path = argc > 1 ? argv[1] : "fsbench.csv";
+    double scale = argc > 2 ? atof(argv[2]) : 1.0;
+    if (scale <= 0.0) scale = 1.0;
+
+    results = fopen(out_path, "w");
+    if (!results) {
+        printf("Error: no se pudo crear %s\n", out_path);
+        return 1;
+    }
+    fprintf(results, "prueba,corpus,metrica,valor,unidad\n");
+
+    // Directorio de trabajo temporal (se borra al terminar)
+    char cwd[512], work[] = "/tmp/fsbench.XXXXXX";
+    if (!getcwd(cwd, sizeof(cwd)) || !mkdtemp(work) || chdir(work) != 0) {
+        printf("Error: no se pudo crear el directorio de trabajo\n");
+        fclose(results);
+        return 1;
+    }
+    mkdir("corpus", 0755);
+
+    Corpus corpora[4];
+    size_t nsmall = (size_t)(2000 * scale) + 1, nlogs = (size_t)(4 * scale) + 1;
+    size_t nbin = (size_t)(200 * scale) + 1, ndup = (size_t)(2000 * scale) + 1;
+    bool ok = make_corpus(&corpora[0], "texto", nsmall, 512, 8 * 1024, fill_text, 0) &&
+              make_corpus(&corpora[1], "logs", nlogs, 4 * 1024 * 1024, 8 * 1024 * 1024, fill_log, 0) &&
+              make_corpus(&corpora[2], "binario", nbin, 16 * 1024, 128 * 1024, fill_binary, 0) &&
+              make_corpus(&corpora[3], "duplicados", ndup, 4 * 1024, 16 * 1024, fill_text, ndup / 50 + 1);
+    if (!ok) printf("Error: no se pudo generar el corpus en %s\n", work);
+
+    for (int c = 0; ok && c < 4; ++c) bench_lzw(&corpora[c]);
+
+    FileSystem fs;
+    quiet_begin();
+    fs_init(&fs, "storage.bin");
+    fs_set_cache(&fs, 0);
+    quiet_end();
+    for (int c = 0; ok && c < 4; ++c) bench_create(&fs, &corpora[c]);
+    for (int c = 0; ok && c < 4; ++c) bench_read(&fs, &corpora[c]);
+    if (ok) bench_concurrent(&fs, &corpora[0]);
+    if (ok) bench_ingest(&corpora[0]);
+    if (ok) bench_save_load(&fs, corpora, 4);
+    quiet_begin();
+    fs_close(&fs);
+    quiet_end();
+
+    for (size_t n = 1000; ok && n <= 1000000; n *= 10) bench_btree(n);
+
+    for (int c = 0; ok && c < 4; ++c) free_corpus(&corpora[c]);
+    if (chdir(cwd) != 0 || !remove_tree(work))
+        printf("Aviso: no se pudo borrar %s\n", work);
+    fclose(results);
+    printf("Resultados en %s\n", out_path);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,203 @@
+#include "journal.h"
+#include "dedup.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define REC_HEADER 8         // [u32 len][u32 suma]
+
+// Reloj de pared en segundos
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint32_t rd32(const uint8_t* p) { uint32_t v; memcpy(&v, p, 4); return v; }
+static void wr32(uint8_t* p, uint32_t v) { memcpy(p, &v, 4); }
+
+static uint32_t rec_sum(const uint8_t* payload, size_t len) {
+    uint64_t h[2];
+    dedup_hash(payload, len, h);
+    return (uint32_t)h[0];
+}
+
+// pwrite completo (reintenta escrituras parciales)
+static bool write_all(int fd, const uint8_t* data, size_t len, uint64_t pos) {
+    while (len > 0) {
+        ssize_t n = pwrite(fd, data, len, (off_t)pos);
+        if (n <= 0) return false;
+        data += n;
+        len -= (size_t)n;
+        pos += (uint64_t)n;
+    }
+    return true;
+}
+
+// Lee la cabecera del diario abierto en j->fd
+static bool read_header(Journal* j) {
+    uint8_t h[10];
+    if (pread(j->fd, h, sizeof(h), 0) != (ssize_t)sizeof(h)) return false;
+    if (memcmp(h, JOURNAL_MAGIC, 4) != 0 || rd32(h + 4) != JOURNAL_VERSION) return false;
+    uint16_t len;
+    memcpy(&len, h + 8, 2);
+    if (len >= sizeof(j->base)) return false;
+    if (pread(j->fd, j->base, len, sizeof(h)) != (ssize_t)len) return false;
+    j->base[len] = '\0';
+    j->start = sizeof(h) + len;
+    return true;
+}
+
+bool journal_open(Journal* j, const char* path) {
+    memset(j, 0, sizeof(*j));
+    j->fd = -1;
+    snprintf(j->path, sizeof(j->path), "%s", path);
+    j->buf = malloc(JOURNAL_BUF_SIZE);
+    if (!j->buf) return false;
+    j->buf_cap = JOURNAL_BUF_SIZE;
+    j->last_commit = now_sec();
+
+    // Sin diario: se empieza uno vacío
+    if (access(path, F_OK) != 0) return journal_reset(j, "");
+
+    j->fd = open(path, O_RDWR);
+    off_t end = j->fd >= 0 ? lseek(j->fd, 0, SEEK_END) : -1;
+    if (end < 0 || !read_header(j)) {
+        journal_close(j);
+        return false;
+    }
+    j->size = (uint64_t)end;
+    return true;
+}
+
+void journal_close(Journal* j) {
+    if (j->fd >= 0) close(j->fd);
+    j->fd = -1;
+    free(j->buf);
+    j->buf = NULL;
+    j->buf_len = j->buf_cap = 0;
+}
+
+uint64_t journal_replay(Journal* j, journal_visit fn, void* user) {
+    if (j->fd < 0 || j->size <= j->start) return 0;
+    size_t len = (size_t)(j->size - j->start);
+    uint8_t *data = malloc(len);
+    if (!data) return 0;
+    if (pread(j->fd, data, len, (off_t)j->start) != (ssize_t)len) {
+        free(data);
+        return 0;
+    }
+
+    size_t off = 0;
+    uint64_t applied = 0;
+    while (off + REC_HEADER <= len) {
+        const uint8_t *rec = data + off;
+        uint32_t plen = rd32(rec);
+        if (plen < 2 || plen > len - off - REC_HEADER) break;
+        const uint8_t *p = rec + REC_HEADER;
+        if (rec_sum(p, plen) != rd32(rec + 4)) break;
+        JournalOp op = (JournalOp)p[0];
+        size_t klen = p[1];
+        size_t vlen = op == JOURNAL_PUT ? sizeof(PidxValue) : 0;
+        if ((op != JOURNAL_PUT && op != JOURNAL_DEL) || 2 + klen + vlen != plen) break;
+
+        char key[PIDX_KEY_MAX + 1];
+        memcpy(key, p + 2, klen);
+        key[klen] = '\0';
+        PidxValue value;
+        if (vlen) memcpy(&value, p + 2 + klen, vlen);
+        fn(user, op, key, vlen ? &value : NULL);
+        applied++;
+        off += REC_HEADER + plen;
+    }
+    free(data);
+
+    // Cola de un corte a medias: los registros nuevos van detrás
+    // del último válido
+    if (off < len && ftruncate(j->fd, (off_t)(j->start + off)) == 0)
+        j->size = j->start + off;
+    j->records = applied;
+    return applied;
+}
+
+bool journal_append(Journal* j, JournalOp op, const char* key, const PidxValue* value) {
+    size_t klen = strlen(key);
+    if (j->fd < 0 || klen > PIDX_KEY_MAX) return false;
+    size_t vlen = op == JOURNAL_PUT ? sizeof(PidxValue) : 0;
+    size_t plen = 2 + klen + vlen;
+    if (j->buf_len + REC_HEADER + plen > j->buf_cap) {
+        size_t cap = j->buf_cap * 2;
+        while (j->buf_len + REC_HEADER + plen > cap) cap *= 2;
+        uint8_t *grown = realloc(j->buf, cap);
+        if (!grown) return false;
+        j->buf = grown;
+        j->buf_cap = cap;
+    }
+    uint8_t *rec = j->buf + j->buf_len;
+    uint8_t *p = rec + REC_HEADER;
+    p[0] = (uint8_t)op;
+    p[1] = (uint8_t)klen;
+    memcpy(p + 2, key, klen);
+    if (vlen) memcpy(p + 2 + klen, value, vlen);
+    wr32(rec, (uint32_t)plen);
+    wr32(rec + 4, rec_sum(p, plen));
+    j->buf_len += REC_HEADER + plen;
+    j->records++;
+    return true;
+}
+
+bool journal_commit(Journal* j, bool sync) {
+    if (j->fd < 0) return false;
+    bool ok = write_all(j->fd, j->buf, j->buf_len, j->size);
+    if (ok) {
+        j->size += j->buf_len;
+        j->buf_len = 0;
+    }
+#ifndef _WIN32
+    if (ok && sync) ok = fdatasync(j->fd) == 0;
+#endif
+    j->last_commit = now_sec();
+    return ok;
+}
+
+bool journal_due(const Journal* j, size_t bytes, unsigned ms) {
+    if (j->buf_len == 0) return false;
+    return j->buf_len >= bytes || (now_sec() - j->last_commit) * 1000.0 >= (double)ms;
+}
+
+// --------------------------------------------------------
+// El diario nuevo se escribe en <path>.tmp y reemplaza al anterior
+// con rename: un corte deja uno de los dos completo
+// --------------------------------------------------------
+bool journal_reset(Journal* j, const char* base) {
+    size_t blen = strlen(base);
+    if (blen >= sizeof(j->base)) return false;
+    char tmp[600];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", j->path);
+
+    uint8_t h[10];
+    uint16_t len = (uint16_t)blen;
+    memcpy(h, JOURNAL_MAGIC, 4);
+    wr32(h + 4, JOURNAL_VERSION);
+    memcpy(h + 8, &len, 2);
+
+    int fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    bool ok = write_all(fd, h, sizeof(h), 0) && write_all(fd, (const uint8_t*)base, blen, sizeof(h)) &&
+              fsync(fd) == 0 && rename(tmp, j->path) == 0;
+    if (!ok) {
+        close(fd);
+        remove(tmp);
+        return false;
+    }
+    if (j->fd >= 0) close(j->fd);
+    j->fd = fd;
+    memcpy(j->base, base, blen + 1);
+    j->start = j->size = sizeof(h) + blen;
+    j->records = 0;
+    j->buf_len = 0;
+    return true;
+}
@@ -0,0 +1,69 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+#include "pagedindex.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// -------------------------------------------------------
+// Diario de metadatos (<storage>.jnl): cada alta, cambio o borrado
+// del índice añade un registro al final, así que persistir una
+// operación cuesta lo mismo tenga el catálogo el tamaño que tenga.
+// Los registros se acumulan en memoria y se escriben juntos (group
+// commit, con fdatasync opcional).
+//
+// Formato (little-endian):
+//   Cabecera: [magic "FSJN"][u32 versión][u16 len][índice base]
+//   Registros: [u32 len][u32 suma][u8 op][u8 len][llave][PidxValue]
+//   (el valor solo en JOURNAL_PUT; la suma son los 32 bits bajos
+//   del hash de dedup del resto del registro)
+// El índice base es el .idx sobre el que se aplican los registros
+// (vacío si se parte de un índice vacío). Al arrancar se abre la
+// base y se repiten los registros; un registro incompleto o con la
+// suma mal (un corte a medias) termina el diario y se descarta.
+// Un checkpoint guarda el índice y empieza un diario nuevo.
+// -------------------------------------------------------
+#define JOURNAL_MAGIC "FSJN"
+#define JOURNAL_VERSION 1
+#define JOURNAL_BUF_SIZE (64 * 1024)   // Capacidad inicial del buffer
+
+typedef enum {
+    JOURNAL_PUT = 1,         // La llave apunta a un blob
+    JOURNAL_DEL = 2          // La llave deja de existir
+} JournalOp;
+
+typedef struct {
+    int fd;                  // -1 si no hay diario
+    char path[512];
+    char base[512];          // Índice base ("" = vacío)
+    uint64_t start;          // Primer registro (tras la cabecera)
+    uint64_t size;           // Bytes del archivo (sin lo pendiente)
+    uint64_t records;        // Registros desde la cabecera
+    uint8_t *buf;            // Registros pendientes de escribir
+    size_t buf_len;
+    size_t buf_cap;
+    double last_commit;      // Momento del último volcado
+} Journal;
+
+// Abre el diario de path (o crea uno vacío sin base)
+bool journal_open(Journal* j, const char* path);
+void journal_close(Journal* j);  // Sin volcar lo pendiente
+
+// Recorre los registros del archivo en orden y descarta lo que
+// haya tras el último válido; devuelve cuántos se aplicaron
+typedef void (*journal_visit)(void* user, JournalOp op, const char* key, const PidxValue* value);
+uint64_t journal_replay(Journal* j, journal_visit fn, void* user);
+
+// Añade un registro en memoria (value solo en JOURNAL_PUT)
+bool journal_append(Journal* j, JournalOp op, const char* key, const PidxValue* value);
+
+// Escribe lo pendiente (y hace fdatasync si sync)
+bool journal_commit(Journal* j, bool sync);
+
+// Hay registros pendientes y se superó alguno de los umbrales
+bool journal_due(const Journal* j, size_t bytes, unsigned ms);
+
+// Sustituye el diario por uno vacío sobre base (de forma atómica)
+bool journal_reset(Journal* j, const char* base);
+
+#endif // JOURNAL_H
@@ -2,31 +2,49 @@
 #include <string.h>     // Para funciones de cadenas como strcmp, strncmp, strcspn
 #include <stdlib.h>     // Para funciones generales como malloc, free
 #include <dirent.h>     // Para trabajar con directorios (opendir, readdir, closedir)
-#include <time.h>       // Para medir tiempos de ejecución con clock()
+#include <time.h>       // Para medir tiempos de ejecución con clock_gettime()
 #include <sys/stat.h>   // Para obtener información de archivos (stat)
+#include <poll.h>       // Para esperar órdenes sin bloquear la compactación
+#include <unistd.h>     // Para isatty
 #include "filesystem.h"
 
+// Reloj de pared en segundos (clock() mide tiempo de CPU y con
+// varios hilos no refleja el tiempo real)
+static double wall_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int cmp_paths(const void* a, const void* b) {
+    return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
 // -------------------------------------------------------
 //  - fs: puntero al sistema de archivos en memoria
 //  - folder: ruta del directorio de donde cargar los archivos
+// Los archivos se ordenan por nombre para que el resultado sea
+// siempre el mismo y se ingieren en paralelo con fs_create_many.
 // -------------------------------------------------------
-void load_all_files(FileSystem* fs, const char* folder) {
+bool load_all_files(FileSystem* fs, const char* folder) {
     DIR* dir;
     struct dirent* entry;
-    clock_t start, end;
+    double start, end;
     int count = 0;
 
     // Abrir el directorio
     dir = opendir(folder);
     if (!dir) {
         printf("Error abrir dir %s\n", folder);
-        return;
+        return false;
     }
 
     printf("Cargando desde %s\n", folder);
-    start = clock(); // Inicia el conteo de tiempo
+    start = wall_time(); // Inicia el conteo de tiempo
 
     // Recorrer todos los archivos dentro del directorio
+    char** paths = NULL;
+    int n = 0, cap = 0;
     while ((entry = readdir(dir)) != NULL) {
         // Ignorar "." y ".." (entradas especiales)
         if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name,"..") == 0) continue;
@@ -35,76 +53,388 @@ void load_all_files(FileSystem* fs, const char* folder) {
         char filepath[1024];
         snprintf(filepath, sizeof(filepath), "%s/%s", folder, entry->d_name);
 
-        // Crear el archivo dentro del sistema de archivos virtual
-        if (fs_create(fs, filepath)) count++;
-    }
+        // Solo archivos regulares: readdir ya da el tipo casi siempre
+        // y solo hace falta stat si no lo sabe o es un enlace
+        if (entry->d_type != DT_REG) {
+            struct stat fst;
+            if (entry->d_type != DT_UNKNOWN && entry->d_type != DT_LNK) continue;
+            if (stat(filepath, &fst) != 0 || !S_ISREG(fst.st_mode)) continue;
+        }
 
-    end = clock();
+        if (n == cap) {
+            cap = cap ? cap * 2 : 256;
+            char** grown = realloc(paths, sizeof(char*) * cap);
+            if (!grown) break;
+            paths = grown;
+        }
+        paths[n++] = strdup(filepath);
+    }
     closedir(dir); // Cerrar directorio
 
+    // Crear los archivos dentro del sistema de archivos virtual
+    qsort(paths, n, sizeof(char*), cmp_paths);
+    count = fs_create_many(fs, (const char**)paths, n);
+
+    end = wall_time();
+    for (int i = 0; i < n; ++i) free(paths[i]);
+    free(paths);
+
     // Calcular el tiempo total de carga
-    double total = (double)(end - start) / CLOCKS_PER_SEC;
+    double total = end - start;
 
-    // Mostrar tamaño actual del archivo de almacenamiento
-    struct stat st;
-    if (stat(fs->storage_file, &st) == 0)
-        printf("Almacenamiento %lld bytes\n", (long long)st.st_size);
+    // Mostrar tamaño actual del almacenamiento (todos los segmentos)
+    printf("Almacenamiento %llu bytes\n", (unsigned long long)storage_total(&fs->storage));
 
     // Mostrar resumen
     printf("Cargado %d archivos en %.3f s\n", count, total);
+    return count == n;
+}
+
+// -------------------------------------------------------
+// Separa "<archivo> <offset> <longitud>". Devuelve 0 si los dos
+// últimos argumentos no son números (se trata todo como nombre).
+// -------------------------------------------------------
+static int parse_range(const char* args, char* name, size_t name_size,
+                       unsigned long long* offset, unsigned long long* length) {
+    const char* sp2 = strrchr(args, ' ');
+    if (!sp2 || sp2 == args) return 0;
+    const char* sp1 = sp2 - 1;
+    while (sp1 > args && *sp1 != ' ') sp1--;
+    if (sp1 == args) return 0;
+
+    char* end;
+    *offset = strtoull(sp1 + 1, &end, 10);
+    if (end != sp2 || sp1[1] == ' ') return 0;
+    *length = strtoull(sp2 + 1, &end, 10);
+    if (*end != 0 || sp2[1] == 0) return 0;
+
+    size_t len = (size_t)(sp1 - args);
+    if (len >= name_size) return 0;
+    memcpy(name, args, len);
+    name[len] = 0;
+    return 1;
+}
+
+// -------------------------------------------------------
+// Trabajo en segundo plano: antes de cada orden se vuelca el
+// diario si toca, se hace el checkpoint si toca y se da un paso de
+// compactación. Si la entrada es una terminal se sigue mientras no
+// llega ninguna orden: la compactación con pausas de
+// FS_COMPACT_PAUSE_MS y el diario y los checkpoints al vencer su
+// plazo (con la entrada redirigida, stdin puede tener ya órdenes en
+// su buffer y poll no las vería). Una orden nunca espera más que
+// un paso.
+// -------------------------------------------------------
+static void work_while_idle(FileSystem* fs, bool interactive) {
+    fflush(stdout);
+    int wait = fs_tick(fs);
+    if (fs_compact_pending(fs)) fs_compact_step(fs, FS_COMPACT_SLICE);
+    struct pollfd in = { STDIN_FILENO, POLLIN, 0 };
+    while (interactive && (fs_compact_pending(fs) || wait >= 0)) {
+        int ms = wait;
+        if (fs_compact_pending(fs) && (ms < 0 || ms > FS_COMPACT_PAUSE_MS))
+            ms = FS_COMPACT_PAUSE_MS;
+        if (poll(&in, 1, ms) != 0) break;
+        wait = fs_tick(fs);
+        if (fs_compact_pending(fs)) fs_compact_step(fs, FS_COMPACT_SLICE);
+        fflush(stdout);
+    }
+}
+
+// -------------------------------------------------------
+// Salida de máquina (-q): los mensajes del sistema de archivos se
+// descartan y cada orden responde con una sola línea en la salida
+// real, "ok" o "error". Las que devuelven datos ponen detrás cuántos
+// (líneas de list, bytes de read, una línea de stats json) y los
+// escriben a continuación.
+// -------------------------------------------------------
+typedef struct {
+    const char *prefix;      // Solo nombres con este prefijo
+    size_t prefix_len;
+    const char *to;          // Solo nombres <= to
+    char **names;
+    size_t n, cap;
+    bool ok;
+} Listing;
+
+static bool collect_name(void* user, const char* name, const PidxValue* value) {
+    Listing *l = user;
+    (void)value;
+    if (l->prefix && strncmp(name, l->prefix, l->prefix_len) != 0) return false;
+    if (l->to && strcmp(name, l->to) > 0) return false;
+    if (l->n == l->cap) {
+        size_t cap = l->cap ? l->cap * 2 : 256;
+        char **grown = realloc(l->names, sizeof(char*) * cap);
+        if (!grown) return l->ok = false;
+        l->names = grown;
+        l->cap = cap;
+    }
+    if (!(l->names[l->n] = strdup(name))) return l->ok = false;
+    l->n++;
+    return true;
+}
+
+// list [<prefijo> | <desde> <hasta>] como una línea por nombre
+static bool quiet_list(FileSystem* fs, FILE* res, const char* from, const char* to, bool* sent) {
+    Listing l = { to ? NULL : from, from && !to ? strlen(from) : 0, to, NULL, 0, 0, true };
+    if (!to || strcmp(from, to) <= 0) fs_scan(fs, from, collect_name, &l);
+    if (l.ok) fprintf(res, "ok %zu\n", l.n);
+    *sent = l.ok;
+    for (size_t i = 0; i < l.n; ++i) {
+        if (l.ok) fprintf(res, "%s\n", l.names[i]);
+        free(l.names[i]);
+    }
+    free(l.names);
+    return l.ok;
+}
+
+// read <archivo> [<offset> <longitud>] con los bytes tal cual. Si
+// falla después de anunciar los bytes, *sent queda verdadero: la
+// respuesta está incompleta y ya no se puede seguir
+static bool quiet_read(FileSystem* fs, FILE* res, const char* name, uint64_t offset, uint64_t length,
+                       bool* sent) {
+    PidxValue v;
+    if (!fs_stat(fs, name, &v)) return false;
+    if (offset > v.orig_size) offset = v.orig_size;
+    if (length > v.orig_size - offset) length = v.orig_size - offset;
+    fprintf(res, "ok %llu\n", (unsigned long long)length);
+    fflush(res);
+    *sent = true;
+    return fs_read_into(fs, name, offset, length, res);
 }
 
-int main() {
+static void usage(const char* prog) {
+    fprintf(stderr, "Uso: %s [-b] [-q] [archivo de ordenes]\n"
+                    "  -b  por lotes: sin prompt, ordenes de stdin o del archivo\n"
+                    "  -q  salida de maquina (implica -b): una linea ok/error por orden\n", prog);
+}
+
+int main(int argc, char** argv) {
     FileSystem fs;          // Estructura del sistema de archivos
     char command[512];      // Buffer para leer comandos del usuario
+    bool batch = false, quiet = false;
+    const char* script = NULL;
+    int failures = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-b") == 0) batch = true;
+        else if (strcmp(argv[i], "-q") == 0) batch = quiet = true;
+        else if (argv[i][0] != '-' && !script) script = argv[i];
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    // Con un archivo de órdenes también se trabaja por lotes
+    FILE* in = stdin;
+    if (script) {
+        batch = true;
+        in = fopen(script, "r");
+        if (!in) {
+            fprintf(stderr, "Error: no se pudo abrir %s\n", script);
+            return 2;
+        }
+    }
+    bool interactive = !batch && isatty(STDIN_FILENO);
+
+    // En modo -q las respuestas van a la salida real y stdout, donde
+    // escribe el sistema de archivos, a /dev/null
+    FILE* res = stdout;
+    if (quiet) {
+        fflush(stdout);
+        int fd = dup(STDOUT_FILENO);
+        res = fd >= 0 ? fdopen(fd, "w") : NULL;
+        if (!res || !freopen("/dev/null", "w", stdout)) {
+            fprintf(stderr, "Error: no se pudo preparar la salida\n");
+            return 2;
+        }
+        setvbuf(res, NULL, _IOFBF, 1 << 16);
+    }
 
     // Inicializa el sistema de archivos usando "storage.bin" como almacenamiento
     fs_init(&fs, "storage.bin");
 
     // Bucle principal de comandos
     while (1) {
-        printf("> "); // Prompt de comando
+        if (!batch) printf("> "); // Prompt de comando
+        work_while_idle(&fs, interactive);
 
         // Leer línea de entrada
-        if (!fgets(command, sizeof(command), stdin)) break;
+        if (!fgets(command, sizeof(command), in)) break;
 
         // Eliminar salto de línea al final
-        command[strcspn(command, "\n")] = 0;
+        command[strcspn(command, "\r\n")] = 0;
+        if (batch && (command[0] == 0 || command[0] == '#')) continue; // Líneas vacías y comentarios
+
+        // Resultado de la orden; data = ya respondió con sus datos
+        bool ok = true, data = false;
 
         // ----------------- INTERPRETACIÓN DE COMANDOS -----------------
 
         if (strncmp(command, "init", 4) == 0) {
+            fs_close(&fs);
             fs_init(&fs, "storage.bin"); // Reinicia el sistema de archivos
         }
         else if (strncmp(command, "create ", 7) == 0) {
-            fs_create(&fs, command + 7); // Crea archivo con la ruta indicada
+            ok = fs_create(&fs, command + 7); // Crea archivo con la ruta indicada
         }
         else if (strncmp(command, "read ", 5) == 0) {
-            fs_read(&fs, command + 5);   // Lee archivo desde el sistema de archivos
+            // read <archivo> [<offset> <longitud>]
+            char name[512];
+            unsigned long long offset, length;
+            bool range = parse_range(command + 5, name, sizeof(name), &offset, &length);
+            if (quiet)
+                ok = quiet_read(&fs, res, range ? name : command + 5,
+                                range ? offset : 0, range ? length : UINT64_MAX, &data);
+            else if (range)
+                ok = fs_read_range(&fs, name, offset, length); // Lee solo el rango indicado
+            else
+                ok = fs_read(&fs, command + 5);   // Lee archivo desde el sistema de archivos
+        }
+        else if (strncmp(command, "readall ", 8) == 0) {
+            // readall <prefijo> <carpeta>: exporta en el orden de storage
+            char* dest = strrchr(command + 8, ' ');
+            if (!dest) {
+                printf("Uso: readall <prefijo> <carpeta>\n");
+                ok = false;
+            } else {
+                *dest = 0;
+                ok = fs_read_all(&fs, command + 8, dest + 1);
+            }
+        }
+        else if (strncmp(command, "export ", 7) == 0) {
+            // export <archivo> <destino>: el destino es la última palabra
+            char* dest = strrchr(command + 7, ' ');
+            if (!dest) {
+                printf("Uso: export <archivo> <destino>\n");
+                ok = false;
+            } else {
+                *dest = 0;
+                ok = fs_export(&fs, command + 7, dest + 1); // Escribe el archivo descomprimido en disco
+            }
         }
         else if (strncmp(command, "delete ", 7) == 0) {
-            fs_delete(&fs, command + 7); // Elimina archivo
+            ok = fs_delete(&fs, command + 7); // Elimina archivo
+        }
+        else if (strcmp(command, "list") == 0) {
+            if (quiet) ok = quiet_list(&fs, res, NULL, NULL, &data);
+            else fs_list(&fs);           // Lista archivos almacenados
         }
-        else if (strncmp(command, "list", 4) == 0) {
-            fs_list(&fs);                // Lista archivos almacenados
+        else if (strncmp(command, "list ", 5) == 0) {
+            // list <prefijo> | list <desde> <hasta> (rango cerrado)
+            char* to = strrchr(command + 5, ' ');
+            if (to) *to++ = 0;
+            if (quiet) ok = quiet_list(&fs, res, command + 5, to, &data);
+            else if (to) fs_list_range(&fs, command + 5, to);
+            else fs_list_prefix(&fs, command + 5);
         }
         else if (strncmp(command, "save ", 5) == 0) {
-            fs_save(&fs, command + 5);   // Guarda archivo del sistema virtual al sistema real
+            ok = fs_save(&fs, command + 5);   // Guarda archivo del sistema virtual al sistema real
         }
         else if (strncmp(command, "load ", 5) == 0) {
-            fs_load(&fs, command + 5);   // Carga un archivo del sistema real al virtual
+            // load <nombre> [ocupación]: la ocupación es la última palabra si es un número en (0, 1]
+            char* sp = strrchr(command + 5, ' ');
+            char* end = NULL;
+            double fill = sp ? strtod(sp + 1, &end) : 0.0;
+            if (sp && end != sp + 1 && *end == 0 && fill > 0.0 && fill <= 1.0) {
+                *sp = 0;
+                ok = fs_load(&fs, command + 5, fill);
+            } else {
+                ok = fs_load(&fs, command + 5, FS_LOAD_FILL); // Carga un archivo del sistema real al virtual
+            }
+        }
+        else if (strcmp(command, "sync") == 0) {
+            ok = fs_sync(&fs);           // Vuelca lo pendiente en storage.bin y el diario
+        }
+        else if (strcmp(command, "checkpoint") == 0) {
+            ok = fs_checkpoint(&fs);     // Guarda el índice y empieza un diario nuevo
+        }
+        else if (strcmp(command, "readmode mmap") == 0 || strcmp(command, "readmode pread") == 0) {
+            fs_set_read_mode(&fs, command[9] == 'm'); // Lectura con mmap o con pread
+        }
+        else if (strcmp(command, "ingest uring") == 0 || strcmp(command, "ingest hilos") == 0) {
+            ok = fs_set_ingest(&fs, command[7] == 'u'); // loadall con io_uring o con hilos
+        }
+        else if (strncmp(command, "cache ", 6) == 0) {
+            fs_set_cache(&fs, (size_t)strtoull(command + 6, NULL, 10)); // Presupuesto en bytes
+        }
+        else if (strcmp(command, "cachestats") == 0) {
+            fs_cache_stats(&fs);         // Aciertos, fallos y expulsiones
+        }
+        else if (strncmp(command, "groupcommit ", 12) == 0) {
+            // groupcommit <bytes> <ms> <fdatasync 0|1>
+            unsigned long long bytes;
+            unsigned ms;
+            int sync;
+            if (sscanf(command + 12, "%llu %u %d", &bytes, &ms, &sync) == 3) {
+                fs_set_commit(&fs, (size_t)bytes, ms, sync != 0);
+            } else {
+                printf("Uso: groupcommit <bytes> <ms> <0|1>\n");
+                ok = false;
+            }
+        }
+        else if (strncmp(command, "codec ", 6) == 0) {
+            ok = fs_set_codec(&fs, command + 6); // auto | guardado | rle | lzw
+        }
+        else if (strcmp(command, "stats") == 0) {
+            fs_stats(&fs, NULL);         // Latencias, bytes y forma del índice
+        }
+        else if (strcmp(command, "stats reset") == 0) {
+            fs_stats_reset(&fs);
+        }
+        else if (strcmp(command, "stats json") == 0 || strncmp(command, "stats json ", 11) == 0) {
+            // stats json [archivo]: el objeto va a stdout o al archivo
+            FILE* out = command[10] ? fopen(command + 11, "w") : NULL;
+            if (command[10] && !out) {
+                printf("Error: no se pudo crear %s\n", command + 11);
+                ok = false;
+            } else if (out) {
+                fs_stats(&fs, out);
+                fclose(out);
+            } else {
+                if (quiet) fprintf(res, "ok 1\n");
+                fs_stats(&fs, res);
+                data = quiet;
+            }
+        }
+        else if (strcmp(command, "segments") == 0) {
+            fs_segments(&fs);            // Tamaño y bytes vivos de cada segmento
+        }
+        else if (strcmp(command, "compact wait") == 0) {
+            // Termina la compactación en curso sin pausas
+            while (fs_compact_pending(&fs)) fs_compact_step(&fs, FS_COMPACT_SLICE);
+        }
+        else if (strcmp(command, "compact") == 0 || strncmp(command, "compact ", 8) == 0) {
+            // compact [fracción muerta]: elige los segmentos a compactar
+            double dead = command[7] ? strtod(command + 8, NULL) : FS_COMPACT_DEAD;
+            if (dead > 0.0 && dead <= 1.0) {
+                ok = fs_compact_start(&fs, dead);
+            } else {
+                printf("Uso: compact [fraccion en (0, 1]] | compact wait\n");
+                ok = false;
+            }
         }
         else if (strncmp(command, "loadall ", 8) == 0) {
-            load_all_files(&fs, command + 8); // Carga todos los archivos de una carpeta
+            ok = load_all_files(&fs, command + 8); // Carga todos los archivos de una carpeta
         }
         else if (strcmp(command, "exit") == 0) {
             break; // Salir del programa
         }
         else {
             printf("Comando no reconocido.\n");
+            ok = false;
         }
+
+        if (!ok) failures++;
+        if (quiet && !data) fprintf(res, ok ? "ok\n" : "error\n");
+        if (quiet) fflush(res);
+        if (data && !ok) break;   // Respuesta con datos a medias
     }
 
-    return 0;
+    fs_close(&fs); // Vuelca lo pendiente antes de salir
+    if (script) fclose(in);
+    if (quiet) fclose(res);
+    // Por lotes, el código de salida dice si alguna orden falló
+    return batch && failures ? 1 : 0;
 }
-
@@ -0,0 +1,63 @@
+#include "metrics.h"
+#include <string.h>
+#include <time.h>
+
+Metrics metrics;
+
+static const char *op_names[METRIC_NOPS] = { "create", "read", "delete", "save", "load" };
+
+const char* metrics_op_name(MetricOp op) {
+    return op < METRIC_NOPS ? op_names[op] : "?";
+}
+
+uint64_t metrics_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Cubo de una latencia: 0 si < 1 us, si no 1 + log2(us)
+static int bucket_of(uint64_t ns) {
+    uint64_t us = ns / 1000;
+    int b = 0;
+    while (us > 0 && b < METRIC_BUCKETS - 1) {
+        us >>= 1;
+        b++;
+    }
+    return b;
+}
+
+uint64_t metrics_bucket_limit(int b) {
+    return (1ull << b) * 1000;
+}
+
+void metrics_record(MetricOp op, uint64_t ns, bool ok) {
+    MetricHist *h = &metrics.ops[op];
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+    if (!ok) __atomic_fetch_add(&h->errors, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->total_ns, ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->buckets[bucket_of(ns)], 1, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&h->max_ns, __ATOMIC_RELAXED);
+    while (ns > max && !__atomic_compare_exchange_n(&h->max_ns, &max, ns, true,
+                                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+uint64_t metrics_percentile(const MetricHist* h, double q) {
+    if (h->count == 0) return 0;
+    uint64_t rank = (uint64_t)(q * (double)h->count + 0.999999), seen = 0;
+    if (rank == 0) rank = 1;
+    for (int b = 0; b < METRIC_BUCKETS; ++b) {
+        seen += h->buckets[b];
+        if (seen >= rank) {
+            // El máximo acota mejor el último cubo ocupado
+            uint64_t limit = metrics_bucket_limit(b);
+            return limit < h->max_ns ? limit : h->max_ns;
+        }
+    }
+    return h->max_ns;
+}
+
+void metrics_reset(void) {
+    memset(&metrics, 0, sizeof(metrics));
+}
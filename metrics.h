@@ -0,0 +1,83 @@
+#ifndef METRICS_H
+#define METRICS_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// -------------------------------------------------------
+// Métricas del proceso: contadores y latencias por operación,
+// bytes que entran, se escriben comprimidos y se leen de storage,
+// y sucesos del compresor. Los contadores son globales y se suman
+// con operaciones atómicas relajadas, así que los hilos de la
+// ingesta y del pool los actualizan sin cerrojos.
+//
+// Cada latencia cae en un cubo logarítmico: el cubo 0 es < 1 us y
+// el cubo i (i >= 1) es [2^(i-1), 2^i) us. El último recoge todo
+// lo mayor. Los percentiles se estiman con el límite superior del
+// cubo donde caen.
+//
+// Compilando con -DFS_METRICS=0 todas las macros METRIC_* quedan
+// vacías y no cuestan nada.
+// -------------------------------------------------------
+#ifndef FS_METRICS
+#define FS_METRICS 1
+#endif
+
+#define METRIC_BUCKETS 32
+
+typedef enum {
+    METRIC_CREATE,
+    METRIC_READ,
+    METRIC_DELETE,
+    METRIC_SAVE,
+    METRIC_LOAD,
+    METRIC_NOPS
+} MetricOp;
+
+typedef struct {
+    uint64_t count;
+    uint64_t errors;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t buckets[METRIC_BUCKETS];
+} MetricHist;
+
+typedef struct {
+    MetricHist ops[METRIC_NOPS];
+    uint64_t bytes_in;           // Bytes originales guardados
+    uint64_t bytes_out;          // Bytes comprimidos escritos en storage
+    uint64_t bytes_read;         // Bytes leídos de storage
+    uint64_t lzw_dict_full;      // Veces que se llenó el diccionario LZW
+    uint64_t lzw_dict_reset;     // Reinicios (CLEAR) con el diccionario lleno
+} Metrics;
+
+extern Metrics metrics;
+
+// Nombre de una operación ("create", "read"...)
+const char* metrics_op_name(MetricOp op);
+
+// Reloj monótono en nanosegundos
+uint64_t metrics_now(void);
+
+// Anota una operación de ns nanosegundos (ok = sin error)
+void metrics_record(MetricOp op, uint64_t ns, bool ok);
+
+// Percentil q (0..1) de una operación en ns (estimado por cubos)
+uint64_t metrics_percentile(const MetricHist* h, double q);
+
+// Límite superior en ns del cubo b
+uint64_t metrics_bucket_limit(int b);
+
+void metrics_reset(void);
+
+#if FS_METRICS
+#define METRIC_START(t) uint64_t t = metrics_now()
+#define METRIC_END(op, t, ok) metrics_record((op), metrics_now() - (t), (ok))
+#define METRIC_ADD(field, n) __atomic_fetch_add(&metrics.field, (uint64_t)(n), __ATOMIC_RELAXED)
+#else
+#define METRIC_START(t) ((void)0)
+#define METRIC_END(op, t, ok) ((void)0)
+#define METRIC_ADD(field, n) ((void)0)
+#endif
+
+#endif // METRICS_H
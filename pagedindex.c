@@ -0,0 +1,645 @@
+#include "pagedindex.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define PG_LEAF 1
+#define PG_INNER 2
+#define PG_HEADER 16
+#define LEAF_TAIL sizeof(PidxValue)
+#define INNER_TAIL sizeof(uint32_t)
+
+// --------------------------------------------------------
+// Acceso a los campos de una página
+// --------------------------------------------------------
+static uint16_t rd16(const uint8_t* p) { uint16_t v; memcpy(&v, p, 2); return v; }
+static uint32_t rd32(const uint8_t* p) { uint32_t v; memcpy(&v, p, 4); return v; }
+static void wr16(uint8_t* p, uint16_t v) { memcpy(p, &v, 2); }
+static void wr32(uint8_t* p, uint32_t v) { memcpy(p, &v, 4); }
+
+static int pg_type(const uint8_t* p) { return p[0]; }
+static int pg_n(const uint8_t* p) { return rd16(p + 2); }
+static uint32_t pg_first(const uint8_t* p) { return rd32(p + 8); }
+static const uint8_t* pg_rec(const uint8_t* p, int i) { return p + rd16(p + PG_HEADER + 2 * i); }
+static size_t pg_tail(const uint8_t* p) { return pg_type(p) == PG_LEAF ? LEAF_TAIL : INNER_TAIL; }
+
+// Hijo derecho del registro i de un nodo interno (o su posición)
+static uint8_t* rec_child(uint8_t* rec) { return rec + 1 + rec[0]; }
+
+static void pg_init(uint8_t* p, int type, uint32_t first) {
+    memset(p, 0, PG_HEADER);
+    p[0] = (uint8_t)type;
+    wr16(p + 4, PIDX_PAGE_SIZE);
+    wr32(p + 8, first);
+}
+
+// Bytes ocupados de la página
+static size_t pg_used(const uint8_t* p) {
+    return PG_HEADER + 2 * (size_t)pg_n(p) + (PIDX_PAGE_SIZE - rd16(p + 4));
+}
+
+// Añade un registro al final; falso si no cabe
+static bool pg_append(uint8_t* p, const uint8_t* key, size_t klen, const void* tail, size_t tail_len) {
+    int n = pg_n(p);
+    size_t need = 1 + klen + tail_len;
+    size_t end = rd16(p + 4);
+    if (PG_HEADER + 2 * (size_t)(n + 1) + need > end) return false;
+    end -= need;
+    p[end] = (uint8_t)klen;
+    memcpy(p + end + 1, key, klen);
+    memcpy(p + end + 1 + klen, tail, tail_len);
+    wr16(p + 4, (uint16_t)end);
+    wr16(p + PG_HEADER + 2 * n, (uint16_t)end);
+    wr16(p + 2, (uint16_t)(n + 1));
+    return true;
+}
+
+// Orden de bytes, como strcmp
+static int key_cmp(const char* a, size_t alen, const uint8_t* rec) {
+    size_t blen = rec[0];
+    int c = memcmp(a, rec + 1, alen < blen ? alen : blen);
+    if (c != 0) return c;
+    return alen < blen ? -1 : alen > blen;
+}
+
+// Primer registro >= key; *found indica si es igual
+static int pg_lower(const uint8_t* p, const char* key, size_t klen, bool* found) {
+    int lo = 0, hi = pg_n(p);
+    *found = false;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        int c = key_cmp(key, klen, pg_rec(p, mid));
+        if (c > 0) lo = mid + 1;
+        else if (c < 0) hi = mid;
+        else {
+            *found = true;
+            return mid;
+        }
+    }
+    return lo;
+}
+
+// Índice del hijo por el que baja key en un nodo interno: 0 es el
+// primer hijo e i > 0 el hijo derecho del registro i - 1
+static int pg_child_index(const uint8_t* p, const char* key, size_t klen) {
+    bool found;
+    int i = pg_lower(p, key, klen, &found);
+    return found ? i + 1 : i;
+}
+
+static uint32_t pg_child(const uint8_t* p, int ci) {
+    return ci == 0 ? pg_first(p) : rd32(rec_child((uint8_t*)pg_rec(p, ci - 1)));
+}
+
+// --------------------------------------------------------
+// Páginas modificadas durante una actualización (tabla hash)
+// --------------------------------------------------------
+static uint8_t* dirty_find(const PagedIndex* px, uint32_t pg) {
+    if (px->dirty_count == 0) return NULL;
+    size_t mask = px->dirty_cap - 1;
+    for (size_t i = (pg * 2654435761u) & mask; px->dirty_keys[i]; i = (i + 1) & mask)
+        if (px->dirty_keys[i] == pg) return px->dirty_bufs[i];
+    return NULL;
+}
+
+static bool dirty_add(PagedIndex* px, uint32_t pg, uint8_t* buf) {
+    if ((px->dirty_count + 1) * 2 > px->dirty_cap) {
+        size_t cap = px->dirty_cap ? px->dirty_cap * 2 : 64;
+        uint32_t *keys = calloc(cap, sizeof(uint32_t));
+        uint8_t **bufs = calloc(cap, sizeof(uint8_t*));
+        if (!keys || !bufs) {
+            free(keys);
+            free(bufs);
+            return false;
+        }
+        for (size_t i = 0; i < px->dirty_cap; ++i) {
+            if (!px->dirty_keys[i]) continue;
+            size_t j = (px->dirty_keys[i] * 2654435761u) & (cap - 1);
+            while (keys[j]) j = (j + 1) & (cap - 1);
+            keys[j] = px->dirty_keys[i];
+            bufs[j] = px->dirty_bufs[i];
+        }
+        free(px->dirty_keys);
+        free(px->dirty_bufs);
+        px->dirty_keys = keys;
+        px->dirty_bufs = bufs;
+        px->dirty_cap = cap;
+    }
+    size_t i = (pg * 2654435761u) & (px->dirty_cap - 1);
+    while (px->dirty_keys[i]) i = (i + 1) & (px->dirty_cap - 1);
+    px->dirty_keys[i] = pg;
+    px->dirty_bufs[i] = buf;
+    px->dirty_count++;
+    return true;
+}
+
+// Página pg: la copia modificada si la hay, si no la proyección
+static const uint8_t* page_get(const PagedIndex* px, uint32_t pg) {
+    const uint8_t *d = dirty_find(px, pg);
+    if (d) return d;
+    if (pg == 0 || pg >= px->h.npages || (size_t)(pg + 1) * PIDX_PAGE_SIZE > px->map_len) return NULL;
+    return px->map + (size_t)pg * PIDX_PAGE_SIZE;
+}
+
+// --------------------------------------------------------
+// Apertura y búsqueda
+// --------------------------------------------------------
+
+// Proyecta el archivo entero (sin leerlo) y copia la cabecera
+static bool pidx_map(PagedIndex* px) {
+    struct stat st;
+    if (fstat(px->fd, &st) != 0 || st.st_size < PIDX_PAGE_SIZE) return false;
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, px->fd, 0);
+    if (map == MAP_FAILED) return false;
+    if (px->map) munmap((void*)px->map, px->map_len);
+    px->map = map;
+    px->map_len = (size_t)st.st_size;
+
+    memcpy(&px->h, px->map, sizeof(PidxHeader));
+    if (memcmp(px->h.magic, PIDX_MAGIC, 4) != 0 || px->h.version != PIDX_VERSION ||
+        px->h.page_size != PIDX_PAGE_SIZE || px->h.nfree > PIDX_MAX_FREE ||
+        px->h.height == 0 || px->h.height > PIDX_MAX_HEIGHT ||
+        (size_t)px->h.npages * PIDX_PAGE_SIZE > px->map_len) return false;
+    memcpy(px->free_pages, px->map + sizeof(PidxHeader), sizeof(uint32_t) * px->h.nfree);
+    return true;
+}
+
+bool pidx_open(PagedIndex* px, const char* path) {
+    memset(px, 0, sizeof(*px));
+    px->fd = open(path, O_RDWR);
+    if (px->fd < 0) return false;
+    if (!pidx_map(px)) {
+        pidx_close(px);
+        return false;
+    }
+    return true;
+}
+
+void pidx_close(PagedIndex* px) {
+    pidx_rollback(px);
+    free(px->dirty_keys);
+    free(px->dirty_bufs);
+    free(px->freed);
+    if (px->map) munmap((void*)px->map, px->map_len);
+    if (px->fd >= 0) close(px->fd);
+    memset(px, 0, sizeof(*px));
+    px->fd = -1;
+}
+
+bool pidx_lookup(const PagedIndex* px, const char* key, PidxValue* out) {
+    size_t klen = strlen(key);
+    if (klen > PIDX_KEY_MAX || !px->map) return false;
+    const uint8_t *p = page_get(px, px->h.root);
+    while (p && pg_type(p) == PG_INNER)
+        p = page_get(px, pg_child(p, pg_child_index(p, key, klen)));
+    if (!p) return false;
+    bool found;
+    int i = pg_lower(p, key, klen, &found);
+    if (!found) return false;
+    const uint8_t *rec = pg_rec(p, i);
+    memcpy(out, rec + 1 + rec[0], sizeof(PidxValue));
+    return true;
+}
+
+// --------------------------------------------------------
+// Recorrido en orden
+// --------------------------------------------------------
+void pidx_iter_init(PidxIter* it, const PagedIndex* px) {
+    it->px = px;
+    it->depth = px && px->map ? 0 : -1;
+    if (it->depth == 0) {
+        it->page[0] = px->h.root;
+        it->slot[0] = 0;
+    }
+}
+
+void pidx_iter_seek(PidxIter* it, const PagedIndex* px, const char* key) {
+    pidx_iter_init(it, px);
+    if (it->depth < 0 || !key || !*key) return;
+    size_t klen = strlen(key);
+    // Baja por el camino de key dejando en cada nivel el siguiente hijo
+    for (int d = 0; d < PIDX_MAX_HEIGHT; ++d) {
+        const uint8_t *p = page_get(px, it->page[d]);
+        if (!p) return;
+        it->depth = d;
+        bool found;
+        if (pg_type(p) == PG_LEAF) {
+            it->slot[d] = pg_lower(p, key, klen, &found);
+            return;
+        }
+        int ci = pg_child_index(p, key, klen);
+        it->slot[d] = ci + 1;
+        if (d + 1 >= PIDX_MAX_HEIGHT) return;
+        it->page[d + 1] = pg_child(p, ci);
+        it->slot[d + 1] = 0;
+    }
+}
+
+bool pidx_iter_next(PidxIter* it, PidxValue* value) {
+    while (it->depth >= 0) {
+        int d = it->depth;
+        const uint8_t *p = page_get(it->px, it->page[d]);
+        if (!p) return false;
+        int n = pg_n(p);
+        if (pg_type(p) == PG_LEAF) {
+            if (it->slot[d] < n) {
+                const uint8_t *rec = pg_rec(p, it->slot[d]++);
+                memcpy(it->key, rec + 1, rec[0]);
+                it->key[rec[0]] = '\0';
+                memcpy(value, rec + 1 + rec[0], sizeof(PidxValue));
+                return true;
+            }
+            it->depth--;
+        } else if (it->slot[d] > n || d + 1 >= PIDX_MAX_HEIGHT) {
+            it->depth--;
+        } else {
+            it->page[d + 1] = pg_child(p, it->slot[d]++);
+            it->slot[d + 1] = 0;
+            it->depth++;
+        }
+    }
+    return false;
+}
+
+// --------------------------------------------------------
+// Escritura completa, de abajo arriba
+// --------------------------------------------------------
+struct PidxWriter {
+    FILE *f;
+    char path[512];
+    char tmp[520];
+    uint32_t npages;                         // Siguiente número de página
+    uint64_t count;
+    bool ok;
+    uint8_t page[PIDX_MAX_HEIGHT][PIDX_PAGE_SIZE];  // Página abierta de cada nivel
+    bool open[PIDX_MAX_HEIGHT];
+    uint32_t written[PIDX_MAX_HEIGHT];       // Páginas ya escritas por nivel
+    char low[PIDX_MAX_HEIGHT][PIDX_KEY_MAX]; // Menor llave bajo la página abierta
+    size_t low_len[PIDX_MAX_HEIGHT];
+    char last[PIDX_KEY_MAX];                 // Última llave añadida
+    size_t last_len;
+};
+
+PidxWriter* pidx_writer_create(const char* path) {
+    PidxWriter *w = calloc(1, sizeof(PidxWriter));
+    if (!w) return NULL;
+    snprintf(w->path, sizeof(w->path), "%s", path);
+    snprintf(w->tmp, sizeof(w->tmp), "%s.tmp", path);
+    w->f = fopen(w->tmp, "wb");
+    if (!w->f) {
+        free(w);
+        return NULL;
+    }
+    setvbuf(w->f, NULL, _IOFBF, 1 << 20);
+
+    // La página 0 (cabecera) se escribe al final
+    uint8_t zero[PIDX_PAGE_SIZE] = { 0 };
+    w->ok = fwrite(zero, 1, sizeof(zero), w->f) == sizeof(zero);
+    w->npages = 1;
+    w->last_len = SIZE_MAX;
+    return w;
+}
+
+static bool writer_push(PidxWriter* w, int level, const char* key, size_t klen, uint32_t child);
+
+// Escribe la página abierta del nivel y sube su menor llave al padre
+static bool writer_flush(PidxWriter* w, int level) {
+    uint32_t pg = w->npages++;
+    if (fwrite(w->page[level], 1, PIDX_PAGE_SIZE, w->f) != PIDX_PAGE_SIZE) return false;
+    w->open[level] = false;
+    w->written[level]++;
+    return writer_push(w, level + 1, w->low[level], w->low_len[level], pg);
+}
+
+// Añade un hijo a la página abierta de un nivel interno
+static bool writer_push(PidxWriter* w, int level, const char* key, size_t klen, uint32_t child) {
+    if (level >= PIDX_MAX_HEIGHT) return false;
+    if (w->open[level]) {
+        if (pg_append(w->page[level], (const uint8_t*)key, klen, &child, INNER_TAIL)) return true;
+        if (!writer_flush(w, level)) return false;
+    }
+    // Página nueva: el hijo es el primero y su llave la menor
+    pg_init(w->page[level], PG_INNER, child);
+    memcpy(w->low[level], key, klen);
+    w->low_len[level] = klen;
+    w->open[level] = true;
+    return true;
+}
+
+bool pidx_writer_add(PidxWriter* w, const char* key, const PidxValue* value) {
+    size_t klen = strlen(key);
+    if (!w->ok || klen > PIDX_KEY_MAX) return w->ok = false;
+    // Orden estrictamente creciente
+    if (w->last_len != SIZE_MAX) {
+        int c = memcmp(w->last, key, w->last_len < klen ? w->last_len : klen);
+        if (c > 0 || (c == 0 && w->last_len >= klen)) return w->ok = false;
+    }
+    memcpy(w->last, key, klen);
+    w->last_len = klen;
+
+    uint8_t *p = w->page[0];
+    size_t need = 2 + 1 + klen + LEAF_TAIL;
+    if (w->open[0] && pg_used(p) + need > (size_t)(PIDX_PAGE_SIZE * PIDX_FILL) &&
+        !writer_flush(w, 0)) return w->ok = false;
+    if (!w->open[0]) {
+        pg_init(p, PG_LEAF, 0);
+        memcpy(w->low[0], key, klen);
+        w->low_len[0] = klen;
+        w->open[0] = true;
+    }
+    if (!pg_append(p, (const uint8_t*)key, klen, value, LEAF_TAIL)) return w->ok = false;
+    w->count++;
+    return true;
+}
+
+bool pidx_writer_finish(PidxWriter* w) {
+    if (!w) return false;
+    bool ok = w->ok;
+    PidxHeader h;
+    memset(&h, 0, sizeof(h));
+
+    // Índice vacío: una hoja sin llaves como raíz
+    if (ok && !w->open[0] && w->written[0] == 0) {
+        pg_init(w->page[0], PG_LEAF, 0);
+        w->open[0] = true;
+    }
+    // Cerrar niveles de abajo arriba; la raíz es la única página de
+    // su nivel
+    for (int l = 0; ok && l < PIDX_MAX_HEIGHT; ++l) {
+        if (w->written[l] == 0 && w->open[l]) {
+            h.root = w->npages++;
+            h.height = (uint32_t)l + 1;
+            ok = fwrite(w->page[l], 1, PIDX_PAGE_SIZE, w->f) == PIDX_PAGE_SIZE;
+            break;
+        }
+        if (w->open[l]) ok = writer_flush(w, l);
+    }
+    ok = ok && h.height > 0;
+
+    memcpy(h.magic, PIDX_MAGIC, 4);
+    h.version = PIDX_VERSION;
+    h.page_size = PIDX_PAGE_SIZE;
+    h.npages = w->npages;
+    h.count = w->count;
+    if (ok) ok = fseek(w->f, 0, SEEK_SET) == 0 && fwrite(&h, sizeof(h), 1, w->f) == 1;
+    if (ok) ok = fflush(w->f) == 0 && fsync(fileno(w->f)) == 0;
+    if (fclose(w->f) != 0) ok = false;
+    if (ok) ok = rename(w->tmp, w->path) == 0;
+    if (!ok) remove(w->tmp);
+    free(w);
+    return ok;
+}
+
+// --------------------------------------------------------
+// Actualización incremental (copia de páginas)
+// --------------------------------------------------------
+
+// Número de página para una copia: una libre o una nueva al final
+static uint32_t alloc_page(PagedIndex* px) {
+    if (px->next_free < px->h.nfree) return px->free_pages[px->next_free++];
+    return px->h.npages++;
+}
+
+static bool freed_add(PagedIndex* px, uint32_t pg) {
+    if (px->nfreed == px->freed_cap) {
+        size_t cap = px->freed_cap ? px->freed_cap * 2 : 64;
+        uint32_t *grown = realloc(px->freed, sizeof(uint32_t) * cap);
+        if (!grown) return false;
+        px->freed = grown;
+        px->freed_cap = cap;
+    }
+    px->freed[px->nfreed++] = pg;
+    return true;
+}
+
+// Página nueva en blanco
+static uint8_t* page_new(PagedIndex* px, uint32_t* pg) {
+    uint8_t *buf = malloc(PIDX_PAGE_SIZE);
+    if (!buf) return NULL;
+    *pg = alloc_page(px);
+    if (!dirty_add(px, *pg, buf)) {
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+// Copia modificable de la página pg. Si ya es una copia de esta
+// actualización se usa tal cual; si no, se copia a otra página y pg
+// queda libre. *pg pasa a ser el número de la copia.
+static uint8_t* page_shadow(PagedIndex* px, uint32_t* pg) {
+    uint8_t *d = dirty_find(px, *pg);
+    if (d) return d;
+    const uint8_t *src = page_get(px, *pg);
+    if (!src || !freed_add(px, *pg)) return NULL;
+    uint8_t *buf = page_new(px, pg);
+    if (buf) memcpy(buf, src, PIDX_PAGE_SIZE);
+    return buf;
+}
+
+typedef struct {
+    const uint8_t *key;
+    size_t klen;
+    const void *tail;
+} PgEntry;
+
+// Llave que sube al padre tras dividir una página
+typedef struct {
+    bool split;
+    char key[PIDX_KEY_MAX];
+    size_t klen;
+    uint32_t right;
+} PgSplit;
+
+// Reescribe p con la entrada e colocada en la posición pos
+// (sustituyendo la existente si replace, o borrándola si e es NULL).
+// Si no cabe, divide la página en dos y deja en s la llave que sube.
+static bool page_rewrite(PagedIndex* px, uint8_t* p, int pos, bool replace, const PgEntry* e, PgSplit* s) {
+    uint8_t old[PIDX_PAGE_SIZE];
+    memcpy(old, p, PIDX_PAGE_SIZE);
+    int type = pg_type(old), n = pg_n(old);
+    size_t tail = pg_tail(old);
+
+    PgEntry ents[PIDX_PAGE_SIZE / 3];
+    int m = 0;
+    size_t total = 0;
+    for (int i = 0; i <= n; ++i) {
+        if (i == pos && e) ents[m++] = *e;
+        if (i == n) break;
+        if (i == pos && (replace || !e)) continue;
+        const uint8_t *rec = pg_rec(old, i);
+        ents[m].key = rec + 1;
+        ents[m].klen = rec[0];
+        ents[m].tail = rec + 1 + rec[0];
+        m++;
+    }
+    for (int i = 0; i < m; ++i) total += 2 + 1 + ents[i].klen + tail;
+
+    s->split = false;
+    if (PG_HEADER + total <= PIDX_PAGE_SIZE) {
+        pg_init(p, type, pg_first(old));
+        for (int i = 0; i < m; ++i) pg_append(p, ents[i].key, ents[i].klen, ents[i].tail, tail);
+        return true;
+    }
+
+    // Dividir por la mitad de los bytes
+    int mid = 0;
+    size_t acc = 0;
+    while (mid < m - 1 && acc < total / 2) acc += 2 + 1 + ents[mid++].klen + tail;
+    uint8_t *right = page_new(px, &s->right);
+    if (!right) return false;
+    s->split = true;
+    s->klen = ents[mid].klen;
+    memcpy(s->key, ents[mid].key, s->klen);
+
+    pg_init(p, type, pg_first(old));
+    for (int i = 0; i < mid; ++i) pg_append(p, ents[i].key, ents[i].klen, ents[i].tail, tail);
+    if (type == PG_LEAF) {
+        // En las hojas la llave que sube también se queda a la derecha
+        pg_init(right, PG_LEAF, 0);
+        for (int i = mid; i < m; ++i) pg_append(right, ents[i].key, ents[i].klen, ents[i].tail, tail);
+    } else {
+        // En los internos sube y su hijo pasa a ser el primero
+        pg_init(right, PG_INNER, rd32(ents[mid].tail));
+        for (int i = mid + 1; i < m; ++i) pg_append(right, ents[i].key, ents[i].klen, ents[i].tail, tail);
+    }
+    return true;
+}
+
+// Baja hasta la hoja de key copiando el camino. Deja en path las
+// páginas (ya copiadas) y en child el índice del hijo elegido.
+static int descend_shadow(PagedIndex* px, const char* key, size_t klen,
+                          uint8_t* path[], int child[]) {
+    uint32_t pg = px->h.root;
+    uint8_t *p = page_shadow(px, &pg);
+    if (!p) return -1;
+    px->h.root = pg;
+    int d = 0;
+    path[0] = p;
+    while (pg_type(p) == PG_INNER) {
+        int ci = pg_child_index(p, key, klen);
+        uint32_t c = pg_child(p, ci);
+        uint8_t *cp = page_shadow(px, &c);
+        if (!cp || d + 1 >= PIDX_MAX_HEIGHT) return -1;
+        if (ci == 0) wr32(p + 8, c);
+        else wr32(rec_child((uint8_t*)pg_rec(p, ci - 1)), c);
+        child[d] = ci;
+        path[++d] = p = cp;
+    }
+    return d;
+}
+
+// Sube las divisiones desde el nivel d hasta donde quepan; si se
+// divide la raíz el árbol crece un nivel
+static bool propagate(PagedIndex* px, uint8_t* path[], int child[], int d, PgSplit* s) {
+    while (s->split) {
+        PgEntry e = { (const uint8_t*)s->key, s->klen, &s->right };
+        PgSplit up;
+        if (d == 0) {
+            uint32_t pg;
+            uint8_t *root = page_new(px, &pg);
+            if (!root) return false;
+            pg_init(root, PG_INNER, px->h.root);
+            pg_append(root, e.key, e.klen, e.tail, INNER_TAIL);
+            px->h.root = pg;
+            px->h.height++;
+            return px->h.height <= PIDX_MAX_HEIGHT;
+        }
+        d--;
+        if (!page_rewrite(px, path[d], child[d], false, &e, &up)) return false;
+        *s = up;
+    }
+    return true;
+}
+
+bool pidx_put(PagedIndex* px, const char* key, const PidxValue* value) {
+    size_t klen = strlen(key);
+    if (klen > PIDX_KEY_MAX || !px->map) return false;
+    PidxValue cur;
+    bool exists = pidx_lookup(px, key, &cur);
+    if (exists && memcmp(&cur, value, sizeof(cur)) == 0) return true;
+
+    uint8_t *path[PIDX_MAX_HEIGHT];
+    int child[PIDX_MAX_HEIGHT];
+    int d = descend_shadow(px, key, klen, path, child);
+    if (d < 0) return false;
+    bool found;
+    int pos = pg_lower(path[d], key, klen, &found);
+    PgEntry e = { (const uint8_t*)key, klen, value };
+    PgSplit s;
+    if (!page_rewrite(px, path[d], pos, found, &e, &s)) return false;
+    if (!found) px->h.count++;
+    return propagate(px, path, child, d, &s);
+}
+
+// Las hojas pueden quedar con pocas llaves (o vacías): las búsquedas
+// siguen siendo correctas y una escritura completa las compacta
+bool pidx_remove(PagedIndex* px, const char* key) {
+    size_t klen = strlen(key);
+    PidxValue cur;
+    if (klen > PIDX_KEY_MAX || !pidx_lookup(px, key, &cur)) return true;
+
+    uint8_t *path[PIDX_MAX_HEIGHT];
+    int child[PIDX_MAX_HEIGHT];
+    int d = descend_shadow(px, key, klen, path, child);
+    if (d < 0) return false;
+    bool found;
+    int pos = pg_lower(path[d], key, klen, &found);
+    PgSplit s;
+    if (found && !page_rewrite(px, path[d], pos, true, NULL, &s)) return false;
+    if (found) px->h.count--;
+    return true;
+}
+
+// Libera las copias en memoria
+static void dirty_clear(PagedIndex* px) {
+    for (size_t i = 0; i < px->dirty_cap; ++i) {
+        if (px->dirty_keys[i]) free(px->dirty_bufs[i]);
+        px->dirty_keys[i] = 0;
+    }
+    px->dirty_count = 0;
+    px->nfreed = 0;
+    px->next_free = 0;
+}
+
+static bool write_page(int fd, const uint8_t* buf, uint32_t pg) {
+    return pwrite(fd, buf, PIDX_PAGE_SIZE, (off_t)pg * PIDX_PAGE_SIZE) == PIDX_PAGE_SIZE;
+}
+
+bool pidx_commit(PagedIndex* px) {
+    if (px->dirty_count == 0) return true;
+
+    // Primero las páginas nuevas; la cabecera solo cuando ya están
+    // en disco
+    bool ok = true;
+    for (size_t i = 0; ok && i < px->dirty_cap; ++i)
+        if (px->dirty_keys[i]) ok = write_page(px->fd, px->dirty_bufs[i], px->dirty_keys[i]);
+    if (ok) ok = fdatasync(px->fd) == 0;
+
+    // Libres: las que quedaron sin usar y las sustituidas ahora (las
+    // que no quepan se pierden hasta la próxima escritura completa)
+    uint8_t page[PIDX_PAGE_SIZE];
+    memset(page, 0, sizeof(page));
+    uint32_t *list = (uint32_t*)(page + sizeof(PidxHeader));
+    uint32_t nfree = 0;
+    for (uint32_t i = px->next_free; i < px->h.nfree; ++i) list[nfree++] = px->free_pages[i];
+    for (size_t i = 0; i < px->nfreed && nfree < PIDX_MAX_FREE; ++i) list[nfree++] = px->freed[i];
+    px->h.nfree = nfree;
+    memcpy(page, &px->h, sizeof(PidxHeader));
+    if (ok) ok = write_page(px->fd, page, 0) && fdatasync(px->fd) == 0;
+
+    dirty_clear(px);
+    // Volver a proyectar (el archivo pudo crecer) y releer la cabecera
+    if (!pidx_map(px)) ok = false;
+    return ok;
+}
+
+void pidx_rollback(PagedIndex* px) {
+    if (px->dirty_count == 0) return;
+    dirty_clear(px);
+    memcpy(&px->h, px->map, sizeof(PidxHeader));
+}
@@ -0,0 +1,112 @@
+#ifndef PAGEDINDEX_H
+#define PAGEDINDEX_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// -------------------------------------------------------
+// Índice en disco (<nombre>.idx): B+tree paginado que se abre con
+// mmap. Abrirlo solo lee la cabecera; las páginas las trae el
+// sistema cuando una búsqueda las toca, así que el arranque no
+// depende del número de archivos.
+//
+// Formato (páginas de PIDX_PAGE_SIZE bytes, little-endian):
+//   Página 0: cabecera (PidxHeader) y la lista de páginas libres.
+//   Resto: nodos. Cabecera de 16 bytes
+//     [u8 tipo][u8 0][u16 n][u16 inicio de registros][u16 0]
+//     [u32 primer hijo (solo internos)][u32 0]
+//   seguida de n desplazamientos u16 a los registros, que se
+//   colocan desde el final de la página hacia atrás:
+//     hoja:    [u8 len][llave][i64 posición][u64 comp][u64 orig]
+//              [u64 hash[2]]
+//     interno: [u8 len][llave][u32 hijo derecho]
+//   Las llaves están ordenadas y no terminan en 0. En un nodo
+//   interno, el hijo de la llave i contiene las llaves >= llave i.
+//
+// Actualización incremental: los cambios se aplican copiando cada
+// página tocada (y su camino hasta la raíz) a una página nueva o
+// libre. Solo esas páginas se escriben; la cabecera va al final,
+// así que un corte a medias deja el índice anterior intacto. Las
+// páginas sustituidas se reutilizan en la siguiente actualización.
+// -------------------------------------------------------
+#define PIDX_MAGIC "FSIX"
+#define PIDX_VERSION 2
+#define PIDX_PAGE_SIZE 4096
+#define PIDX_MAX_HEIGHT 16
+#define PIDX_KEY_MAX 255
+
+// Ocupación de las hojas al escribir un índice completo (deja
+// hueco para inserciones posteriores)
+#define PIDX_FILL 0.9
+
+typedef struct {
+    int64_t position;        // Posición del blob en storage
+    uint64_t comp_size;
+    uint64_t orig_size;
+    uint64_t hash[2];        // Hash del contenido (0 si no se conoce)
+} PidxValue;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t page_size;
+    uint32_t root;
+    uint32_t height;         // 1 = la raíz es una hoja
+    uint32_t npages;         // Páginas del archivo (incluida la 0)
+    uint64_t count;          // Llaves en el índice
+    uint32_t nfree;          // Páginas libres listadas tras la cabecera
+    uint32_t reserved[7];
+} PidxHeader;
+
+#define PIDX_MAX_FREE ((PIDX_PAGE_SIZE - sizeof(PidxHeader)) / sizeof(uint32_t))
+
+typedef struct {
+    int fd;
+    const uint8_t *map;      // Proyección de solo lectura
+    size_t map_len;
+    PidxHeader h;
+    uint32_t free_pages[PIDX_MAX_FREE];
+
+    // Estado de una actualización en curso
+    uint32_t *dirty_keys;    // Página -> copia en memoria (hash)
+    uint8_t **dirty_bufs;
+    size_t dirty_cap, dirty_count;
+    uint32_t *freed;         // Páginas sustituidas en esta actualización
+    size_t nfreed, freed_cap;
+    uint32_t next_free;      // Siguiente de free_pages por reutilizar
+} PagedIndex;
+
+bool pidx_open(PagedIndex* px, const char* path);
+void pidx_close(PagedIndex* px);
+bool pidx_lookup(const PagedIndex* px, const char* key, PidxValue* out);
+
+// Recorrido en orden de todas las llaves (hoja a hoja)
+typedef struct {
+    const PagedIndex *px;
+    int depth;
+    uint32_t page[PIDX_MAX_HEIGHT];
+    int slot[PIDX_MAX_HEIGHT];
+    char key[PIDX_KEY_MAX + 1];
+} PidxIter;
+
+void pidx_iter_init(PidxIter* it, const PagedIndex* px);
+// Como pidx_iter_init, pero el recorrido empieza en la primera llave >= key
+void pidx_iter_seek(PidxIter* it, const PagedIndex* px, const char* key);
+// Siguiente llave (en it->key) y su valor; falso al terminar
+bool pidx_iter_next(PidxIter* it, PidxValue* value);
+
+// Escritura completa: las llaves se añaden en orden estrictamente
+// creciente y se escriben secuencialmente en <path>.tmp, que al
+// terminar reemplaza a path
+typedef struct PidxWriter PidxWriter;
+PidxWriter* pidx_writer_create(const char* path);
+bool pidx_writer_add(PidxWriter* w, const char* key, const PidxValue* value);
+bool pidx_writer_finish(PidxWriter* w);  // Libera w
+
+// Actualización incremental de un índice abierto
+bool pidx_put(PagedIndex* px, const char* key, const PidxValue* value);
+bool pidx_remove(PagedIndex* px, const char* key);
+bool pidx_commit(PagedIndex* px);         // Escribe las páginas cambiadas
+void pidx_rollback(PagedIndex* px);       // Descarta los cambios
+
+#endif // PAGEDINDEX_H
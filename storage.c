@@ -0,0 +1,466 @@
+#include "storage.h"
+#include "metrics.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+// Reloj de pared en segundos
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static bool storage_flush(Storage* st);
+static bool commit_locked(Storage* st);
+
+// pwrite completo (reintenta escrituras parciales)
+static bool write_all(int fd, const uint8_t* data, size_t len, uint64_t pos) {
+    while (len > 0) {
+        ssize_t n = pwrite(fd, data, len, (off_t)pos);
+        if (n <= 0) return false;
+        data += n;
+        len -= (size_t)n;
+        pos += (uint64_t)n;
+    }
+    return true;
+}
+
+// pread completo (reintenta lecturas parciales)
+static bool read_all(int fd, uint8_t* out, size_t len, uint64_t pos) {
+    while (len > 0) {
+        ssize_t n = pread(fd, out, len, (off_t)pos);
+        if (n <= 0) return false;
+        out += n;
+        len -= (size_t)n;
+        pos += (uint64_t)n;
+    }
+    return true;
+}
+
+// --------------------------------------------------------
+// Segmentos
+// --------------------------------------------------------
+
+static void segment_path(const Storage* st, uint32_t id, char* out, size_t size) {
+    if (id == 0) snprintf(out, size, "%s", st->path);
+    else snprintf(out, size, "%s.%06u", st->path, id);
+}
+
+// Abre (o crea) el segmento id y lo añade a la tabla
+static bool segment_open(Storage* st, uint32_t id, bool create) {
+    char path[600];
+    segment_path(st, id, path, sizeof(path));
+    int fd = open(path, O_RDWR | (create ? O_CREAT : 0), 0644);
+    if (fd < 0) return false;
+    off_t end = lseek(fd, 0, SEEK_END);
+    if (end >= 0 && id >= st->nsegs) {
+        // Tabla nueva: la anterior se guarda hasta cerrar porque un
+        // lector sin cerrojo puede estar usándola
+        StorageSegment *grown = malloc(sizeof(StorageSegment) * ((size_t)id + 1));
+        StorageSegment **old = realloc(st->old_segs, sizeof(StorageSegment*) * (st->nold + 1));
+        if (old) st->old_segs = old;
+        if (grown && old) {
+            if (st->nsegs) memcpy(grown, st->segs, sizeof(StorageSegment) * st->nsegs);
+            memset(grown + st->nsegs, 0, sizeof(StorageSegment) * (id + 1 - st->nsegs));
+            for (uint32_t i = st->nsegs; i <= id; ++i) grown[i].fd = -1;
+            if (st->segs) st->old_segs[st->nold++] = st->segs;
+            __atomic_store_n(&st->segs, grown, __ATOMIC_RELEASE);
+            __atomic_store_n(&st->nsegs, id + 1, __ATOMIC_RELEASE);
+        } else {
+            free(grown);
+        }
+    }
+    if (end < 0 || id >= st->nsegs) {
+        close(fd);
+        return false;
+    }
+    st->segs[id].size = (uint64_t)end;
+    __atomic_store_n(&st->segs[id].written, (uint64_t)end, __ATOMIC_RELEASE);
+    __atomic_store_n(&st->segs[id].fd, fd, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Segmento id tal como lo ve un lector sin cerrojo (en una tabla que
+// puede ser anterior; entonces written se queda corto y se lee con
+// cerrojo), o NULL
+static const StorageSegment* segment_peek(const Storage* st, uint32_t id) {
+    uint32_t n = __atomic_load_n(&st->nsegs, __ATOMIC_ACQUIRE);
+    const StorageSegment *segs = __atomic_load_n(&st->segs, __ATOMIC_ACQUIRE);
+    return id < n ? &segs[id] : NULL;
+}
+
+static void segment_unmap(StorageSegment* g) {
+    while (g->map) {
+        StorageMap *m = g->map;
+        g->map = m->prev;
+        munmap(m->addr, m->len);
+        free(m);
+    }
+}
+
+// Segmento que contiene [pos, pos + len) completo, o NULL
+static StorageSegment* segment_of(Storage* st, uint64_t pos, uint64_t len) {
+    uint32_t id = STORAGE_SEG(pos);
+    if (id >= st->nsegs || st->segs[id].fd < 0) return NULL;
+    if (STORAGE_OFF(pos) + len > st->segs[id].size) return NULL;
+    return &st->segs[id];
+}
+
+// Busca los segmentos <path>.<n> que ya existen en el directorio
+static void segment_scan(Storage* st) {
+    char dir[512];
+    const char *slash = strrchr(st->path, '/');
+    const char *base = slash ? slash + 1 : st->path;
+    if (slash) snprintf(dir, sizeof(dir), "%.*s", (int)(slash - st->path) + 1, st->path);
+    else snprintf(dir, sizeof(dir), ".");
+    size_t blen = strlen(base);
+
+    DIR *d = opendir(dir);
+    if (!d) return;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        const char *name = e->d_name;
+        if (strncmp(name, base, blen) != 0 || name[blen] != '.') continue;
+        char *end;
+        unsigned long id = strtoul(name + blen + 1, &end, 10);
+        if (end == name + blen + 1 || *end != 0 || id == 0 || id >= UINT32_MAX) continue;
+        segment_open(st, (uint32_t)id, false);
+    }
+    closedir(d);
+}
+
+bool storage_open(Storage* st, const char* path) {
+    memset(st, 0, sizeof(*st));
+    snprintf(st->path, sizeof(st->path), "%s", path);
+    st->buf = malloc(STORAGE_BUF_SIZE);
+    if (!st->buf) return false;
+    pthread_mutex_init(&st->lock, NULL);
+
+    // storage.bin es el segmento 0; solo se crea si no hay ninguno
+    segment_scan(st);
+    if (!segment_open(st, 0, st->nsegs == 0) && st->nsegs == 0) {
+        free(st->buf);
+        st->buf = NULL;
+        free(st->old_segs);
+        pthread_mutex_destroy(&st->lock);
+        return false;
+    }
+    st->active = st->nsegs - 1;
+    st->flushed = st->committed = st->segs[st->active].size;
+    st->buf_cap = STORAGE_BUF_SIZE;
+    st->commit_bytes = STORAGE_COMMIT_BYTES;
+    st->commit_ms = STORAGE_COMMIT_MS;
+    st->last_commit = now_sec();
+    st->use_mmap = true;
+    return true;
+}
+
+void storage_close(Storage* st) {
+    if (!st->segs) return;
+    commit_locked(st);
+    for (uint32_t i = 0; i < st->nsegs; ++i) {
+        segment_unmap(&st->segs[i]);
+        if (st->segs[i].fd >= 0) close(st->segs[i].fd);
+    }
+    free(st->segs);
+    for (uint32_t i = 0; i < st->nold; ++i) free(st->old_segs[i]);
+    free(st->old_segs);
+    free(st->buf);
+    pthread_mutex_destroy(&st->lock);
+    st->segs = NULL;
+    st->nsegs = 0;
+    st->old_segs = NULL;
+    st->nold = 0;
+    st->buf = NULL;
+}
+
+// Avanza lo escrito en el archivo del activo (visible a los lectores)
+static void set_flushed(Storage* st, uint64_t flushed) {
+    st->flushed = flushed;
+    __atomic_store_n(&st->segs[st->active].written, flushed, __ATOMIC_RELEASE);
+}
+
+// Escribe el buffer al archivo sin sincronizar (con lock)
+static bool storage_flush(Storage* st) {
+    if (st->buf_len == 0) return true;
+    if (!write_all(st->segs[st->active].fd, st->buf, st->buf_len, st->flushed)) return false;
+    set_flushed(st, st->flushed + st->buf_len);
+    st->buf_len = 0;
+    return true;
+}
+
+static bool append_locked(Storage* st, const void* data, size_t len) {
+    StorageSegment *a = &st->segs[st->active];
+    if (st->buf_len + len > st->buf_cap && !storage_flush(st)) return false;
+    if (len >= st->buf_cap) {
+        // Escritura mayor que el buffer: directa al archivo
+        if (!write_all(a->fd, data, len, st->flushed)) return false;
+        set_flushed(st, st->flushed + len);
+    } else {
+        memcpy(st->buf + st->buf_len, data, len);
+        st->buf_len += len;
+    }
+    a->size += len;
+    return true;
+}
+
+bool storage_append(Storage* st, const void* data, size_t len) {
+    pthread_mutex_lock(&st->lock);
+    bool ok = append_locked(st, data, len);
+    pthread_mutex_unlock(&st->lock);
+    return ok;
+}
+
+static bool patch_locked(Storage* st, uint64_t pos, const void* data, size_t len) {
+    const uint8_t *p = data;
+    StorageSegment *g = segment_of(st, pos, len);
+    if (!g) return false;
+    uint64_t off = STORAGE_OFF(pos);
+    uint64_t flushed = g == &st->segs[st->active] ? st->flushed : g->size;
+    // Parte ya escrita en el archivo
+    if (off < flushed) {
+        size_t n = off + len <= flushed ? len : (size_t)(flushed - off);
+        if (!write_all(g->fd, p, n, off)) return false;
+        p += n;
+        off += n;
+        len -= n;
+    }
+    // Parte que sigue en el buffer
+    if (len > 0) memcpy(st->buf + (off - st->flushed), p, len);
+    return true;
+}
+
+bool storage_patch(Storage* st, uint64_t pos, const void* data, size_t len) {
+    pthread_mutex_lock(&st->lock);
+    bool ok = patch_locked(st, pos, data, len);
+    pthread_mutex_unlock(&st->lock);
+    return ok;
+}
+
+// Lectura con lock: parte del archivo y parte del buffer
+static bool read_locked(Storage* st, uint64_t pos, void* out, size_t len) {
+    uint8_t *o = out;
+    StorageSegment *g = segment_of(st, pos, len);
+    if (!g) return false;
+    METRIC_ADD(bytes_read, len);
+    uint64_t off = STORAGE_OFF(pos);
+    uint64_t flushed = g == &st->segs[st->active] ? st->flushed : g->size;
+    if (off < flushed) {
+        size_t n = off + len <= flushed ? len : (size_t)(flushed - off);
+        if (!read_all(g->fd, o, n, off)) return false;
+        o += n;
+        off += n;
+        len -= n;
+    }
+    if (len > 0) memcpy(o, st->buf + (off - st->flushed), len);
+    return true;
+}
+
+bool storage_read(Storage* st, uint64_t pos, void* out, size_t len) {
+    // Con la proyección basta una copia, sin llamadas al sistema
+    const uint8_t *p = storage_view(st, pos, len);
+    if (p) {
+        memcpy(out, p, len);
+        return true;
+    }
+    // Lo que ya está en el archivo se lee con pread sin cerrojo
+    const StorageSegment *g = segment_peek(st, STORAGE_SEG(pos));
+    uint64_t off = STORAGE_OFF(pos);
+    if (g) {
+        int fd = __atomic_load_n(&g->fd, __ATOMIC_ACQUIRE);
+        if (fd >= 0 && off + len <= __atomic_load_n(&g->written, __ATOMIC_ACQUIRE)) {
+            METRIC_ADD(bytes_read, len);
+            return read_all(fd, out, len, off);
+        }
+    }
+    pthread_mutex_lock(&st->lock);
+    bool ok = read_locked(st, pos, out, len);
+    pthread_mutex_unlock(&st->lock);
+    return ok;
+}
+
+static bool commit_locked(Storage* st) {
+    StorageSegment *a = &st->segs[st->active];
+    bool ok = storage_flush(st);
+#ifndef _WIN32
+    if (ok && st->sync) ok = fdatasync(a->fd) == 0;
+#endif
+    if (ok) st->committed = a->size;
+    st->last_commit = now_sec();
+    return ok;
+}
+
+bool storage_commit(Storage* st) {
+    pthread_mutex_lock(&st->lock);
+    bool ok = commit_locked(st);
+    pthread_mutex_unlock(&st->lock);
+    return ok;
+}
+
+static bool sync_locked(Storage* st) {
+    bool ok = storage_flush(st);
+#ifndef _WIN32
+    if (ok) ok = fdatasync(st->segs[st->active].fd) == 0;
+#endif
+    if (ok) st->committed = st->segs[st->active].size;
+    return ok;
+}
+
+bool storage_sync(Storage* st) {
+    pthread_mutex_lock(&st->lock);
+    bool ok = sync_locked(st);
+    pthread_mutex_unlock(&st->lock);
+    return ok;
+}
+
+// Cierra el segmento activo (siempre sincronizado: después solo hay
+// que sincronizar el nuevo) y empieza otro
+static bool storage_roll(Storage* st) {
+    if (!sync_locked(st)) return false;
+    st->last_commit = now_sec();
+    uint32_t id = st->nsegs;
+    if (!segment_open(st, id, true)) return false;
+    st->active = id;
+    st->flushed = st->committed = st->segs[id].size;
+    return true;
+}
+
+static bool blob_done_locked(Storage* st) {
+    if (st->segs[st->active].size >= STORAGE_SEGMENT_SIZE) return storage_roll(st);
+    uint64_t pending = st->segs[st->active].size - st->committed;
+    if (pending == 0) return true;
+    if (pending >= st->commit_bytes ||
+        (now_sec() - st->last_commit) * 1000.0 >= (double)st->commit_ms)
+        return commit_locked(st);
+    return true;
+}
+
+bool storage_blob_done(Storage* st) {
+    pthread_mutex_lock(&st->lock);
+    bool ok = blob_done_locked(st);
+    pthread_mutex_unlock(&st->lock);
+    return ok;
+}
+
+void storage_set_commit(Storage* st, size_t bytes, unsigned ms, bool sync) {
+    st->commit_bytes = bytes < st->buf_cap ? bytes : st->buf_cap;
+    st->commit_ms = ms;
+    st->sync = sync;
+}
+
+uint64_t storage_tell(const Storage* st) {
+    return STORAGE_POS(st->active, st->segs[st->active].size);
+}
+
+uint64_t storage_total(const Storage* st) {
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < st->nsegs; ++i) total += st->segs[i].size;
+    return total;
+}
+
+void storage_add_live(Storage* st, uint64_t pos, int64_t delta) {
+    uint32_t id = STORAGE_SEG(pos);
+    if (id < st->nsegs) st->segs[id].live += delta;
+}
+
+void storage_clear_live(Storage* st) {
+    for (uint32_t i = 0; i < st->nsegs; ++i) st->segs[i].live = 0;
+}
+
+bool storage_remove_segment(Storage* st, uint32_t seg) {
+    if (seg >= st->nsegs || seg == st->active || st->segs[seg].fd < 0) return false;
+    StorageSegment *g = &st->segs[seg];
+    char path[600];
+    segment_path(st, seg, path, sizeof(path));
+    pthread_mutex_lock(&st->lock);
+    segment_unmap(g);
+    close(g->fd);
+    __atomic_store_n(&g->fd, -1, __ATOMIC_RELEASE);
+    __atomic_store_n(&g->written, 0, __ATOMIC_RELEASE);
+    g->size = 0;
+    g->live = 0;
+    pthread_mutex_unlock(&st->lock);
+    return unlink(path) == 0;
+}
+
+// Asegura que la proyección del segmento cubra [0, end). Crece al
+// doble (o al menos STORAGE_MAP_MIN) para que los archivos que
+// crecen no se reproyecten en cada lectura; las páginas más allá
+// del final del archivo nunca se tocan.
+static bool segment_map_to(StorageSegment* g, uint64_t end) {
+    if (g->map && end <= g->map->len) return true;
+    uint64_t len = g->map ? (uint64_t)g->map->len * 2 : STORAGE_MAP_MIN;
+    while (len < end) len *= 2;
+    if (len != (size_t)len) return false;
+
+    StorageMap *m = malloc(sizeof(StorageMap));
+    if (!m) return false;
+    void *addr = mmap(NULL, (size_t)len, PROT_READ, MAP_SHARED, g->fd, 0);
+    if (addr == MAP_FAILED) {
+        free(m);
+        return false;
+    }
+    m->addr = addr;
+    m->len = (size_t)len;
+    m->prev = g->map;
+    __atomic_store_n(&g->map, m, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Con lock: el buffer no se puede entregar (cambia al escribir), así
+// que lo que siga en él se vuelca primero al archivo
+static const uint8_t* view_locked(Storage* st, uint64_t pos, size_t len) {
+    StorageSegment *g = segment_of(st, pos, len);
+    if (!g) return NULL;
+    uint64_t off = STORAGE_OFF(pos);
+    if (g == &st->segs[st->active] && off + len > st->flushed && !storage_flush(st)) return NULL;
+    if (!segment_map_to(g, off + len)) return NULL;
+    return g->map->addr + off;
+}
+
+const uint8_t* storage_view(Storage* st, uint64_t pos, size_t len) {
+    if (!__atomic_load_n(&st->use_mmap, __ATOMIC_RELAXED)) return NULL;
+    // Sin cerrojo si el rango ya está en el archivo y proyectado
+    const StorageSegment *g = segment_peek(st, STORAGE_SEG(pos));
+    uint64_t off = STORAGE_OFF(pos);
+    const StorageMap *m = g ? __atomic_load_n(&g->map, __ATOMIC_ACQUIRE) : NULL;
+    const uint8_t *p = NULL;
+    if (m && off + len <= m->len && off + len <= __atomic_load_n(&g->written, __ATOMIC_ACQUIRE)) {
+        p = m->addr + off;
+    } else {
+        pthread_mutex_lock(&st->lock);
+        p = view_locked(st, pos, len);
+        pthread_mutex_unlock(&st->lock);
+    }
+    if (p) METRIC_ADD(bytes_read, len);
+    return p;
+}
+
+void storage_advise(Storage* st, uint64_t pos, uint64_t len, StorageAdvice advice) {
+    const StorageSegment *g = segment_peek(st, STORAGE_SEG(pos));
+    const StorageMap *m = g ? __atomic_load_n(&g->map, __ATOMIC_ACQUIRE) : NULL;
+    if (!m || len == 0) return;
+    // madvise exige una dirección alineada a página
+    uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+    uint64_t off = STORAGE_OFF(pos);
+    uint64_t start = off - off % page;
+    uint64_t end = off + len;
+    if (end > m->len) end = m->len;
+    if (start >= end) return;
+
+    int flag = MADV_NORMAL;
+    switch (advice) {
+        case STORAGE_ADV_NORMAL:     flag = MADV_NORMAL; break;
+        case STORAGE_ADV_SEQUENTIAL: flag = MADV_SEQUENTIAL; break;
+        case STORAGE_ADV_RANDOM:     flag = MADV_RANDOM; break;
+        case STORAGE_ADV_WILLNEED:   flag = MADV_WILLNEED; break;
+        case STORAGE_ADV_DONTNEED:   flag = MADV_DONTNEED; break;
+    }
+    madvise(m->addr + start, (size_t)(end - start), flag);
+}
@@ -0,0 +1,151 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// -------------------------------------------------------
+// Almacenamiento abierto durante toda la vida del FileSystem. Las
+// escrituras se acumulan en un buffer en memoria y el final se
+// lleva en memoria, así que añadir un blob no cuesta ninguna
+// llamada al sistema.
+//
+// Segmentos: los datos se reparten en archivos de unos
+// STORAGE_SEGMENT_SIZE bytes. El segmento 0 es <path> (storage.bin,
+// como en versiones anteriores) y el n es <path>.<n> con seis
+// cifras. Solo se añade al último (el activo); cuando un blob
+// termina y el activo supera el tamaño, se vuelca, se sincroniza y
+// se empieza otro, así que un blob nunca cruza segmentos (uno mayor
+// que el tamaño ocupa un segmento él solo). Una posición es
+// (segmento << STORAGE_SEG_SHIFT) | desplazamiento, de modo que las
+// posiciones de un storage.bin anterior siguen valiendo. Cada
+// segmento lleva la cuenta de sus bytes vivos, que mantiene quien
+// indexa los blobs, para elegir qué segmentos compactar.
+//
+// Group commit: los blobs añadidos se vuelcan juntos cuando lo
+// pendiente supera commit_bytes o pasan commit_ms milisegundos
+// desde el último volcado; con sync además se hace fdatasync.
+// Las lecturas ven también los datos que siguen en el buffer.
+//
+// Lectura con mmap: cada segmento se proyecta en memoria una sola
+// vez y la proyección crece (al doble) cuando el archivo la
+// supera. storage_view devuelve un puntero directo a los datos, sin
+// copias ni llamadas al sistema si las páginas están en caché. Las
+// proyecciones anteriores no se deshacen hasta cerrar (o borrar el
+// segmento), así que los punteros entregados siguen siendo válidos.
+//
+// Hilos: las escrituras son de un solo hilo a la vez (quien las
+// llame las serializa). storage_read, storage_view y storage_advise
+// se pueden llamar desde cualquier hilo a la vez que se escribe: lo
+// que ya está en el archivo se lee con pread (o de la proyección)
+// sin cerrojos; solo lo que sigue en el buffer toma lock, que las
+// escrituras sostienen mientras lo tocan. La tabla de segmentos no
+// se libera al crecer sino al cerrar, y borrar un segmento exige
+// que ningún lector lo esté leyendo.
+// -------------------------------------------------------
+#ifndef STORAGE_SEGMENT_SIZE
+#define STORAGE_SEGMENT_SIZE (64ull * 1024 * 1024)
+#endif
+
+#define STORAGE_SEG_SHIFT 40
+#define STORAGE_SEG(pos) ((uint32_t)((uint64_t)(pos) >> STORAGE_SEG_SHIFT))
+#define STORAGE_OFF(pos) ((uint64_t)(pos) & ((1ull << STORAGE_SEG_SHIFT) - 1))
+#define STORAGE_POS(seg, off) (((uint64_t)(seg) << STORAGE_SEG_SHIFT) | (uint64_t)(off))
+
+typedef struct StorageMap {
+    uint8_t *addr;
+    size_t len;
+    struct StorageMap *prev; // Proyección anterior (más pequeña)
+} StorageMap;
+
+typedef enum {
+    STORAGE_ADV_NORMAL,
+    STORAGE_ADV_SEQUENTIAL,  // Lectura secuencial (exportaciones masivas)
+    STORAGE_ADV_RANDOM,      // Lecturas sueltas sin lectura anticipada
+    STORAGE_ADV_WILLNEED,    // Precargar el rango
+    STORAGE_ADV_DONTNEED     // El rango ya no se va a usar
+} StorageAdvice;
+
+typedef struct {
+    int fd;                  // -1 si el segmento no existe
+    uint64_t size;           // Tamaño (en el activo incluye lo pendiente)
+    uint64_t written;        // Bytes que ya están en el archivo
+    int64_t live;            // Bytes de blobs vivos
+    StorageMap *map;         // Proyección actual (NULL si no hay)
+} StorageSegment;
+
+typedef struct {
+    char path[512];          // Ruta del segmento 0
+    StorageSegment *segs;    // Indexados por número de segmento
+    uint32_t nsegs;
+    StorageSegment **old_segs; // Tablas anteriores (algún lector puede seguir en ellas)
+    uint32_t nold;
+    pthread_mutex_t lock;    // Buffer de escritura frente a los lectores
+    uint32_t active;         // Segmento al que se añade
+    uint64_t flushed;        // Bytes del activo ya escritos en su archivo
+    uint64_t committed;      // Tamaño del activo en el último volcado
+    uint8_t *buf;            // Datos pendientes desde flushed
+    size_t buf_len;
+    size_t buf_cap;
+
+    size_t commit_bytes;     // Umbral de bytes pendientes
+    unsigned commit_ms;      // Umbral de tiempo desde el último volcado
+    bool sync;               // fdatasync en cada volcado
+    double last_commit;      // Momento del último volcado
+
+    bool use_mmap;           // Leer a través de la proyección
+} Storage;
+
+#define STORAGE_BUF_SIZE (4 * 1024 * 1024)
+#define STORAGE_COMMIT_BYTES (1024 * 1024)
+#define STORAGE_COMMIT_MS 100
+#define STORAGE_MAP_MIN (64 * 1024 * 1024)
+
+bool storage_open(Storage* st, const char* path);
+void storage_close(Storage* st);
+
+// Añade datos al final; devuelve falso si falla la escritura
+bool storage_append(Storage* st, const void* data, size_t len);
+
+// Sobrescribe datos ya añadidos (p. ej. el tamaño delante de un blob)
+bool storage_patch(Storage* st, uint64_t pos, const void* data, size_t len);
+
+// Lee len bytes desde pos, estén ya en el archivo o en el buffer
+// (el rango debe estar dentro de un segmento)
+bool storage_read(Storage* st, uint64_t pos, void* out, size_t len);
+
+// Marca el final de un blob y vuelca si se supera algún umbral
+bool storage_blob_done(Storage* st);
+
+// Vuelca el buffer (y hace fdatasync si sync está activo)
+bool storage_commit(Storage* st);
+
+// Vuelca el buffer y hace fdatasync aunque sync esté desactivado
+bool storage_sync(Storage* st);
+
+void storage_set_commit(Storage* st, size_t bytes, unsigned ms, bool sync);
+
+// Posición que tendrá el siguiente byte añadido
+uint64_t storage_tell(const Storage* st);
+
+// Bytes de todos los segmentos
+uint64_t storage_total(const Storage* st);
+
+// Ajusta los bytes vivos del segmento de pos (delta negativo al
+// dejar de usar un blob); storage_clear_live los pone a cero
+void storage_add_live(Storage* st, uint64_t pos, int64_t delta);
+void storage_clear_live(Storage* st);
+
+// Borra un segmento que ya no es el activo (cierra y deshace sus
+// proyecciones y borra el archivo)
+bool storage_remove_segment(Storage* st, uint32_t seg);
+
+// Puntero de solo lectura a [pos, pos + len) o NULL si el modo mmap
+// está desactivado o la proyección falla (usar storage_read)
+const uint8_t* storage_view(Storage* st, uint64_t pos, size_t len);
+
+// Consejo de acceso para el rango [pos, pos + len) de la proyección
+void storage_advise(Storage* st, uint64_t pos, uint64_t len, StorageAdvice advice);
+
+#endif // STORAGE_H
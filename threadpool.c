@@ -0,0 +1,132 @@
+#include "threadpool.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Tarea pendiente en la cola
+typedef struct Task {
+    tp_task fn;
+    void *arg;
+    TpGroup *group;           // NULL si no es de ningún grupo
+    struct Task *next;
+} Task;
+
+struct ThreadPool {
+    pthread_t *threads;
+    int nthreads;
+    Task *head, *tail;        // Cola de tareas pendientes
+    int pending;              // Tareas enviadas y aún no terminadas
+    int stop;                 // Señal de cierre
+    pthread_mutex_t lock;
+    pthread_cond_t has_work;  // Hay tareas en la cola o hay que cerrar
+    pthread_cond_t done;      // pending llegó a 0
+};
+
+// Bucle de cada hilo: toma tareas de la cola hasta que se cierre el pool
+static void* worker(void* arg) {
+    ThreadPool *tp = arg;
+    pthread_mutex_lock(&tp->lock);
+    while (1) {
+        while (!tp->head && !tp->stop) pthread_cond_wait(&tp->has_work, &tp->lock);
+        if (!tp->head) break;
+
+        Task *t = tp->head;
+        tp->head = t->next;
+        if (!tp->head) tp->tail = NULL;
+        pthread_mutex_unlock(&tp->lock);
+
+        t->fn(t->arg);
+        TpGroup *g = t->group;
+        free(t);
+
+        pthread_mutex_lock(&tp->lock);
+        int last = --tp->pending == 0;
+        if (g && --g->pending == 0) last = 1;
+        if (last) pthread_cond_broadcast(&tp->done);
+    }
+    pthread_mutex_unlock(&tp->lock);
+    return NULL;
+}
+
+ThreadPool* tp_create(int nthreads) {
+    if (nthreads < 1) nthreads = 1;
+    ThreadPool *tp = calloc(1, sizeof(ThreadPool));
+    if (!tp) return NULL;
+    tp->threads = malloc(sizeof(pthread_t) * nthreads);
+    if (!tp->threads) {
+        free(tp);
+        return NULL;
+    }
+    pthread_mutex_init(&tp->lock, NULL);
+    pthread_cond_init(&tp->has_work, NULL);
+    pthread_cond_init(&tp->done, NULL);
+    for (int i = 0; i < nthreads; ++i) {
+        if (pthread_create(&tp->threads[i], NULL, worker, tp) != 0) break;
+        tp->nthreads++;
+    }
+    if (tp->nthreads == 0) {
+        tp_destroy(tp);
+        return NULL;
+    }
+    return tp;
+}
+
+void tp_submit_group(ThreadPool* tp, TpGroup* g, tp_task fn, void* arg) {
+    Task *t = malloc(sizeof(Task));
+    if (!t) {
+        fn(arg); // Sin memoria: ejecutar en el hilo actual
+        return;
+    }
+    t->fn = fn;
+    t->arg = arg;
+    t->group = g;
+    t->next = NULL;
+    pthread_mutex_lock(&tp->lock);
+    if (tp->tail) tp->tail->next = t;
+    else tp->head = t;
+    tp->tail = t;
+    tp->pending++;
+    if (g) g->pending++;
+    pthread_cond_signal(&tp->has_work);
+    pthread_mutex_unlock(&tp->lock);
+}
+
+void tp_submit(ThreadPool* tp, tp_task fn, void* arg) {
+    tp_submit_group(tp, NULL, fn, arg);
+}
+
+void tp_wait(ThreadPool* tp) {
+    pthread_mutex_lock(&tp->lock);
+    while (tp->pending > 0) pthread_cond_wait(&tp->done, &tp->lock);
+    pthread_mutex_unlock(&tp->lock);
+}
+
+void tp_wait_group(ThreadPool* tp, TpGroup* g) {
+    pthread_mutex_lock(&tp->lock);
+    while (g->pending > 0) pthread_cond_wait(&tp->done, &tp->lock);
+    pthread_mutex_unlock(&tp->lock);
+}
+
+int tp_size(ThreadPool* tp) {
+    return tp->nthreads;
+}
+
+void tp_destroy(ThreadPool* tp) {
+    if (!tp) return;
+    pthread_mutex_lock(&tp->lock);
+    tp->stop = 1;
+    pthread_cond_broadcast(&tp->has_work);
+    pthread_mutex_unlock(&tp->lock);
+    for (int i = 0; i < tp->nthreads; ++i) pthread_join(tp->threads[i], NULL);
+
+    pthread_mutex_destroy(&tp->lock);
+    pthread_cond_destroy(&tp->has_work);
+    pthread_cond_destroy(&tp->done);
+    free(tp->threads);
+    free(tp);
+}
+
+int tp_cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
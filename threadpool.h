@@ -0,0 +1,30 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+// -------------------------------------------------------
+// Pool fijo de hilos con una cola FIFO de tareas.
+// tp_wait bloquea hasta que todas las tareas enviadas terminen.
+// Si varios hilos comparten el pool, cada uno espera solo a las
+// suyas enviándolas con un TpGroup.
+// -------------------------------------------------------
+typedef void (*tp_task)(void* arg);
+
+typedef struct ThreadPool ThreadPool;
+
+ThreadPool* tp_create(int nthreads);
+void tp_submit(ThreadPool* tp, tp_task fn, void* arg);
+void tp_wait(ThreadPool* tp);
+
+// Tareas de un mismo hilo: tp_wait_group espera solo a las de g
+typedef struct {
+    int pending;
+} TpGroup;
+void tp_submit_group(ThreadPool* tp, TpGroup* g, tp_task fn, void* arg);
+void tp_wait_group(ThreadPool* tp, TpGroup* g);
+int tp_size(ThreadPool* tp);
+void tp_destroy(ThreadPool* tp);
+
+// Cantidad de núcleos disponibles (al menos 1)
+int tp_cpu_count(void);
+
+#endif // THREADPOOL_H
@@ -4,182 +4,745 @@
 #include <stdio.h>
 
 // Función auxiliar: número máximo de llaves que puede tener un nodo
-static int max_keys() { return 2 * BTREE_T - 1; }
+static int max_keys(const BTree* tree) { return 2 * tree->t - 1; }
 
 // Función auxiliar: número máximo de hijos que puede tener un nodo
-static int max_children() { return 2 * BTREE_T; }
+static int max_children(const BTree* tree) { return 2 * tree->t; }
 
-// Asigna memoria para un nuevo nodo BTree
-static BTreeNode* allocate_node(bool leaf) {
-    BTreeNode* node = malloc(sizeof(BTreeNode));
+// --------------------------------------------------------
+// Arena de llaves
+// --------------------------------------------------------
+
+// Copia key al arena y devuelve su desplazamiento (UINT32_MAX si no cabe)
+static uint32_t arena_add(KeyArena* a, const char* key, size_t len) {
+    if (a->nchunks == 0 || a->used + len + 1 > BTREE_ARENA_CHUNK) {
+        if (a->nchunks == BTREE_ARENA_MAX_CHUNKS) return UINT32_MAX;
+        char *chunk = malloc(BTREE_ARENA_CHUNK);
+        if (!chunk) return UINT32_MAX;
+        a->chunks[a->nchunks++] = chunk;
+        a->used = 0;
+    }
+    uint32_t off = ((a->nchunks - 1) << 20) | a->used;
+    memcpy(a->chunks[a->nchunks - 1] + a->used, key, len + 1);
+    a->used += (uint32_t)len + 1;
+    return off;
+}
+
+static const char* arena_key(const KeyArena* a, uint32_t off) {
+    return a->chunks[off >> 20] + (off & (BTREE_ARENA_CHUNK - 1));
+}
+
+static void arena_free(KeyArena* a) {
+    for (uint32_t i = 0; i < a->nchunks; ++i) free(a->chunks[i]);
+    a->nchunks = 0;
+}
+
+// Primeros 4 bytes de la llave como entero big-endian (con ceros
+// tras el final), de modo que comparar prefijos como enteros da el
+// mismo orden que strcmp
+static uint32_t key_prefix(const char* key) {
+    uint32_t p = 0;
+    int i = 0;
+    for (; i < 4 && key[i]; ++i) p = (p << 8) | (uint8_t)key[i];
+    return i ? p << (8 * (4 - i)) : 0;  // Desplazar 32 bits no está definido
+}
+
+// Compara key (de prefijo kp tras los x->lcp bytes comunes) con la
+// llave i del nodo x. Solo se llega a strcmp si los prefijos
+// coinciden y son de 4 bytes.
+static int compare_key(const BTree* tree, const BTreeNode* x, int i, const char* key, uint32_t kp) {
+    uint32_t p = x->prefix[i];
+    if (kp != p) return kp < p ? -1 : 1;
+    if ((kp & 0xFF) == 0) return 0;  // Las dos terminan dentro del prefijo
+    return strcmp(key + x->lcp + 4, arena_key(&tree->arena, x->keys[i]) + x->lcp + 4);
+}
+
+// Recalcula el prefijo común del nodo (el de su primera y su última
+// llave, que están ordenadas) y los prefijos de todas las llaves
+static void node_refresh(const BTree* tree, BTreeNode* x) {
+    if (x->n == 0) {
+        x->lcp = 0;
+        return;
+    }
+    const char *first = arena_key(&tree->arena, x->keys[0]);
+    const char *last = arena_key(&tree->arena, x->keys[x->n - 1]);
+    int l = 0;
+    while (first[l] && first[l] == last[l]) l++;
+    x->lcp = (uint16_t)l;
+    for (int i = 0; i < x->n; ++i)
+        x->prefix[i] = key_prefix(arena_key(&tree->arena, x->keys[i]) + l);
+}
+
+// Búsqueda binaria en un nodo: índice de la primera llave >= key;
+// *found indica si es igual. Si key no empieza por el prefijo común
+// del nodo queda antes o después de todas sus llaves.
+static int node_find(const BTree* tree, const BTreeNode* x, const char* key, bool* found) {
+    *found = false;
+    if (x->n == 0) return 0;
+    if (x->lcp > 0) {
+        int c = strncmp(key, arena_key(&tree->arena, x->keys[0]), x->lcp);
+        if (c != 0) return c < 0 ? 0 : x->n;
+    }
+    uint32_t kp = key_prefix(key + x->lcp);
+    int lo = 0, hi = x->n;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        int c = compare_key(tree, x, mid, key, kp);
+        if (c > 0) lo = mid + 1;
+        else if (c < 0) hi = mid;
+        else {
+            *found = true;
+            return mid;
+        }
+    }
+    return lo;
+}
+
+// Coloca en la posición i (ya libre) de x la llave off, con su valor
+static void node_put(const BTree* tree, BTreeNode* x, int i, uint32_t off, const BTreeValue* value) {
+    x->keys[i] = off;
+    x->values[i] = *value;
+    x->n += 1;
+    // Una llave en un extremo puede acortar el prefijo común
+    if (i == 0 || i == x->n - 1) node_refresh(tree, x);
+    else x->prefix[i] = key_prefix(arena_key(&tree->arena, off) + x->lcp);
+}
+
+// --------------------------------------------------------
+// Nodos
+// --------------------------------------------------------
+
+// Bytes del bloque de un nodo; las hojas no reservan hijos
+static size_t node_size(const BTree* tree, bool leaf) {
+    int mk = max_keys(tree);
+    int mc = leaf ? 0 : max_children(tree);
+    return sizeof(BTreeNode) + sizeof(BTreeNode*) * mc + sizeof(BTreeValue) * mk +
+           2 * sizeof(uint32_t) * mk;
+}
+
+// Reparte el bloque de node entre sus arreglos
+static void node_layout(const BTree* tree, BTreeNode* node) {
+    int mk = max_keys(tree);
+    char *p = (char*)(node + 1);
+    node->C = node->leaf ? NULL : (BTreeNode**)p;            // Punteros a hijos
+    if (!node->leaf) p += sizeof(BTreeNode*) * max_children(tree);
+    node->values = (BTreeValue*)p;                           // Valores asociados a las llaves
+    p += sizeof(BTreeValue) * mk;
+    node->prefix = (uint32_t*)p;                             // Prefijos de las llaves
+    node->keys = node->prefix + mk;                          // Desplazamientos en el arena
+}
+
+// Asigna un nodo en un solo bloque
+static BTreeNode* allocate_node(const BTree* tree, bool leaf) {
+    BTreeNode* node = malloc(node_size(tree, leaf));
+    if (!node) return NULL;
     node->n = 0;               // Inicialmente sin llaves
+    node->lcp = 0;
     node->leaf = leaf;         // Si es hoja o no
-    node->keys = malloc(sizeof(*node->keys) * max_keys());       // Arreglo de llaves
-    node->positions = malloc(sizeof(long) * max_keys());         // Posiciones asociadas a las llaves
-    node->C = malloc(sizeof(BTreeNode*) * max_children());       // Punteros a hijos
-    for (int i = 0; i < max_children(); ++i) node->C[i] = NULL;  // Inicializa hijos como NULL
+    node->gen = tree->gen;
+    node_layout(tree, node);
+    if (!leaf)
+        for (int i = 0; i < max_children(tree); ++i) node->C[i] = NULL; // Inicializa hijos como NULL
     return node;
 }
 
+// --------------------------------------------------------
+// Copia de caminos. Con lectores concurrentes un nodo publicado (de
+// una escritura anterior) no se toca: la primera vez que la
+// escritura en curso va a cambiarlo se copia, *slot (en un nodo que
+// ya es suyo o la raíz que va a publicar) pasa a apuntar a la copia
+// y el original se retira. Sin lectores se modifica en su sitio.
+// --------------------------------------------------------
+static BTreeNode* node_own(BTree* tree, BTreeNode** slot) {
+    BTreeNode *x = *slot;
+    if (!tree->retire || x->gen == tree->gen) return x;
+    size_t size = node_size(tree, x->leaf);
+    BTreeNode *copy = malloc(size);
+    if (!copy) return NULL;
+    memcpy(copy, x, size);
+    node_layout(tree, copy);
+    copy->gen = tree->gen;
+    *slot = copy;
+    tree->retire(tree->retire_user, x);
+    return copy;
+}
+
+// Nodo que sale del árbol
+static void node_drop(BTree* tree, BTreeNode* x) {
+    if (tree->retire) tree->retire(tree->retire_user, x);
+    else free(x);
+}
+
+static const BTreeNode* tree_root(const BTree* tree) {
+    return __atomic_load_n(&tree->root, __ATOMIC_ACQUIRE);
+}
+
+// Empieza una escritura: lo que cree o copie será suyo
+static void write_begin(BTree* tree) {
+    if (tree->retire) tree->gen++;
+}
+
+// Termina una escritura: los lectores pasan a ver la raíz nueva
+static void write_end(BTree* tree, BTreeNode* root) {
+    __atomic_store_n(&tree->root, root, __ATOMIC_RELEASE);
+}
+
+void btree_share(BTree* tree, btree_retire retire, void* user) {
+    tree->retire = retire;
+    tree->retire_user = user;
+}
+
+static void free_node(BTreeNode* x) {
+    if (!x) return;
+    if (!x->leaf)
+        for (int i = 0; i <= x->n; ++i) free_node(x->C[i]);
+    free(x);
+}
+
+// Mueve count entradas (llave, prefijo y valor) de from a to
+static void move_entries(BTreeNode* dst, int to, const BTreeNode* src, int from, int count) {
+    memmove(dst->prefix + to, src->prefix + from, sizeof(uint32_t) * count);
+    memmove(dst->keys + to, src->keys + from, sizeof(uint32_t) * count);
+    memmove(dst->values + to, src->values + from, sizeof(BTreeValue) * count);
+}
+
 // Crear un nuevo árbol B vacío (raíz hoja)
-BTreeNode* btree_create() {
-    return allocate_node(true);
+BTree* btree_create(int t) {
+    BTree* tree = calloc(1, sizeof(BTree));
+    if (!tree) return NULL;
+    tree->t = t >= 2 ? t : BTREE_T;
+    tree->root = allocate_node(tree, true);
+    if (!tree->root) {
+        free(tree);
+        return NULL;
+    }
+    return tree;
+}
+
+void btree_destroy(BTree* tree) {
+    if (!tree) return;
+    free_node(tree->root);
+    arena_free(&tree->arena);
+    free(tree);
+}
+
+// Valor de una clave o NULL si no existe
+static const BTreeValue* find_value(const BTree* tree, const char* key) {
+    const BTreeNode* x = tree_root(tree);
+    while (x) {
+        bool found;
+        int i = node_find(tree, x, key, &found);
+        if (found) return &x->values[i];
+        // Si es hoja y no está, no existe
+        if (x->leaf) return NULL;
+        x = x->C[i];
+    }
+    return NULL;
 }
 
 // Buscar una clave en el árbol, devuelve su posición o -1 si no existe
-long btree_search(BTreeNode* x, const char* key) {
-    if (!x) return -1;
-    int i = 0;
-    // Avanzar hasta encontrar clave >= key
-    while (i < x->n && strcmp(key, x->keys[i]) > 0) i++;
+long btree_search(const BTree* tree, const char* key) {
+    const BTreeValue *v = find_value(tree, key);
+    return v ? v->position : -1;
+}
+
+bool btree_get(const BTree* tree, const char* key, BTreeValue* out) {
+    const BTreeValue *v = find_value(tree, key);
+    if (v) *out = *v;
+    return v != NULL;
+}
 
-    // Si la encontramos, devolver su posición
-    if (i < x->n && strcmp(key, x->keys[i]) == 0)
-        return x->positions[i];
+// --------------------------------------------------------
+// Carga masiva
+// --------------------------------------------------------
 
-    // Si es hoja y no está, no existe
-    if (x->leaf)
-        return -1;
+#define BULK_MAX_LEVELS 64
 
-    // Buscar recursivamente en el hijo correspondiente
-    return btree_search(x->C[i], key);
+typedef struct {
+    BTree *tree;
+    btree_source next;
+    void *user;
+    int levels;
+    size_t nodes[BULK_MAX_LEVELS];  // Nodos de cada nivel (0 = hojas)
+    size_t keys[BULK_MAX_LEVELS];   // Llaves de cada nivel
+    size_t done[BULK_MAX_LEVELS];   // Nodos ya construidos por nivel
+    const char *last;               // Última llave leída
+    BTreeNode **all;                // Nodos creados (para liberar si falla)
+    size_t nall;
+} Bulk;
+
+// Lee la siguiente llave del flujo y la coloca en la posición i de x
+static bool bulk_key(Bulk* b, BTreeNode* x, int i) {
+    const char *key;
+    BTreeValue value;
+    if (!b->next(b->user, &key, &value)) return false;
+    size_t len = strlen(key);
+    if (len > BTREE_KEY_MAX || (b->last && strcmp(b->last, key) >= 0)) return false;
+    uint32_t off = arena_add(&b->tree->arena, key, len);
+    if (off == UINT32_MAX) return false;
+    b->last = arena_key(&b->tree->arena, off);
+    x->keys[i] = off;
+    x->values[i] = value;
+    return true;
 }
 
-// Divide un hijo lleno en dos nodos y sube la clave del medio al padre
-void btree_split_child(BTreeNode* x, int i, BTreeNode* y) {
-    BTreeNode* z = allocate_node(y->leaf); // Nuevo nodo que recibirá la mitad de las llaves
-    int t = BTREE_T;
+// Construye en orden el siguiente nodo del nivel h y su subárbol.
+// Las llaves del nivel se reparten a partes iguales entre sus nodos.
+static BTreeNode* bulk_node(Bulk* b, int h) {
+    size_t j = b->done[h]++;
+    int c = (int)(b->keys[h] / b->nodes[h] + (j < b->keys[h] % b->nodes[h]));
+    BTreeNode *x = allocate_node(b->tree, h == 0);
+    if (!x) return NULL;
+    b->all[b->nall++] = x;
+    for (int i = 0; i <= c; ++i) {
+        if (h > 0 && !(x->C[i] = bulk_node(b, h - 1))) return NULL;
+        if (i < c && !bulk_key(b, x, i)) return NULL;
+    }
+    x->n = c;
+    node_refresh(b->tree, x);
+    return x;
+}
 
-    // Copiar las llaves superiores de y a z
-    z->n = t - 1;
-    for (int j = 0; j < t - 1; ++j) {
-        strcpy(z->keys[j], y->keys[j + t]);
-        z->positions[j] = y->positions[j + t];
+BTree* btree_bulk_load(int t, size_t n, double fill, btree_source next, void* user) {
+    BTree *tree = btree_create(t);
+    if (!tree || n == 0) return tree;
+    t = tree->t;
+
+    // Llaves por nodo deseadas, sin bajar del mínimo t - 1
+    int target = (int)(fill * (2 * t - 1) + 0.5);
+    if (target > 2 * t - 1) target = 2 * t - 1;
+    if (target < t - 1) target = t - 1;
+
+    // Hojas: cada una con su separador consume unas target + 1
+    // llaves; todas deben tener al menos t - 1
+    Bulk b;
+    memset(&b, 0, sizeof(b));
+    b.tree = tree;
+    b.next = next;
+    b.user = user;
+    size_t count = (n + 1 + target) / (target + 1);
+    if (count > (n + 1) / t) count = (n + 1) / t;
+    if (count == 0) count = 1;
+    b.nodes[0] = count;
+    b.keys[0] = n - (count - 1);
+    size_t total = count;
+
+    // Niveles internos: unos target + 1 hijos por nodo y al menos t
+    // (la raíz puede tener menos)
+    int h = 0;
+    while (b.nodes[h] > 1 && h + 1 < BULK_MAX_LEVELS) {
+        size_t children = b.nodes[h];
+        count = (children + target) / (target + 1);
+        if (count > children / t) count = children / t;
+        if (count == 0) count = 1;
+        h++;
+        b.nodes[h] = count;
+        b.keys[h] = children - count;
+        total += count;
     }
+    b.levels = h + 1;
 
-    // Copiar hijos si no es hoja
-    if (!y->leaf) {
-        for (int j = 0; j < t; ++j) {
-            z->C[j] = y->C[j + t];
-            y->C[j + t] = NULL;
-        }
+    b.all = malloc(sizeof(BTreeNode*) * total);
+    BTreeNode *root = b.all ? bulk_node(&b, h) : NULL;
+    if (!root) {
+        // Liberar lo construido (los hijos se sueltan a mano)
+        for (size_t i = 0; b.all && i < b.nall; ++i) free(b.all[i]);
+        free(b.all);
+        btree_destroy(tree);
+        return NULL;
     }
+    free(b.all);
+    free_node(tree->root);
+    tree->root = root;
+    tree->count = n;
+    return tree;
+}
+
+// Divide el hijo lleno y = x->C[i] en dos nodos y sube la llave del
+// medio al padre (x ya es de esta escritura)
+static bool btree_split_child(BTree* tree, BTreeNode* x, int i) {
+    BTreeNode* z = allocate_node(tree, x->C[i]->leaf); // Nuevo nodo que recibirá la mitad de las llaves
+    if (!z) return false;
+    BTreeNode* y = node_own(tree, &x->C[i]);
+    if (!y) {
+        free(z);
+        return false;
+    }
+    int t = tree->t;
 
-    // Reducir número de llaves
+    // Copiar las llaves superiores (y los hijos) de y a z
+    z->n = t - 1;
+    move_entries(z, 0, y, t, t - 1);
+    if (!y->leaf) memcpy(z->C, y->C + t, sizeof(BTreeNode*) * t);
     y->n = t - 1;
+    node_refresh(tree, y);
+    node_refresh(tree, z);
 
-    // Mover punteros de hijos en x para insertar z
-    for (int j = x->n; j >= i + 1; --j)
-        x->C[j + 1] = x->C[j];
+    // Hacer hueco en x para z y la llave del medio
+    memmove(x->C + i + 2, x->C + i + 1, sizeof(BTreeNode*) * (x->n - i));
     x->C[i + 1] = z;
-
-    // Mover llaves en x para insertar la clave del medio
-    for (int j = x->n - 1; j >= i; --j) {
-        strcpy(x->keys[j + 1], x->keys[j]);
-        x->positions[j + 1] = x->positions[j];
-    }
-
-    // Insertar clave del medio de y en x
-    strcpy(x->keys[i], y->keys[t - 1]);
-    x->positions[i] = y->positions[t - 1];
-    x->n += 1;
+    move_entries(x, i + 1, x, i, x->n - i);
+    node_put(tree, x, i, y->keys[t - 1], &y->values[t - 1]);
+    return true;
 }
 
-// Inserta una clave en un nodo no lleno
-void btree_insert_nonfull(BTreeNode* x, const char* k, long pos) {
-    int i = x->n - 1;
+// Inserta una llave en el árbol (con manejo de raíz llena y
+// actualización de valores). Se baja una sola vez dividiendo por el
+// camino los nodos llenos; si la llave ya existe solo se actualiza.
+// Si falla, el árbol sigue siendo válido (las divisiones hechas no
+// cambian su contenido).
+static bool insert_key(BTree* tree, BTreeNode** root, const char* key, size_t len,
+                       const BTreeValue* value) {
+    // Si la raíz está llena, dividir y crear nueva raíz
+    if ((*root)->n == max_keys(tree)) {
+        BTreeNode* s = allocate_node(tree, false);
+        if (!s) return false;
+        s->C[0] = *root;
+        if (!btree_split_child(tree, s, 0)) {
+            free(s);
+            return false;
+        }
+        *root = s;
+    }
 
-    if (x->leaf) {
-        // Mover llaves hacia la derecha hasta encontrar lugar
-        while (i >= 0 && strcmp(k, x->keys[i]) < 0) {
-            strcpy(x->keys[i + 1], x->keys[i]);
-            x->positions[i + 1] = x->positions[i];
-            i--;
+    BTreeNode* x = node_own(tree, root);
+    if (!x) return false;
+    while (1) {
+        bool found;
+        int i = node_find(tree, x, key, &found);
+        if (found) {
+            x->values[i] = *value;
+            return true;
         }
-        // Insertar nueva clave
-        strcpy(x->keys[i + 1], k);
-        x->positions[i + 1] = pos;
-        x->n += 1;
-    } else {
-        // Encontrar hijo donde insertar
-        while (i >= 0 && strcmp(k, x->keys[i]) < 0) i--;
-        i++;
-
-        // Si el hijo está lleno, dividirlo
-        if (x->C[i]->n == max_keys()) {
-            btree_split_child(x, i, x->C[i]);
-            if (strcmp(k, x->keys[i]) > 0) i++;
+        if (x->leaf) {
+            // Insertar nueva llave
+            uint32_t off = arena_add(&tree->arena, key, len);
+            if (off == UINT32_MAX) return false;
+            move_entries(x, i + 1, x, i, x->n - i);
+            node_put(tree, x, i, off, value);
+            tree->count++;
+            return true;
         }
-        // Insertar en el hijo correspondiente
-        btree_insert_nonfull(x->C[i], k, pos);
+
+        // Si el hijo está lleno, dividirlo; la llave que sube puede
+        // ser la buscada
+        if (x->C[i]->n == max_keys(tree)) {
+            if (!btree_split_child(tree, x, i)) return false;
+            i = node_find(tree, x, key, &found);
+            if (found) {
+                x->values[i] = *value;
+                return true;
+            }
+        }
+        // Continuar en el hijo correspondiente
+        x = node_own(tree, &x->C[i]);
+        if (!x) return false;
     }
 }
 
-// Inserta una clave en el árbol (con manejo de raíz llena y actualización de valores)
-void btree_insert(BTreeNode** root_ref, const char* key, long position) {
-    BTreeNode* r = *root_ref;
+bool btree_insert(BTree* tree, const char* key, const BTreeValue* value) {
+    size_t len = strlen(key);
+    if (len > BTREE_KEY_MAX) return false;
+    write_begin(tree);
+    BTreeNode *root = tree->root;
+    bool ok = insert_key(tree, &root, key, len, value);
+    write_end(tree, root);
+    return ok;
+}
+
+// --------------------------------------------------------
+// Borrado (CLRS): se baja una sola vez desde la raíz y, antes de
+// entrar en un hijo, se asegura que tenga al menos t llaves pidiendo
+// una a un hermano o fusionándolo con él. Así la llave se puede
+// quitar de una hoja sin dejar ningún nodo por debajo del mínimo.
+// --------------------------------------------------------
 
-    // Si la clave ya existe, solo actualiza su posición
-    if (btree_search(r, key) != -1) {
-        BTreeNode* node = r;
-        int i = 0;
-        while (1) {
-            while (i < node->n && strcmp(key, node->keys[i]) > 0) i++;
-            if (i < node->n && strcmp(key, node->keys[i]) == 0) {
-                node->positions[i] = position;
-                return;
-            }
-            if (node->leaf) break;
-            node = node->C[i];
-            i = 0;
-        }
-        return;
+// Coloca en la posición i de x la llave off con su valor, sin mover
+// las demás
+static void node_set(const BTree* tree, BTreeNode* x, int i, uint32_t off, const BTreeValue* value) {
+    x->keys[i] = off;
+    x->values[i] = *value;
+    if (i == 0 || i == x->n - 1) node_refresh(tree, x);
+    else x->prefix[i] = key_prefix(arena_key(&tree->arena, off) + x->lcp);
+}
+
+// Quita la entrada i de x (y, si es interno, el hijo i + 1)
+static void node_remove(const BTree* tree, BTreeNode* x, int i) {
+    move_entries(x, i, x, i + 1, x->n - i - 1);
+    if (!x->leaf) memmove(x->C + i + 1, x->C + i + 2, sizeof(BTreeNode*) * (x->n - i - 1));
+    x->n -= 1;
+    // Sin un extremo el prefijo común puede alargarse
+    if (i == 0 || i == x->n) node_refresh(tree, x);
+}
+
+// Fusiona y = x->C[i], la llave i de x y z = x->C[i + 1] en y, y
+// libera z (y ya es de esta escritura)
+static void merge_children(BTree* tree, BTreeNode* x, int i) {
+    BTreeNode *y = x->C[i], *z = x->C[i + 1];
+    move_entries(y, y->n, x, i, 1);
+    move_entries(y, y->n + 1, z, 0, z->n);
+    if (!y->leaf) memcpy(y->C + y->n + 1, z->C, sizeof(BTreeNode*) * (z->n + 1));
+    y->n += z->n + 1;
+    node_refresh(tree, y);
+    node_remove(tree, x, i);
+    node_drop(tree, z);
+}
+
+// Pasa a x->C[i] la llave i - 1 de x, que se repone con la última
+// del hermano izquierdo
+static void borrow_left(const BTree* tree, BTreeNode* x, int i) {
+    BTreeNode *c = x->C[i], *l = x->C[i - 1];
+    move_entries(c, 1, c, 0, c->n);
+    move_entries(c, 0, x, i - 1, 1);
+    if (!c->leaf) {
+        memmove(c->C + 1, c->C, sizeof(BTreeNode*) * (c->n + 1));
+        c->C[0] = l->C[l->n];
     }
+    c->n += 1;
+    node_refresh(tree, c);
+    node_set(tree, x, i - 1, l->keys[l->n - 1], &l->values[l->n - 1]);
+    l->n -= 1;
+    node_refresh(tree, l);
+}
 
-    // Si la raíz está llena, dividir y crear nueva raíz
-    if (r->n == max_keys()) {
-        BTreeNode* s = allocate_node(false);
-        *root_ref = s;
-        s->C[0] = r;
-        btree_split_child(s, 0, r);
-        btree_insert_nonfull(s, key, position);
+// Pasa a x->C[i] la llave i de x, que se repone con la primera del
+// hermano derecho
+static void borrow_right(const BTree* tree, BTreeNode* x, int i) {
+    BTreeNode *c = x->C[i], *r = x->C[i + 1];
+    move_entries(c, c->n, x, i, 1);
+    if (!c->leaf) c->C[c->n + 1] = r->C[0];
+    c->n += 1;
+    node_refresh(tree, c);
+    node_set(tree, x, i, r->keys[0], &r->values[0]);
+    move_entries(r, 0, r, 1, r->n - 1);
+    if (!r->leaf) memmove(r->C, r->C + 1, sizeof(BTreeNode*) * r->n);
+    r->n -= 1;
+    node_refresh(tree, r);
+}
+
+// Deja x->C[i] con al menos t llaves; devuelve el índice del hijo
+// por el que hay que seguir (cambia si se fusiona con el izquierdo),
+// que queda como nodo de esta escritura, o -1 sin memoria para
+// copiarlo (sin haber cambiado nada)
+static int ensure_child(BTree* tree, BTreeNode* x, int i) {
+    int t = tree->t;
+    if (x->C[i]->n >= t) return node_own(tree, &x->C[i]) ? i : -1;
+    if (i > 0 && x->C[i - 1]->n >= t) {
+        if (!node_own(tree, &x->C[i]) || !node_own(tree, &x->C[i - 1])) return -1;
+        borrow_left(tree, x, i);
+    } else if (i < x->n && x->C[i + 1]->n >= t) {
+        if (!node_own(tree, &x->C[i]) || !node_own(tree, &x->C[i + 1])) return -1;
+        borrow_right(tree, x, i);
     } else {
-        btree_insert_nonfull(r, key, position);
+        if (i == x->n) i--;
+        if (!node_own(tree, &x->C[i])) return -1;
+        merge_children(tree, x, i);
     }
+    return i;
 }
 
-// Elimina una clave del árbol (versión simple, solo en hojas)
-void btree_delete(BTreeNode** root_ref, const char* key) {
-    BTreeNode* node = *root_ref;
-    while (node) {
-        int i = 0;
-        while (i < node->n && strcmp(key, node->keys[i]) > 0) i++;
+// Elimina una clave del árbol; falso si no estaba (o, con lectores
+// concurrentes, si no hubo memoria para copiar el camino)
+static bool delete_key(BTree* tree, BTreeNode** root, const char* key) {
+    BTreeNode* x = node_own(tree, root);
+    if (!x) return false;
+    while (1) {
+        bool found;
+        int i = node_find(tree, x, key, &found);
+
+        if (found && x->leaf) {
+            node_remove(tree, x, i);
+            return true;
+        }
+        if (x->leaf) return false;  // No está
 
-        // Si la encontramos, eliminarla desplazando las demás
-        if (i < node->n && strcmp(key, node->keys[i]) == 0) {
-            for (int j = i; j < node->n - 1; ++j) {
-                strcpy(node->keys[j], node->keys[j + 1]);
-                node->positions[j] = node->positions[j + 1];
+        if (found) {
+            BTreeNode *y = x->C[i], *z = x->C[i + 1];
+            if (y->n >= tree->t || z->n >= tree->t) {
+                // Sustituir por el predecesor (o el sucesor) y pasar a
+                // borrar ese, que está en una hoja del hijo con sitio
+                bool left = y->n >= tree->t;
+                BTreeNode *c = node_own(tree, &x->C[left ? i : i + 1]);
+                if (!c) return false;
+                const BTreeNode *w = c;
+                while (!w->leaf) w = w->C[left ? w->n : 0];
+                int j = left ? w->n - 1 : 0;
+                uint32_t off = w->keys[j];
+                node_set(tree, x, i, off, &w->values[j]);
+                key = arena_key(&tree->arena, off);
+                x = c;
+                continue;
             }
-            node->n -= 1;
-            return;
+            // Los dos hijos en el mínimo: fusionarlos con la llave y
+            // seguir buscándola en el nodo fusionado
+            if (!(y = node_own(tree, &x->C[i]))) return false;
+            merge_children(tree, x, i);
+            x = y;
+        } else {
+            int c = ensure_child(tree, x, i);
+            if (c < 0) return false;
+            x = x->C[c];
+        }
+
+        // Una raíz interna que se queda sin llaves cede su lugar
+        if ((*root)->n == 0 && !(*root)->leaf) {
+            BTreeNode *old = *root;
+            *root = old->C[0];
+            node_drop(tree, old);
         }
+    }
+}
 
-        // Si es hoja y no está, no se elimina
-        if (node->leaf) break;
+// --------------------------------------------------------
+// Compactación del arena (solo sin lectores concurrentes): las
+// llaves vivas se copian en preorden a un arena nuevo y después se
+// cambian los desplazamientos de los nodos en el mismo orden. Si
+// falta memoria al copiar el árbol no se toca.
+// --------------------------------------------------------
+typedef struct {
+    KeyArena *fresh;
+    uint32_t *offs;           // Desplazamiento nuevo de cada llave
+    size_t n;
+} Rekey;
 
-        // Continuar en el hijo correspondiente
-        node = node->C[i];
+static bool rekey_copy(const BTree* tree, Rekey* r, const BTreeNode* x) {
+    for (int i = 0; i < x->n; ++i) {
+        const char *key = arena_key(&tree->arena, x->keys[i]);
+        uint32_t off = arena_add(r->fresh, key, strlen(key));
+        if (off == UINT32_MAX) return false;
+        r->offs[r->n++] = off;
     }
+    if (!x->leaf)
+        for (int i = 0; i <= x->n; ++i)
+            if (!rekey_copy(tree, r, x->C[i])) return false;
+    return true;
 }
 
-// Lista todas las claves del árbol en orden ascendente
-void btree_list(BTreeNode* x) {
-    if (!x) return;
+static void rekey_apply(Rekey* r, BTreeNode* x) {
+    for (int i = 0; i < x->n; ++i) x->keys[i] = r->offs[r->n++];
+    if (!x->leaf)
+        for (int i = 0; i <= x->n; ++i) rekey_apply(r, x->C[i]);
+}
+
+static void arena_compact(BTree* tree) {
+    KeyArena *a = &tree->arena;
+    uint64_t bytes = (uint64_t)(a->nchunks - 1) * BTREE_ARENA_CHUNK + a->used;
+    if (tree->retire || a->dead < BTREE_ARENA_CHUNK || a->dead * 2 < bytes) return;
+    Rekey r = { calloc(1, sizeof(KeyArena)), malloc(sizeof(uint32_t) * (tree->count + 1)), 0 };
+    bool ok = r.fresh && r.offs && rekey_copy(tree, &r, tree->root);
+    if (ok) {
+        r.n = 0;
+        rekey_apply(&r, tree->root);
+        arena_free(a);
+        *a = *r.fresh;
+    } else if (r.fresh) {
+        arena_free(r.fresh);
+    }
+    free(r.fresh);
+    free(r.offs);
+}
+
+bool btree_delete(BTree* tree, const char* key) {
+    size_t len = strlen(key);  // key puede estar en el arena
+    write_begin(tree);
+    BTreeNode *root = tree->root;
+    bool removed = delete_key(tree, &root, key);
+    write_end(tree, root);
+    if (removed) {
+        tree->count--;
+        tree->arena.dead += len + 1;
+        arena_compact(tree);
+    }
+    return removed;
+}
+
+// Recorrido en orden; devuelve falso si fn pidió parar
+static bool foreach_node(const BTree* tree, const BTreeNode* x, btree_visit fn, void* user) {
     int i;
     for (i = 0; i < x->n; ++i) {
-        if (!x->leaf) btree_list(x->C[i]);
-        printf("- %s\n", x->keys[i]);
+        if (!x->leaf && !foreach_node(tree, x->C[i], fn, user)) return false;
+        if (!fn(user, arena_key(&tree->arena, x->keys[i]), &x->values[i])) return false;
+    }
+    return x->leaf || foreach_node(tree, x->C[i], fn, user);
+}
+
+void btree_foreach(const BTree* tree, btree_visit fn, void* user) {
+    const BTreeNode *root = tree ? tree_root(tree) : NULL;
+    if (root) foreach_node(tree, root, fn, user);
+}
+
+// Apila x y, por el primer hijo, todo su camino hasta la hoja
+static void cursor_descend(BTreeCursor* cur, const BTreeNode* x) {
+    while (x && cur->depth + 1 < BTREE_CURSOR_DEPTH) {
+        cur->depth++;
+        cur->node[cur->depth] = x;
+        cur->slot[cur->depth] = 0;
+        x = x->leaf ? NULL : x->C[0];
+    }
+}
+
+void btree_cursor_seek(BTreeCursor* cur, const BTree* tree, const char* key) {
+    cur->tree = tree;
+    cur->depth = -1;
+    const BTreeNode *x = tree ? tree_root(tree) : NULL;
+    if (!x) return;
+    if (!key || !*key) {
+        cursor_descend(cur, x);
+        return;
     }
-    if (!x->leaf) btree_list(x->C[i]);
+    // En cada nivel queda como siguiente la primera llave >= key; si
+    // no es igual, antes hay que recorrer el hijo que la precede
+    while (x && cur->depth + 1 < BTREE_CURSOR_DEPTH) {
+        bool found;
+        int i = node_find(tree, x, key, &found);
+        cur->depth++;
+        cur->node[cur->depth] = x;
+        cur->slot[cur->depth] = i;
+        x = found || x->leaf ? NULL : x->C[i];
+    }
+}
+
+bool btree_cursor_next(BTreeCursor* cur, const char** key, const BTreeValue** value) {
+    while (cur->depth >= 0) {
+        const BTreeNode *x = cur->node[cur->depth];
+        int i = cur->slot[cur->depth];
+        if (i >= x->n) {
+            cur->depth--;
+            continue;
+        }
+        cur->slot[cur->depth] = i + 1;
+        *key = arena_key(&cur->tree->arena, x->keys[i]);
+        *value = &x->values[i];
+        if (!x->leaf) cursor_descend(cur, x->C[i + 1]);
+        return true;
+    }
+    return false;
+}
+
+static size_t count_nodes(const BTreeNode* x) {
+    size_t n = 1;
+    if (!x->leaf)
+        for (int i = 0; i <= x->n; ++i) n += count_nodes(x->C[i]);
+    return n;
+}
+
+// Altura (todas las hojas están a la misma profundidad) y nodos
+void btree_shape(const BTree* tree, int* height, size_t* nodes) {
+    *height = 0;
+    *nodes = 0;
+    if (!tree || !tree->root) return;
+    for (const BTreeNode *x = tree->root; x; x = x->leaf ? NULL : x->C[0]) (*height)++;
+    *nodes = count_nodes(tree->root);
+}
+
+static bool print_key(void* user, const char* key, const BTreeValue* value) {
+    (void)user;
+    (void)value;
+    printf("- %s\n", key);
+    return true;
+}
+
+// Lista todas las claves del árbol en orden ascendente
+void btree_list(const BTree* tree) {
+    btree_foreach(tree, print_key, NULL);
 }
@@ -1,17 +1,138 @@
 #ifndef TREE_H
 #define TREE_H
 #include <stdbool.h>
-#define BTREE_T 2
+#include <stddef.h>
+#include <stdint.h>
+
+// Orden por defecto (grado mínimo t): cada nodo tiene como mucho
+// 2t - 1 llaves. Con t = 16 la búsqueda binaria dentro de un nodo
+// solo toca sus prefijos (2 líneas de caché) y el árbol es poco
+// profundo. Se puede cambiar al
+// compilar (-DBTREE_T=...) o al crear el árbol.
+#ifndef BTREE_T
+#define BTREE_T 16
+#endif
+
+// Longitud máxima de una llave (sin contar el 0 final)
+#define BTREE_KEY_MAX 255
+
+// Las llaves se guardan aparte, en trozos de BTREE_ARENA_CHUNK bytes;
+// un nodo las referencia por desplazamiento (trozo << 20 | posición),
+// así que caben 4 GB de llaves y, al llegar ahí, btree_insert falla.
+// Borrar no libera los bytes de la llave: cuenta en dead. Sin
+// lectores concurrentes, cuando más de la mitad del arena son llaves
+// borradas las vivas se copian a trozos nuevos. Con btree_share un
+// lector puede estar leyendo una llave por su desplazamiento y no se
+// mueven nunca: quien comparte el árbol debe sustituirlo por uno
+// nuevo cuando dead crezca (el índice lo hace en cada checkpoint).
+#define BTREE_ARENA_CHUNK (1 << 20)
+#define BTREE_ARENA_MAX_CHUNKS 4096
+
+typedef struct {
+    char *chunks[BTREE_ARENA_MAX_CHUNKS];
+    uint32_t nchunks;
+    uint32_t used;            // Bytes usados del último trozo
+    uint64_t dead;            // Bytes de llaves ya borradas
+} KeyArena;
+
+// Valor asociado a cada llave: dónde está el blob, sus tamaños
+// (para que guardar el índice no tenga que leerlos de storage) y el
+// hash de su contenido, que identifica blobs compartidos
+typedef struct {
+    long position;            // Posición del blob en storage
+    uint64_t comp_size;       // Tamaño comprimido
+    uint64_t orig_size;       // Tamaño original
+    uint64_t hash[2];         // Hash del contenido (0 si no se conoce)
+} BTreeValue;
+
+// Nodo en un único bloque de memoria: cabecera y, a continuación,
+// los arreglos de hijos (solo nodos internos), valores, prefijos
+// y desplazamientos de las llaves. Como las rutas suelen compartir
+// el principio, prefix guarda los 4 bytes que siguen a los lcp que
+// tienen en común todas las llaves del nodo; casi todas las
+// comparaciones se resuelven con ellos sin leer la llave del arena.
 typedef struct BTreeNode {
     int n;
-    char (*keys)[256];
-    long *positions;
-    struct BTreeNode **C;
+    uint16_t lcp;             // Bytes comunes a todas las llaves del nodo
     bool leaf;
+    uint64_t gen;             // Escritura que creó el nodo (ver btree_share)
+    uint32_t *prefix;         // 4 bytes tras lcp de cada llave (big-endian)
+    uint32_t *keys;           // Desplazamiento de cada llave en el arena
+    BTreeValue *values;
+    struct BTreeNode **C;     // NULL en las hojas
 } BTreeNode;
-BTreeNode* btree_create();
-void btree_insert(BTreeNode** root, const char* key, long position);
-long btree_search(BTreeNode* root, const char* key);
-void btree_delete(BTreeNode** root, const char* key);
-void btree_list(BTreeNode* root);
+
+// Recibe un nodo que ya no está en el árbol y que se libera con free()
+// cuando ningún lector pueda verlo
+typedef void (*btree_retire)(void* user, void* node);
+
+typedef struct {
+    BTreeNode *root;          // Se publica con una escritura atómica
+    int t;                    // Grado mínimo
+    size_t count;             // Llaves en el árbol
+    KeyArena arena;
+    uint64_t gen;             // Escritura en curso
+    btree_retire retire;      // NULL: sin lectores concurrentes
+    void *retire_user;
+} BTree;
+
+// Crea un árbol vacío de grado mínimo t (t < 2 usa BTREE_T)
+BTree* btree_create(int t);
+void btree_destroy(BTree* tree);
+
+// Lectores concurrentes. Tras btree_share las escrituras (que se
+// deben serializar) no modifican ningún nodo ya publicado: copian el
+// camino que cambian, publican la raíz nueva de forma atómica al
+// terminar y pasan los nodos sustituidos a retire en lugar de
+// liberarlos. Así btree_search, btree_get, el recorrido y los
+// cursores funcionan sin cerrojos a la vez que un escritor, siempre
+// que retire no libere un nodo mientras un lector pueda verlo (p. ej.
+// con epoch.h). Cada lectura ve el árbol de antes o de después de
+// cada escritura, nunca uno a medias.
+void btree_share(BTree* tree, btree_retire retire, void* user);
+
+// Inserta o actualiza; falso si la llave es demasiado larga o falta memoria
+bool btree_insert(BTree* tree, const char* key, const BTreeValue* value);
+// Posición asociada a la llave o -1 si no existe
+long btree_search(const BTree* tree, const char* key);
+// Copia en out el valor de la llave; falso si no existe
+bool btree_get(const BTree* tree, const char* key, BTreeValue* out);
+// Elimina la llave rebalanceando el árbol; falso si no existía
+bool btree_delete(BTree* tree, const char* key);
+void btree_list(const BTree* tree);
+
+// Altura del árbol (1 = solo la raíz) y cantidad de nodos (recorre el árbol)
+void btree_shape(const BTree* tree, int* height, size_t* nodes);
+
+// Construye de abajo arriba, en tiempo lineal, un árbol con las n
+// llaves que entrega next en orden estrictamente creciente. Los nodos
+// quedan llenos en la proporción fill (0 < fill <= 1, sin bajar del
+// mínimo de un B-tree). Devuelve NULL si next falla, si una llave no
+// es válida o si no vienen ordenadas.
+typedef bool (*btree_source)(void* user, const char** key, BTreeValue* value);
+BTree* btree_bulk_load(int t, size_t n, double fill, btree_source next, void* user);
+
+// Recorre las llaves en orden; se detiene si fn devuelve falso
+typedef bool (*btree_visit)(void* user, const char* key, const BTreeValue* value);
+void btree_foreach(const BTree* tree, btree_visit fn, void* user);
+
+// Cursor: recorrido en orden que empieza en cualquier llave y avanza
+// a petición. Guarda el camino desde la raíz (nodo y siguiente llave
+// de cada nivel), así que colocarlo cuesta O(log n) y cada paso O(1)
+// amortizado. Cualquier cambio del árbol lo invalida, salvo con
+// btree_share: entonces recorre el árbol de cuando se colocó.
+#define BTREE_CURSOR_DEPTH 48
+
+typedef struct {
+    const BTree *tree;
+    int depth;                // Nivel del nodo actual (-1 al terminar)
+    const BTreeNode *node[BTREE_CURSOR_DEPTH];
+    int slot[BTREE_CURSOR_DEPTH];
+} BTreeCursor;
+
+// Coloca el cursor en la primera llave >= key (NULL o "" = la primera)
+void btree_cursor_seek(BTreeCursor* cur, const BTree* tree, const char* key);
+// Llave y valor siguientes (válidos hasta que cambie el árbol); falso al terminar
+bool btree_cursor_next(BTreeCursor* cur, const char** key, const BTreeValue** value);
+
 #endif
@@ -0,0 +1,236 @@
+#include "uring.h"
+#include <stddef.h>
+
+#if FS_URING
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <linux/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// UringStat debe poder guardar un struct statx
+typedef char uring_stat_fits[sizeof(struct statx) <= sizeof(UringStat) ? 1 : -1];
+
+struct Uring {
+    int fd;
+    // Cola de envío: el núcleo avanza head, este hilo avanza tail
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned sq_entries;
+    unsigned sq_local_tail;  // Incluye las preparadas sin publicar
+    unsigned to_submit;
+    struct io_uring_sqe *sqes;
+    // Cola de terminadas: el núcleo avanza tail, este hilo avanza head
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_len, cq_ring_len, sqes_len;
+};
+
+Uring* uring_create(unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (fd < 0) return NULL;
+
+    Uring *u = calloc(1, sizeof(Uring));
+    if (!u) {
+        close(fd);
+        return NULL;
+    }
+    u->fd = fd;
+    u->sq_ring_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cq_ring_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    // Con IORING_FEAT_SINGLE_MMAP las dos colas van en una proyección
+    bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single && u->cq_ring_len > u->sq_ring_len) u->sq_ring_len = u->cq_ring_len;
+    u->sq_ring = mmap(NULL, u->sq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      fd, IORING_OFF_SQ_RING);
+    if (u->sq_ring == MAP_FAILED) {
+        u->sq_ring = NULL;
+        uring_destroy(u);
+        return NULL;
+    }
+    if (single) {
+        u->cq_ring = u->sq_ring;
+    } else {
+        u->cq_ring = mmap(NULL, u->cq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          fd, IORING_OFF_CQ_RING);
+        if (u->cq_ring == MAP_FAILED) {
+            u->cq_ring = NULL;
+            uring_destroy(u);
+            return NULL;
+        }
+    }
+    u->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   fd, IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) {
+        u->sqes = NULL;
+        uring_destroy(u);
+        return NULL;
+    }
+
+    uint8_t *sq = u->sq_ring, *cq = u->cq_ring;
+    u->sq_head = (unsigned*)(sq + p.sq_off.head);
+    u->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    u->sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+    u->sq_array = (unsigned*)(sq + p.sq_off.array);
+    u->sq_entries = p.sq_entries;
+    u->sq_local_tail = *u->sq_tail;
+    u->cq_head = (unsigned*)(cq + p.cq_off.head);
+    u->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    u->cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    return u;
+}
+
+void uring_destroy(Uring* u) {
+    if (!u) return;
+    if (u->sqes) munmap(u->sqes, u->sqes_len);
+    if (u->cq_ring && u->cq_ring != u->sq_ring) munmap(u->cq_ring, u->cq_ring_len);
+    if (u->sq_ring) munmap(u->sq_ring, u->sq_ring_len);
+    close(u->fd);
+    free(u);
+}
+
+// Siguiente hueco de la cola de envío (NULL si está llena)
+static struct io_uring_sqe* uring_sqe(Uring* u, uint8_t opcode, int fd, uint64_t user) {
+    unsigned head = __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+    if (u->sq_local_tail - head >= u->sq_entries) return NULL;
+    unsigned idx = u->sq_local_tail & *u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->user_data = user;
+    u->sq_array[idx] = idx;
+    u->sq_local_tail++;
+    u->to_submit++;
+    return sqe;
+}
+
+bool uring_openat(Uring* u, const char* path, int flags, uint64_t user) {
+    struct io_uring_sqe *sqe = uring_sqe(u, IORING_OP_OPENAT, AT_FDCWD, user);
+    if (!sqe) return false;
+    sqe->addr = (uint64_t)(uintptr_t)path;
+    sqe->open_flags = (uint32_t)flags;
+    return true;
+}
+
+bool uring_statx(Uring* u, const char* path, UringStat* out, uint64_t user) {
+    struct io_uring_sqe *sqe = uring_sqe(u, IORING_OP_STATX, AT_FDCWD, user);
+    if (!sqe) return false;
+    sqe->addr = (uint64_t)(uintptr_t)path;
+    sqe->len = STATX_TYPE | STATX_SIZE;
+    sqe->off = (uint64_t)(uintptr_t)out;
+    return true;
+}
+
+bool uring_read(Uring* u, int fd, void* buf, unsigned len, uint64_t offset, bool link, uint64_t user) {
+    struct io_uring_sqe *sqe = uring_sqe(u, IORING_OP_READ, fd, user);
+    if (!sqe) return false;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = len;
+    sqe->off = offset;
+    if (link) sqe->flags |= IOSQE_IO_LINK;
+    return true;
+}
+
+bool uring_close(Uring* u, int fd, uint64_t user) {
+    return uring_sqe(u, IORING_OP_CLOSE, fd, user) != NULL;
+}
+
+bool uring_submit(Uring* u, unsigned wait) {
+    // Las peticiones preparadas se publican antes de avisar al núcleo
+    __atomic_store_n(u->sq_tail, u->sq_local_tail, __ATOMIC_RELEASE);
+    if (u->to_submit == 0 && wait == 0) return true;
+    while (1) {
+        int n = (int)syscall(__NR_io_uring_enter, u->fd, u->to_submit, wait,
+                             wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return false;
+        u->to_submit -= (unsigned)n < u->to_submit ? (unsigned)n : u->to_submit;
+        // Una llamada que espera no vuelve sin las terminadas pedidas;
+        // si el núcleo no aceptó todas, se manda el resto
+        wait = 0;
+        if (n == 0 || u->to_submit == 0) return true;
+    }
+}
+
+bool uring_next(Uring* u, uint64_t* user, int* res) {
+    unsigned head = *u->cq_head;
+    if (head == __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE)) return false;
+    const struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+    *user = cqe->user_data;
+    *res = cqe->res;
+    __atomic_store_n(u->cq_head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+uint64_t uring_stat_size(const UringStat* st) {
+    return ((const struct statx*)st->raw)->stx_size;
+}
+
+bool uring_stat_regular(const UringStat* st) {
+    return S_ISREG(((const struct statx*)st->raw)->stx_mode);
+}
+
+#else
+
+// Sin io_uring: quien lo use sigue siempre por otro camino
+Uring* uring_create(unsigned entries) {
+    (void)entries;
+    return NULL;
+}
+
+void uring_destroy(Uring* u) {
+    (void)u;
+}
+
+bool uring_openat(Uring* u, const char* path, int flags, uint64_t user) {
+    (void)u; (void)path; (void)flags; (void)user;
+    return false;
+}
+
+bool uring_statx(Uring* u, const char* path, UringStat* out, uint64_t user) {
+    (void)u; (void)path; (void)out; (void)user;
+    return false;
+}
+
+bool uring_read(Uring* u, int fd, void* buf, unsigned len, uint64_t offset, bool link, uint64_t user) {
+    (void)u; (void)fd; (void)buf; (void)len; (void)offset; (void)link; (void)user;
+    return false;
+}
+
+bool uring_close(Uring* u, int fd, uint64_t user) {
+    (void)u; (void)fd; (void)user;
+    return false;
+}
+
+bool uring_submit(Uring* u, unsigned wait) {
+    (void)u; (void)wait;
+    return false;
+}
+
+bool uring_next(Uring* u, uint64_t* user, int* res) {
+    (void)u; (void)user; (void)res;
+    return false;
+}
+
+uint64_t uring_stat_size(const UringStat* st) {
+    (void)st;
+    return 0;
+}
+
+bool uring_stat_regular(const UringStat* st) {
+    (void)st;
+    return false;
+}
+
+#endif
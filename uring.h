@@ -0,0 +1,63 @@
+#ifndef URING_H
+#define URING_H
+#include <stdbool.h>
+#include <stdint.h>
+
+// -------------------------------------------------------
+// io_uring mínimo con llamadas directas al sistema (sin liburing)
+// para la ingesta de muchos archivos pequeños: se preparan varias
+// peticiones (openat, statx, read, close) en la cola de envío y se
+// mandan todas juntas con una sola llamada, que además espera las
+// terminadas. Cada petición lleva un user que vuelve con su
+// resultado.
+//
+// Si el sistema no tiene io_uring (o está prohibido) uring_create
+// devuelve NULL y quien lo usa sigue por otro camino. Compilando con
+// -DFS_URING=0 no se usa nunca.
+//
+// Una cola es de un solo hilo.
+// -------------------------------------------------------
+#ifndef FS_URING
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define FS_URING 1
+#endif
+#endif
+#endif
+#ifndef FS_URING
+#define FS_URING 0
+#endif
+
+typedef struct Uring Uring;
+
+// Resultado de uring_statx (guarda un struct statx del núcleo)
+typedef struct {
+    uint64_t raw[32];
+} UringStat;
+
+// Cola con sitio para entries peticiones en vuelo (o NULL)
+Uring* uring_create(unsigned entries);
+void uring_destroy(Uring* u);
+
+// Preparan una petición; falso si la cola de envío está llena. Con
+// link, la siguiente petición preparada no empieza hasta que esta
+// termine bien (si falla o se queda corta, la siguiente se cancela
+// con -ECANCELED).
+bool uring_openat(Uring* u, const char* path, int flags, uint64_t user);
+bool uring_statx(Uring* u, const char* path, UringStat* out, uint64_t user);
+bool uring_read(Uring* u, int fd, void* buf, unsigned len, uint64_t offset, bool link, uint64_t user);
+bool uring_close(Uring* u, int fd, uint64_t user);
+
+// Envía lo preparado y espera a que haya al menos wait terminadas;
+// falso si la llamada falla
+bool uring_submit(Uring* u, unsigned wait);
+
+// Siguiente petición terminada: su user y su resultado (>= 0 o
+// -errno); falso si no queda ninguna
+bool uring_next(Uring* u, uint64_t* user, int* res);
+
+// Campos de un statx terminado
+uint64_t uring_stat_size(const UringStat* st);
+bool uring_stat_regular(const UringStat* st);
+
+#endif // URING_H